@@ -13,18 +13,25 @@ layout (binding = 1) uniform LightInfos {
     SpotLight spot_lights[MAX_SPOT_LIGHTS];
 } infos;
 
+// Lights actually in use, specialize them so the loops get unrolled to
+// that count. Clamped to the array sizes above, a larger count would
+// read past them
+layout (constant_id = 0) const int POINT_LIGHT_COUNT = MAX_POINT_LIGHTS;
+layout (constant_id = 1) const int DIRECTIONAL_LIGHT_COUNT = MAX_DIRECTIONAL_LIGHTS;
+layout (constant_id = 2) const int SPOT_LIGHT_COUNT = MAX_SPOT_LIGHTS;
+
 void main() {
     vec3 frag_color = vec3(0);
-    for (int i = 0; i < MAX_POINT_LIGHTS; ++i) {
+    for (int i = 0; i < min(POINT_LIGHT_COUNT, MAX_POINT_LIGHTS); ++i) {
         vec3 light_dir = normalize(infos.pt_lights[i].pos.xyz - pos);
         frag_color += clamp(infos.pt_lights[i].color.xyz *
             max(0, dot(light_dir, normal)), 0, 1);
     }
-    for (int i = 0; i < MAX_DIRECTIONAL_LIGHTS; ++i) {
+    for (int i = 0; i < min(DIRECTIONAL_LIGHT_COUNT, MAX_DIRECTIONAL_LIGHTS); ++i) {
         frag_color += clamp(infos.dir_lights[i].color.xyz *
             max(0, dot(-infos.dir_lights[i].direction.xyz, normal)), 0, 1);
     }
-    for (int i = 0; i < MAX_SPOT_LIGHTS; ++i) {
+    for (int i = 0; i < min(SPOT_LIGHT_COUNT, MAX_SPOT_LIGHTS); ++i) {
         vec3 light_dir = normalize(infos.spot_lights[i].pos.xyz - pos);
         frag_color += clamp(infos.spot_lights[i].color *
             step(0, radians(infos.spot_lights[i].angle) - acos(dot(infos.spot_lights[i].direction.xyz, -light_dir)))
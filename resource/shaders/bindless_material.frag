@@ -0,0 +1,46 @@
+#version 450
+
+#ifndef BINDLESS_FALLBACK
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
+
+#include "concepts/material.h"
+
+layout (location = 0) in vec3 normal;
+layout (location = 1) in vec2 uv;
+layout (location = 2) flat in uint node;
+layout (location = 0) out vec4 out_color;
+
+layout (std430, binding = MATERIAL_BINDING) readonly buffer Materials {
+    Material materials[];
+};
+
+layout (std430, binding = NODE_MATERIAL_BINDING) readonly buffer NodeMaterials {
+    uint node_materials[];
+};
+
+// Without descriptor indexing the heap is a small fixed array, the index
+// is still uniform within a draw since it only depends on the node
+#ifdef BINDLESS_FALLBACK
+layout (set = BINDLESS_SET, binding = BINDLESS_IMAGE_BINDING) uniform sampler2D textures[BINDLESS_FALLBACK_IMAGES];
+#define TEX(i) textures[i]
+#else
+layout (set = BINDLESS_SET, binding = BINDLESS_IMAGE_BINDING) uniform sampler2D textures[];
+#define TEX(i) textures[nonuniformEXT(i)]
+#endif
+
+vec4 sample_or(uint slot, vec4 fallback) {
+    if (slot == BINDLESS_NONE)
+        return fallback;
+    return texture(TEX(slot), uv);
+}
+
+void main() {
+    Material mat = materials[node_materials[node]];
+    vec4 albedo = mat.base_color * sample_or(mat.textures[MATERIAL_ALBEDO], vec4(1.0));
+    vec3 emissive = sample_or(mat.textures[MATERIAL_EMISSIVE], vec4(0.0)).rgb * mat.params.z;
+
+    // Fixed light from +z, real lighting is up to the material shaders
+    float ndotl = max(dot(normalize(normal), vec3(0.0, 0.0, 1.0)), 0.0);
+    out_color = vec4(albedo.rgb * (0.2 + 0.8 * ndotl) + emissive, albedo.a);
+}
@@ -0,0 +1,28 @@
+#version 450
+
+#include "utils/macros.h"
+
+layout (location = 0) in vec3 in_pos;
+layout (location = 1) in vec3 in_normal;
+layout (location = 2) in vec2 in_uv;
+
+layout (location = 0) out vec3 out_normal;
+layout (location = 1) out vec2 out_uv;
+layout (location = 2) flat out uint out_node;
+
+layout (binding = 0) uniform Xforms {
+    mat4 view_proj;
+} xforms;
+
+// Scene world matrices, draws pass the node id as firstInstance
+layout (std430, binding = TRANSFORM_BINDING) readonly buffer Transforms {
+    mat4 worlds[];
+};
+
+void main() {
+    mat4 world = worlds[gl_InstanceIndex];
+    gl_Position = xforms.view_proj * world * vec4(in_pos, 1.0);
+    out_normal = mat3(world) * in_normal;
+    out_uv = in_uv;
+    out_node = gl_InstanceIndex;
+}
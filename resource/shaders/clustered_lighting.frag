@@ -0,0 +1,138 @@
+#version 450
+
+#include "concepts/lights.h"
+
+layout (location = 0) in vec3 pos;
+layout (location = 1) in vec3 normal;
+layout (location = 2) in vec2 uv;
+layout (location = 0) out vec4 out_color;
+
+layout (binding = CLUSTER_INFO_BINDING) uniform Clusters {
+    ClusterInfo info;
+} clusters;
+
+layout (std430, binding = POINT_LIGHT_BINDING) readonly buffer PointLights {
+    PointLight pt_lights[];
+};
+
+layout (std430, binding = SPOT_LIGHT_BINDING) readonly buffer SpotLights {
+    SpotLight spot_lights[];
+};
+
+layout (std430, binding = DIR_LIGHT_BINDING) readonly buffer DirectionalLights {
+    DirectionalLight dir_lights[];
+};
+
+// x : offset into light_indices, y : light count
+layout (std430, binding = CLUSTER_RANGE_BINDING) readonly buffer ClusterRanges {
+    uvec2 ranges[];
+};
+
+layout (std430, binding = CLUSTER_INDEX_BINDING) readonly buffer ClusterIndices {
+    uint light_indices[];
+};
+
+layout (binding = SHADOW_INFO_BINDING) uniform Shadows {
+    ShadowInfo info;
+} shadows;
+
+layout (std430, binding = SHADOW_TILE_BINDING) readonly buffer ShadowTiles {
+    ShadowTile shadow_tiles[];
+};
+
+// First tile of every point light followed by every spot light, -1 when
+// the light casts no shadow
+layout (std430, binding = SHADOW_LOOKUP_BINDING) readonly buffer ShadowLookup {
+    int shadow_lookup[];
+};
+
+layout (binding = CASCADE_MAP_BINDING) uniform sampler2DArrayShadow cascade_map;
+layout (binding = SHADOW_ATLAS_BINDING) uniform sampler2DShadow shadow_atlas;
+
+// Fades to zero at the range so culled lights don't pop
+float range_falloff(float dist, float range) {
+    float r = dist / range;
+    float w = clamp(1 - r * r * r * r, 0, 1);
+    return w * w;
+}
+
+uint cluster_index() {
+    ClusterInfo info = clusters.info;
+    float depth = -(info.view * vec4(pos, 1)).z;
+    uint slice = uint(max(log(depth) - info.depth.w, 0) * info.depth.z);
+    uvec2 tile = uvec2(gl_FragCoord.xy / info.tile_size.xy);
+
+    uvec3 cluster = min(uvec3(tile, slice), info.dims.xyz - 1);
+    return cluster.x + cluster.y * info.dims.x + cluster.z * info.dims.x * info.dims.y;
+}
+
+float cascade_shadow(float depth) {
+    uint cnt = shadows.info.params.x;
+    uint cascade = 0;
+    while (cascade + 1 < cnt && depth > shadows.info.splits[cascade])
+        ++cascade;
+
+    vec4 p = shadows.info.cascades[cascade] * vec4(pos, 1);
+    vec2 uv = p.xy * 0.5 + 0.5;
+    if (any(lessThan(uv, vec2(0))) || any(greaterThan(uv, vec2(1))))
+        return 1;
+    return texture(cascade_map, vec4(uv, cascade, p.z));
+}
+
+float tile_shadow(int tile) {
+    ShadowTile t = shadow_tiles[tile];
+    vec4 p = t.view_proj * vec4(pos, 1);
+    p.xyz /= p.w;
+    vec2 uv = clamp(p.xy * 0.5 + 0.5, vec2(0), vec2(1));
+    return texture(shadow_atlas, vec3(t.rect.xy + uv * t.rect.zw, p.z));
+}
+
+// Point lights own six tiles, the face is the major axis of the direction
+// from the light
+float point_shadow(uint light, vec3 from_light) {
+    int first = shadow_lookup[light];
+    if (first < 0)
+        return 1;
+    vec3 a = abs(from_light);
+    int face = a.x >= a.y && a.x >= a.z ? (from_light.x > 0 ? 0 : 1) :
+        a.y >= a.z ? (from_light.y > 0 ? 2 : 3) : (from_light.z > 0 ? 4 : 5);
+    return tile_shadow(first + face);
+}
+
+float spot_shadow(uint light) {
+    int first = shadow_lookup[shadows.info.params.z + light];
+    return first < 0 ? 1 : tile_shadow(first);
+}
+
+void main() {
+    vec3 frag_color = vec3(0);
+    float depth = -(clusters.info.view * vec4(pos, 1)).z;
+    for (uint i = 0; i < clusters.info.dims.w; ++i) {
+        float lit = i == shadows.info.params.y ? cascade_shadow(depth) : 1;
+        frag_color += clamp(dir_lights[i].color.xyz *
+            max(0, dot(-dir_lights[i].direction.xyz, normal)), 0, 1) * lit;
+    }
+
+    uvec2 range = ranges[cluster_index()];
+    for (uint i = range.x; i < range.x + range.y; ++i) {
+        uint idx = light_indices[i];
+        if ((idx & LIGHT_SPOT_FLAG) == 0) {
+            PointLight light = pt_lights[idx];
+            vec3 to_light = light.pos.xyz - pos;
+            vec3 light_dir = normalize(to_light);
+            frag_color += clamp(light.color.xyz * max(0, dot(light_dir, normal)) *
+                range_falloff(length(to_light), light.params.x), 0, 1) *
+                point_shadow(idx, -to_light);
+        }
+        else {
+            SpotLight light = spot_lights[idx & ~LIGHT_SPOT_FLAG];
+            vec3 to_light = light.pos.xyz - pos;
+            vec3 light_dir = normalize(to_light);
+            frag_color += clamp(light.color *
+                step(0, radians(light.angle) - acos(dot(light.direction.xyz, -light_dir)))
+                * max(0, dot(light_dir, normal)) * range_falloff(length(to_light), light.params.x), 0, 1) *
+                spot_shadow(idx & ~LIGHT_SPOT_FLAG);
+        }
+    }
+    out_color = vec4(frag_color, 1);
+}
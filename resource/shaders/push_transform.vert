@@ -0,0 +1,27 @@
+#version 450
+
+layout (location = 0) in vec3 in_pos;
+layout (location = 1) in vec3 in_normal;
+layout (location = 2) in vec2 in_uv;
+
+layout (location = 0) out vec3 out_pos;
+layout (location = 1) out vec3 out_normal;
+layout (location = 2) out vec2 out_uv;
+
+layout (binding = 0) uniform Xforms {
+    mat4 view_proj;
+} xforms;
+
+// Per draw, pushed by Scene::emit_draw_cmds instead of going through a
+// uniform buffer
+layout (push_constant) uniform Push {
+    mat4 model;
+} push;
+
+void main() {
+    vec4 world_pos = push.model * vec4(in_pos, 1.0);
+    gl_Position = xforms.view_proj * world_pos;
+    out_pos = world_pos.xyz;
+    out_normal = mat3(push.model) * in_normal;
+    out_uv = in_uv;
+}
@@ -0,0 +1,11 @@
+#version 450
+
+layout (location = 0) in vec3 in_pos;
+
+layout (push_constant) uniform Push {
+    mat4 mvp;
+} push;
+
+void main() {
+    gl_Position = push.mvp * vec4(in_pos, 1.0);
+}
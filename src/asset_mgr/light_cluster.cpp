@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <cmath>
+
+#include "asset_mgr/light_cluster.h"
+
+namespace vkkk
+{
+
+LightCluster::LightCluster(const uint32_t x, const uint32_t y, const uint32_t z)
+    : dim_x(x)
+    , dim_y(y)
+    , dim_z(z)
+{
+    ranges.resize(cluster_cnt(), glm::uvec2(0));
+    bounds.resize(cluster_cnt());
+}
+
+void LightCluster::build(const Camera& cam, const uint32_t width, const uint32_t height,
+    const std::vector<PointLight>& pt_lights, const std::vector<SpotLight>& spot_lights,
+    const uint32_t dir_light_cnt)
+{
+    update_bounds(cam, std::max(width, 1u), std::max(height, 1u));
+
+    info.view = cam.get_view_mat();
+    info.dims = glm::uvec4(dim_x, dim_y, dim_z, dir_light_cnt);
+
+    pairs.clear();
+    for (uint32_t i = 0; i < pt_lights.size(); ++i) {
+        auto& light = pt_lights[i];
+        glm::vec3 center(info.view * glm::vec4(glm::vec3(light.pos), 1.f));
+        bin_sphere(center, light.params.x, i);
+    }
+
+    // The cone is bounded by the sphere of its range, looser than a proper
+    // cone test but spot lights are rarely dense enough for it to matter
+    for (uint32_t i = 0; i < spot_lights.size(); ++i) {
+        auto& light = spot_lights[i];
+        glm::vec3 center(info.view * glm::vec4(glm::vec3(light.pos), 1.f));
+        bin_sphere(center, light.params.x, i | LIGHT_SPOT_FLAG);
+    }
+
+    // Sorting groups the pairs by cluster, light order within a cluster
+    // stays deterministic as a bonus
+    std::sort(pairs.begin(), pairs.end());
+
+    std::fill(ranges.begin(), ranges.end(), glm::uvec2(0));
+    indices.resize(pairs.size());
+    for (uint32_t i = 0; i < pairs.size(); ++i) {
+        auto cluster = static_cast<uint32_t>(pairs[i] >> 32);
+        if (ranges[cluster].y == 0)
+            ranges[cluster].x = i;
+        ++ranges[cluster].y;
+        indices[i] = static_cast<uint32_t>(pairs[i]);
+    }
+}
+
+uint32_t LightCluster::slice_of(const float depth) const {
+    if (depth <= info.depth.x)
+        return 0;
+    auto slice = static_cast<uint32_t>((std::log(depth) - info.depth.w) * info.depth.z);
+    return std::min(slice, dim_z - 1);
+}
+
+void LightCluster::update_bounds(const Camera& cam, const uint32_t width,
+    const uint32_t height)
+{
+    glm::vec4 key(cam.fov, cam.ratio, cam.near, cam.far);
+    glm::uvec2 extent(width, height);
+    if (key == bounds_key && extent == bounds_extent)
+        return;
+    bounds_key = key;
+    bounds_extent = extent;
+
+    // Tiles are whole pixels, the same way the shader divides gl_FragCoord,
+    // so the last row and column may be narrower
+    info.tile_size = glm::vec4(
+        static_cast<float>((width + dim_x - 1) / dim_x),
+        static_cast<float>((height + dim_y - 1) / dim_y), 0.f, 0.f);
+    auto to_ndc = [](const float px, const uint32_t size) {
+        return std::min(px / size * 2.f - 1.f, 1.f);
+    };
+
+    proj_y = 1.f / std::tan(glm::radians(cam.fov) * 0.5f);
+    proj_x = proj_y / cam.ratio;
+
+    const float scale = dim_z / std::log(cam.far / cam.near);
+    info.depth = glm::vec4(cam.near, cam.far, scale, std::log(cam.near));
+
+    for (uint32_t z = 0; z < dim_z; ++z) {
+        float d0 = cam.near * std::pow(cam.far / cam.near, static_cast<float>(z) / dim_z);
+        float d1 = cam.near * std::pow(cam.far / cam.near, static_cast<float>(z + 1) / dim_z);
+
+        for (uint32_t y = 0; y < dim_y; ++y) {
+            // Framebuffer y points down and the projection is flipped, so
+            // the top tile maps to positive view space y
+            float ny0 = to_ndc(y * info.tile_size.y, height);
+            float ny1 = to_ndc((y + 1) * info.tile_size.y, height);
+
+            for (uint32_t x = 0; x < dim_x; ++x) {
+                float nx0 = to_ndc(x * info.tile_size.x, width);
+                float nx1 = to_ndc((x + 1) * info.tile_size.x, width);
+
+                auto& box = bounds[cluster_index(x, y, z)];
+                box.min.x = std::min(nx0 * d0, nx0 * d1) / proj_x;
+                box.max.x = std::max(nx1 * d0, nx1 * d1) / proj_x;
+                box.min.y = std::min(-ny1 * d0, -ny1 * d1) / proj_y;
+                box.max.y = std::max(-ny0 * d0, -ny0 * d1) / proj_y;
+                box.min.z = -d1;
+                box.max.z = -d0;
+            }
+        }
+    }
+}
+
+void LightCluster::bin_sphere(const glm::vec3& center, const float radius,
+    const uint32_t light_idx)
+{
+    if (radius <= 0.f)
+        return;
+
+    const float near = info.depth.x;
+    const float far = info.depth.y;
+    const float depth = -center.z;
+    if (depth + radius < near || depth - radius > far)
+        return;
+
+    uint32_t z0 = slice_of(std::max(depth - radius, near));
+    uint32_t z1 = slice_of(std::min(depth + radius, far));
+
+    // Screen space tile range from the projected view space box of the
+    // sphere, x / depth is extremal at the box corners. Spheres crossing
+    // the near plane just take every tile
+    uint32_t x0 = 0, x1 = dim_x - 1;
+    uint32_t y0 = 0, y1 = dim_y - 1;
+    if (depth - radius > near) {
+        const float ds[] = {depth - radius, depth + radius};
+        float min_nx = 1e30f, max_nx = -1e30f;
+        float min_ny = 1e30f, max_ny = -1e30f;
+        for (auto d : ds) {
+            for (auto off : {-radius, radius}) {
+                float nx = (center.x + off) * proj_x / d;
+                float ny = -(center.y + off) * proj_y / d;
+                min_nx = std::min(min_nx, nx);
+                max_nx = std::max(max_nx, nx);
+                min_ny = std::min(min_ny, ny);
+                max_ny = std::max(max_ny, ny);
+            }
+        }
+
+        if (max_nx < -1.f || min_nx > 1.f || max_ny < -1.f || min_ny > 1.f)
+            return;
+
+        auto to_tile = [](const float n, const uint32_t size, const float tile,
+            const uint32_t dim)
+        {
+            float px = std::clamp((n + 1.f) * 0.5f, 0.f, 1.f) * size;
+            return std::min(static_cast<uint32_t>(px / tile), dim - 1);
+        };
+        x0 = to_tile(min_nx, bounds_extent.x, info.tile_size.x, dim_x);
+        x1 = to_tile(max_nx, bounds_extent.x, info.tile_size.x, dim_x);
+        y0 = to_tile(min_ny, bounds_extent.y, info.tile_size.y, dim_y);
+        y1 = to_tile(max_ny, bounds_extent.y, info.tile_size.y, dim_y);
+    }
+
+    const float r2 = radius * radius;
+    for (uint32_t z = z0; z <= z1; ++z) {
+        for (uint32_t y = y0; y <= y1; ++y) {
+            for (uint32_t x = x0; x <= x1; ++x) {
+                auto cluster = cluster_index(x, y, z);
+                auto& box = bounds[cluster];
+                glm::vec3 closest = glm::clamp(center, box.min, box.max);
+                glm::vec3 diff = closest - center;
+                if (glm::dot(diff, diff) > r2)
+                    continue;
+                pairs.push_back(static_cast<uint64_t>(cluster) << 32 | light_idx);
+            }
+        }
+    }
+}
+
+}
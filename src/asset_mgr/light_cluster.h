@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "concepts/camera.h"
+#include "concepts/lights.h"
+
+namespace vkkk
+{
+
+/************************************************************
+ * CPU light binning for clustered forward shading.
+ * The view frustum is split into froxels, X by Y screen tiles
+ * and Z slices distributed exponentially in view depth. Every
+ * point and spot light is treated as a sphere of its range
+ * and appended to the index list of each froxel it touches.
+ * Shaders look up their froxel from gl_FragCoord and the view
+ * depth and only loop over that list, directional lights
+ * affect everything and aren't binned.
+ * Cluster index is x + y * X + z * X * Y, spot lights are
+ * tagged with LIGHT_SPOT_FLAG in the index list.
+ ************************************************************/
+
+class LightCluster {
+public:
+    struct AABB {
+        glm::vec3                           min;
+        glm::vec3                           max;
+    };
+
+    LightCluster(const uint32_t x=CLUSTER_X, const uint32_t y=CLUSTER_Y,
+        const uint32_t z=CLUSTER_Z);
+
+    void build(const Camera& cam, const uint32_t width, const uint32_t height,
+        const std::vector<PointLight>& pt_lights, const std::vector<SpotLight>& spot_lights,
+        const uint32_t dir_light_cnt=0);
+
+    // Depth slice a positive view space distance falls in
+    uint32_t slice_of(const float depth) const;
+
+    inline uint32_t cluster_cnt() const {
+        return dim_x * dim_y * dim_z;
+    }
+
+    inline uint32_t cluster_index(const uint32_t x, const uint32_t y, const uint32_t z) const {
+        return x + y * dim_x + z * dim_x * dim_y;
+    }
+
+    inline const ClusterInfo& get_info() const {
+        return info;
+    }
+
+    // x : offset into the index list, y : light count
+    inline const std::vector<glm::uvec2>& get_ranges() const {
+        return ranges;
+    }
+
+    inline const std::vector<uint32_t>& get_indices() const {
+        return indices;
+    }
+
+    inline const AABB& get_bounds(const uint32_t cluster) const {
+        return bounds[cluster];
+    }
+
+private:
+    void update_bounds(const Camera& cam, const uint32_t width, const uint32_t height);
+    void bin_sphere(const glm::vec3& center, const float radius, const uint32_t light_idx);
+
+    uint32_t                                dim_x;
+    uint32_t                                dim_y;
+    uint32_t                                dim_z;
+
+    ClusterInfo                             info{};
+    std::vector<glm::uvec2>                 ranges;
+    std::vector<uint32_t>                   indices;
+
+    // View space bounds of every froxel, only rebuilt when the projection
+    // changes
+    std::vector<AABB>                       bounds;
+    glm::vec4                               bounds_key{0.f};
+    glm::uvec2                              bounds_extent{0};
+    // Scale from view space x/depth and y/depth to ndc
+    float                                   proj_x = 1.f;
+    float                                   proj_y = 1.f;
+
+    // (cluster << 32 | light) pairs, reused across builds
+    std::vector<uint64_t>                   pairs;
+};
+
+}
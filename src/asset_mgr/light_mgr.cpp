@@ -1,6 +1,15 @@
 
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include <fmt/format.h>
+
 #include "asset_mgr/light_mgr.h"
 #include "utils/macros.h"
+#include "vk_ins/vkabstraction.h"
+#include "vk_ins/vkubo.h"
 
 namespace vkkk
 {
@@ -26,6 +35,8 @@ void LightMgr::update_uniform(void* data) const {
     }
     */
 
+    warn_truncated();
+
     char* dest = reinterpret_cast<char*>(data);
     uint32_t cnt = pt_lights.size() < MAX_POINT_LIGHTS ? pt_lights.size() : MAX_POINT_LIGHTS;
     if (cnt > 0) {
@@ -49,6 +60,8 @@ void LightMgr::update_uniform(void* data) const {
 }
 
 void LightMgr::update_uniform(LightInfo& infos) const {
+    warn_truncated();
+
     uint32_t cnt = pt_lights.size() < MAX_POINT_LIGHTS ? pt_lights.size() : MAX_POINT_LIGHTS;
     if (cnt > 0)
         memcpy(&infos.pt_lights, pt_lights.data(), cnt * sizeof(PointLight));
@@ -62,4 +75,250 @@ void LightMgr::update_uniform(LightInfo& infos) const {
         memcpy(&infos.spot_lights, spot_lights.data(), cnt * sizeof(SpotLight));
 }
 
+void LightChangeLog::mark(const uint32_t begin, const uint32_t end) {
+    entries.push_back({++version, begin, end});
+    if (entries.size() <= capacity)
+        return;
+
+    // Fold the older half into one entry stamped with its newest version,
+    // any copy older than that still sees all of it
+    auto half = entries.size() / 2;
+    Entry folded{entries[half - 1].version, UINT32_MAX, 0};
+    for (size_t i = 0; i < half; ++i) {
+        folded.begin = std::min(folded.begin, entries[i].begin);
+        folded.end = std::max(folded.end, entries[i].end);
+    }
+    entries.erase(entries.begin() + 1, entries.begin() + half);
+    entries[0] = folded;
+}
+
+glm::uvec2 LightChangeLog::changed_since(const uint64_t since) const {
+    glm::uvec2 range(UINT32_MAX, 0);
+    for (auto it = entries.rbegin(); it != entries.rend() && it->version > since; ++it) {
+        range.x = std::min(range.x, it->begin);
+        range.y = std::max(range.y, it->end);
+    }
+    return range;
+}
+
+void LightMgr::set_pt_light(const uint32_t idx, const glm::vec4& pos, const glm::vec4& color,
+    const float range)
+{
+    if (idx >= pt_lights.size())
+        throw std::out_of_range(fmt::format("invalid point light index {}", idx));
+    pt_lights[idx] = PointLight{pos, color, glm::vec4(range, 0.f, 0.f, 0.f)};
+    logs[PT_LIGHT].mark(idx, idx + 1);
+}
+
+void LightMgr::set_dir_light(const uint32_t idx, const glm::vec4& dir, const glm::vec4& color) {
+    if (idx >= dir_lights.size())
+        throw std::out_of_range(fmt::format("invalid directional light index {}", idx));
+    dir_lights[idx] = DirectionalLight{dir, color};
+    logs[DIR_LIGHT].mark(idx, idx + 1);
+}
+
+void LightMgr::set_spot_light(const uint32_t idx, const glm::vec4& pos,
+    const glm::vec4& dir, const glm::vec3& color, const float angle, const float range)
+{
+    if (idx >= spot_lights.size())
+        throw std::out_of_range(fmt::format("invalid spot light index {}", idx));
+    spot_lights[idx] = SpotLight{pos, dir, color, angle, glm::vec4(range, 0.f, 0.f, 0.f)};
+    logs[SPOT_LIGHT].mark(idx, idx + 1);
+}
+
+void LightMgr::clear() {
+    // The removed slots count as changed so fixed layouts get them zeroed
+    for (int type = 0; type < LIGHT_TYPE_CNT; ++type) {
+        auto cnt = light_cnt(static_cast<LIGHT_TYPE>(type));
+        if (cnt > 0)
+            logs[type].mark(0, cnt);
+    }
+    pt_lights.clear();
+    dir_lights.clear();
+    spot_lights.clear();
+}
+
+glm::uvec2 LightMgr::dirty_range(const LIGHT_TYPE type, const uint64_t since) const {
+    if (since == NEVER_SYNCED)
+        return glm::uvec2(0, light_cnt(type));
+    return logs[type].changed_since(since);
+}
+
+template <typename T>
+static void write_fixed_range(char* dst, const std::vector<T>& lights, const uint32_t max_cnt,
+    const glm::uvec2 range)
+{
+    for (uint32_t i = range.x; i < std::min(range.y, max_cnt); ++i) {
+        if (i < lights.size())
+            memcpy(dst + i * sizeof(T), &lights[i], sizeof(T));
+        else
+            memset(dst + i * sizeof(T), 0, sizeof(T));
+    }
+}
+
+void LightMgr::update_uniform(UBODeprecated& ubo, const uint32_t idx) {
+    warn_truncated();
+
+    auto& copies = legacy_copies[&ubo];
+    if (copies.size() < ubo.memos.size())
+        copies.resize(ubo.memos.size());
+    auto& state = copies[idx];
+
+    // Slots past the light count are still part of the layout, a copy that
+    // was never written gets all of them so they read as zero
+    auto range_of = [&](const LIGHT_TYPE type, const uint32_t max_cnt) {
+        if (state.versions[type] == NEVER_SYNCED)
+            return glm::uvec2(0, max_cnt);
+        return dirty_range(type, state.versions[type]);
+    };
+    std::array<glm::uvec2, LIGHT_TYPE_CNT> ranges{
+        range_of(PT_LIGHT, MAX_POINT_LIGHTS),
+        range_of(DIR_LIGHT, MAX_DIRECTIONAL_LIGHTS),
+        range_of(SPOT_LIGHT, MAX_SPOT_LIGHTS)};
+
+    bool dirty = false;
+    for (auto& range : ranges)
+        dirty |= range.x < range.y;
+    if (!dirty)
+        return;
+
+    auto write = [&](char* dst) {
+        write_fixed_range(dst, pt_lights, MAX_POINT_LIGHTS, ranges[PT_LIGHT]);
+        dst += MAX_POINT_LIGHTS * sizeof(PointLight);
+        write_fixed_range(dst, dir_lights, MAX_DIRECTIONAL_LIGHTS, ranges[DIR_LIGHT]);
+        dst += MAX_DIRECTIONAL_LIGHTS * sizeof(DirectionalLight);
+        write_fixed_range(dst, spot_lights, MAX_SPOT_LIGHTS, ranges[SPOT_LIGHT]);
+    };
+
+    write(ubo.cpu_buf.get());
+
+    void* mapped = nullptr;
+    auto device = ubo.instance->get_device();
+    if (vkMapMemory(device, ubo.memos[idx], 0, ubo.size, 0, &mapped) != VK_SUCCESS)
+        throw std::runtime_error("failed to map light uniform memory");
+    write(reinterpret_cast<char*>(mapped));
+    vkUnmapMemory(device, ubo.memos[idx]);
+
+    for (int type = 0; type < LIGHT_TYPE_CNT; ++type)
+        state.versions[type] = logs[type].get_version();
+}
+
+bool LightMgr::sync_gpu(VkWrappedInstance* ins, const uint32_t idx, const Camera& cam) {
+    auto& extent = ins->get_swapchain_extent();
+    if (ssbo_copies.size() < ins->get_frames_in_flight())
+        ssbo_copies.resize(ins->get_frames_in_flight());
+    auto& state = ssbo_copies[idx];
+
+    ClusterKey key{
+        .view = cam.get_view_mat(),
+        .proj = glm::vec4(cam.fov, cam.ratio, cam.near, cam.far),
+        .extent = glm::uvec2(extent.width, extent.height),
+        .versions = {logs[PT_LIGHT].get_version(), logs[DIR_LIGHT].get_version(),
+            logs[SPOT_LIGHT].get_version()}
+    };
+    if (!(key == cluster_key)) {
+        cluster.build(cam, extent.width, extent.height, pt_lights, spot_lights,
+            dir_lights.size());
+        cluster_key = key;
+        ++cluster_version;
+    }
+
+    if (!sync_lights(ins, idx, PT_LIGHT, pt_light_buf_name, POINT_LIGHT_BINDING,
+            pt_lights.data(), sizeof(PointLight)) ||
+        !sync_lights(ins, idx, SPOT_LIGHT, spot_light_buf_name, SPOT_LIGHT_BINDING,
+            spot_lights.data(), sizeof(SpotLight)) ||
+        !sync_lights(ins, idx, DIR_LIGHT, dir_light_buf_name, DIR_LIGHT_BINDING,
+            dir_lights.data(), sizeof(DirectionalLight)))
+        return false;
+
+    if (ins->ubos.find(cluster_info_name) == ins->ubos.end() &&
+        !ins->add_ubo(cluster_info_name, CLUSTER_INFO_BINDING, sizeof(ClusterInfo)))
+            return false;
+
+    auto& ranges = cluster.get_ranges();
+    auto& indices = cluster.get_indices();
+    bool ranges_recreated = false, indices_recreated = false;
+    if (!reserve_ssbo(ins, cluster_range_buf_name, CLUSTER_RANGE_BINDING,
+            sizeof(glm::uvec2), ranges.size(), ranges_recreated) ||
+        !reserve_ssbo(ins, cluster_index_buf_name, CLUSTER_INDEX_BINDING,
+            sizeof(uint32_t), indices.size(), indices_recreated))
+        return false;
+    if (ranges_recreated || indices_recreated)
+        for (auto& copy : ssbo_copies)
+            copy.cluster_version = NEVER_SYNCED;
+
+    // Cluster lists follow the camera so they go up whole, but only once
+    // per build for each copy
+    if (state.cluster_version != cluster_version) {
+        ins->sync_uniform(ins->ubos.at(cluster_info_name).memos[idx], &cluster.get_info(),
+            sizeof(ClusterInfo));
+        ins->sync_uniform(ins->ssbos.at(cluster_range_buf_name).memos[idx], ranges.data(),
+            sizeof(glm::uvec2) * ranges.size());
+        if (!indices.empty())
+            ins->sync_uniform(ins->ssbos.at(cluster_index_buf_name).memos[idx], indices.data(),
+                sizeof(uint32_t) * indices.size());
+        state.cluster_version = cluster_version;
+    }
+    return true;
+}
+
+bool LightMgr::sync_lights(VkWrappedInstance* ins, const uint32_t idx, const LIGHT_TYPE type,
+    const char* name, const uint32_t binding, const void* data, const uint32_t elem_size)
+{
+    const auto cnt = light_cnt(type);
+    bool recreated = false;
+    if (!reserve_ssbo(ins, name, binding, elem_size, cnt, recreated))
+        return false;
+    if (recreated)
+        for (auto& copy : ssbo_copies)
+            copy.versions[type] = NEVER_SYNCED;
+
+    auto& synced = ssbo_copies[idx].versions[type];
+    auto range = dirty_range(type, synced);
+    range.y = std::min(range.y, cnt);
+    if (range.x < range.y) {
+        ins->sync_uniform(ins->ssbos.at(name).memos[idx],
+            reinterpret_cast<const char*>(data) + range.x * elem_size,
+            (range.y - range.x) * elem_size, range.x * elem_size);
+    }
+    synced = logs[type].get_version();
+    return true;
+}
+
+bool LightMgr::reserve_ssbo(VkWrappedInstance* ins, const char* name, const uint32_t binding,
+    const uint32_t elem_size, const uint32_t cnt, bool& recreated)
+{
+    // Buffers always exist so the descriptors stay valid with no lights
+    recreated = false;
+    auto& cap = gpu_capacities[name];
+    if (cap != 0 && cap >= cnt)
+        return true;
+
+    uint32_t new_cap = std::max<uint32_t>(16, cap);
+    while (new_cap < cnt)
+        new_cap *= 2;
+
+    ins->remove_ssbo(name);
+    if (!ins->add_ssbo(name, binding, elem_size, new_cap)) {
+        cap = 0;
+        return false;
+    }
+    cap = new_cap;
+    recreated = true;
+    return true;
+}
+
+void LightMgr::warn_truncated() const {
+    if (truncation_warned)
+        return;
+
+    if (pt_lights.size() > MAX_POINT_LIGHTS || dir_lights.size() > MAX_DIRECTIONAL_LIGHTS
+        || spot_lights.size() > MAX_SPOT_LIGHTS)
+    {
+        std::cout << "Light count exceeds the fixed uniform layout, extra lights are "
+            "dropped, use sync_gpu with the clustered shaders instead" << std::endl;
+        truncation_warned = true;
+    }
+}
+
 }
\ No newline at end of file
@@ -1,14 +1,69 @@
 #pragma once
 
 #include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "asset_mgr/light_cluster.h"
+#include "concepts/camera.h"
 #include "concepts/lights.h"
 #include "utils/singleton.h"
 
 namespace vkkk
 {
 
+class UBODeprecated;
+class VkWrappedInstance;
+
+enum LIGHT_TYPE {
+    PT_LIGHT,
+    DIR_LIGHT,
+    SPOT_LIGHT,
+    LIGHT_TYPE_CNT
+};
+
+// Version a GPU copy has before its first upload, always gets everything
+inline constexpr uint64_t NEVER_SYNCED = UINT64_MAX;
+
+/************************************************************
+ * Change log of one light array. Every modification bumps
+ * the version and records the touched index range, a GPU
+ * copy remembers the version it was last synced at and only
+ * uploads the union of the ranges changed after it. The log
+ * is bounded, old entries get folded together which only
+ * makes stale copies upload a bit more.
+ ************************************************************/
+
+class LightChangeLog {
+public:
+    void mark(const uint32_t begin, const uint32_t end);
+
+    // [x, y) changed after version since, empty when x >= y
+    glm::uvec2 changed_since(const uint64_t since) const;
+
+    inline uint64_t get_version() const {
+        return version;
+    }
+
+    inline size_t entry_cnt() const {
+        return entries.size();
+    }
+
+    static constexpr size_t capacity = 32;
+
+private:
+    struct Entry {
+        uint64_t                            version;
+        uint32_t                            begin;
+        uint32_t                            end;
+    };
+
+    std::vector<Entry>                      entries;
+    uint64_t                                version = 0;
+};
+
 // Add this for easier python binding
 struct LightInfo {
     std::array<PointLight, MAX_POINT_LIGHTS> pt_lights;
@@ -25,22 +80,86 @@ private:
     friend class Singleton<LightMgr>;
 
 public:
-    inline void add_pt_light(const glm::vec4& pos, const glm::vec4& color) {
-        pt_lights.emplace_back(pos, color);
+    inline void add_pt_light(const glm::vec4& pos, const glm::vec4& color,
+        const float range=10.f)
+    {
+        pt_lights.emplace_back(pos, color, glm::vec4(range, 0.f, 0.f, 0.f));
+        logs[PT_LIGHT].mark(pt_lights.size() - 1, pt_lights.size());
     }
 
     inline void add_dir_light(const glm::vec4& dir, const glm::vec4& color) {
         dir_lights.emplace_back(dir, color);
+        logs[DIR_LIGHT].mark(dir_lights.size() - 1, dir_lights.size());
     }
 
     inline void add_spot_light(const glm::vec4& pos,
-        const glm::vec4& dir, const glm::vec3& color, const float angle)
+        const glm::vec4& dir, const glm::vec3& color, const float angle,
+        const float range=10.f)
     {
-        spot_lights.emplace_back(pos, dir, color, angle);
+        spot_lights.emplace_back(pos, dir, color, angle, glm::vec4(range, 0.f, 0.f, 0.f));
+        logs[SPOT_LIGHT].mark(spot_lights.size() - 1, spot_lights.size());
     }
 
+    // Modify existing lights in place, only they get uploaded again
+    void set_pt_light(const uint32_t idx, const glm::vec4& pos, const glm::vec4& color,
+        const float range=10.f);
+    void set_dir_light(const uint32_t idx, const glm::vec4& dir, const glm::vec4& color);
+    void set_spot_light(const uint32_t idx, const glm::vec4& pos,
+        const glm::vec4& dir, const glm::vec3& color, const float angle,
+        const float range=10.f);
+    void clear();
+
+    // Fixed size layout of the legacy LightInfos uniform, lights past the
+    // MAX_* limits are dropped with a warning
     void update_uniform(void* data) const;
     void update_uniform(LightInfo& infos) const;
+    // Writes only what changed since the last update of frame in flight
+    // idx, to both the cpu side buffer and the gpu memory of ubo
+    void update_uniform(UBODeprecated& ubo, const uint32_t idx);
+
+    // Bins the lights into the froxels of cam and uploads lights and
+    // cluster lists to storage buffers for frame in flight idx, used by
+    // the clustered_lighting shaders. No limit on the light count
+    bool sync_gpu(VkWrappedInstance* ins, const uint32_t idx, const Camera& cam);
+
+    inline const LightCluster& get_cluster() const {
+        return cluster;
+    }
+
+    inline const LightChangeLog& get_log(const LIGHT_TYPE type) const {
+        return logs[type];
+    }
+
+    // Range of type that a copy synced at version since has to upload
+    glm::uvec2 dirty_range(const LIGHT_TYPE type, const uint64_t since) const;
+
+    inline const std::vector<PointLight>& get_pt_lights() const {
+        return pt_lights;
+    }
+
+    inline const std::vector<DirectionalLight>& get_dir_lights() const {
+        return dir_lights;
+    }
+
+    inline const std::vector<SpotLight>& get_spot_lights() const {
+        return spot_lights;
+    }
+
+    inline uint32_t light_cnt(const LIGHT_TYPE type) const {
+        switch (type) {
+            case PT_LIGHT:   return pt_lights.size();
+            case DIR_LIGHT:  return dir_lights.size();
+            case SPOT_LIGHT: return spot_lights.size();
+            default:         return 0;
+        }
+    }
+
+    static constexpr const char* cluster_info_name = "lights:cluster_info";
+    static constexpr const char* pt_light_buf_name = "lights:point";
+    static constexpr const char* spot_light_buf_name = "lights:spot";
+    static constexpr const char* dir_light_buf_name = "lights:directional";
+    static constexpr const char* cluster_range_buf_name = "lights:cluster_ranges";
+    static constexpr const char* cluster_index_buf_name = "lights:cluster_indices";
 
 private:
     // since the lights.h header is shared for shader code, we cannot
@@ -49,6 +168,41 @@ private:
     std::vector<PointLight> pt_lights;
     std::vector<DirectionalLight> dir_lights;
     std::vector<SpotLight> spot_lights;
+
+    std::array<LightChangeLog, LIGHT_TYPE_CNT> logs;
+
+    // What one GPU copy, a frame in flight's buffers, was last synced to
+    struct CopyState {
+        std::array<uint64_t, LIGHT_TYPE_CNT> versions{NEVER_SYNCED, NEVER_SYNCED, NEVER_SYNCED};
+        uint64_t cluster_version = NEVER_SYNCED;
+    };
+
+    // Inputs of the last cluster build, binning is skipped when the camera
+    // and the lights haven't moved
+    struct ClusterKey {
+        glm::mat4 view{0.f};
+        glm::vec4 proj{0.f};
+        glm::uvec2 extent{0};
+        std::array<uint64_t, LIGHT_TYPE_CNT> versions{};
+        bool operator==(const ClusterKey&) const = default;
+    };
+
+    LightCluster cluster;
+    ClusterKey cluster_key;
+    uint64_t cluster_version = 0;
+    std::vector<CopyState> ssbo_copies;
+    std::unordered_map<const UBODeprecated*, std::vector<CopyState>> legacy_copies;
+    // Element capacity of each storage buffer, keyed by buffer name
+    std::unordered_map<std::string, uint32_t> gpu_capacities;
+
+    // Creates or grows a storage buffer, recreated is set when the old
+    // contents are gone
+    bool reserve_ssbo(VkWrappedInstance* ins, const char* name, const uint32_t binding,
+        const uint32_t elem_size, const uint32_t cnt, bool& recreated);
+    bool sync_lights(VkWrappedInstance* ins, const uint32_t idx, const LIGHT_TYPE type,
+        const char* name, const uint32_t binding, const void* data, const uint32_t elem_size);
+    void warn_truncated() const;
+    mutable bool truncation_warned = false;
 };
 
 }
\ No newline at end of file
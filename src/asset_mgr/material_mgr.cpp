@@ -0,0 +1,97 @@
+#include <algorithm>
+
+#include "asset_mgr/material_mgr.h"
+#include "vk_ins/vkabstraction.h"
+
+namespace vkkk
+{
+
+MaterialMgr::MaterialMgr() {
+    materials.push_back(default_material());
+}
+
+uint32_t MaterialMgr::add_material(const Material& mat) {
+    materials.push_back(mat);
+    ++version;
+    return materials.size() - 1;
+}
+
+bool MaterialMgr::set_material(const uint32_t id, const Material& mat) {
+    if (id >= materials.size())
+        return false;
+    materials[id] = mat;
+    ++version;
+    return true;
+}
+
+bool MaterialMgr::set_texture(VkWrappedInstance* ins, const uint32_t id, const uint32_t kind,
+    const std::string& tex_name)
+{
+    if (id >= materials.size() || kind > MATERIAL_EMISSIVE)
+        return false;
+
+    auto found = texture_slots.find(tex_name);
+    if (found == texture_slots.end()) {
+        auto slot = ins->add_bindless_texture(tex_name);
+        if (slot == BINDLESS_NONE)
+            return false;
+        found = texture_slots.emplace(tex_name, slot).first;
+    }
+    materials[id].textures[kind] = found->second;
+    ++version;
+    return true;
+}
+
+bool MaterialMgr::assign(const NodeID node, const uint32_t id) {
+    if (id >= materials.size())
+        return false;
+    if (node >= node_materials.size())
+        node_materials.resize(node + 1, 0);
+    node_materials[node] = id;
+    ++version;
+    return true;
+}
+
+bool MaterialMgr::sync_gpu(VkWrappedInstance* ins, const uint32_t idx, const Scene& scene) {
+    if (synced_versions.size() < ins->get_frames_in_flight())
+        synced_versions.resize(ins->get_frames_in_flight(), UINT64_MAX);
+
+    auto reserve = [&](const char* name, const uint32_t binding, const uint32_t elem_size,
+        const uint32_t cnt)
+    {
+        auto& cap = gpu_capacities[name];
+        if (cap != 0 && cap >= cnt)
+            return true;
+
+        uint32_t new_cap = std::max<uint32_t>(64, cap);
+        while (new_cap < cnt)
+            new_cap *= 2;
+        ins->remove_ssbo(name);
+        if (!ins->add_ssbo(name, binding, elem_size, new_cap))
+            return false;
+        cap = new_cap;
+        std::fill(synced_versions.begin(), synced_versions.end(), UINT64_MAX);
+        return true;
+    };
+    // Every node of the scene gets an entry, drawn or not
+    if (!reserve(table_buf_name, MATERIAL_BINDING, sizeof(Material), materials.size()) ||
+        !reserve(node_buf_name, NODE_MATERIAL_BINDING, sizeof(uint32_t),
+            std::max({size_t(1), scene.size(), node_materials.size()})))
+        return false;
+
+    if (synced_versions[idx] == version)
+        return true;
+
+    ins->sync_uniform(ins->ssbos.at(table_buf_name).memos[idx], materials.data(),
+        sizeof(Material) * materials.size());
+    // Nodes never assigned use material 0
+    auto node_cap = gpu_capacities[node_buf_name];
+    std::vector<uint32_t> nodes(node_cap, 0);
+    std::copy(node_materials.begin(), node_materials.end(), nodes.begin());
+    ins->sync_uniform(ins->ssbos.at(node_buf_name).memos[idx], nodes.data(),
+        sizeof(uint32_t) * nodes.size());
+    synced_versions[idx] = version;
+    return true;
+}
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "asset_mgr/scene.h"
+#include "concepts/material.h"
+
+namespace vkkk
+{
+
+class VkWrappedInstance;
+
+/************************************************************
+ * Materials for the bindless path. The material table and a
+ * node to material map live in storage buffers, a shader finds
+ * its material through the node id draws pass as
+ * firstInstance, and its textures through the heap slots the
+ * material stores. Switching materials between draws then
+ * needs no descriptor work at all.
+ * Material 0 always exists and is what unassigned nodes use.
+ ************************************************************/
+
+class MaterialMgr {
+public:
+    MaterialMgr();
+
+    uint32_t add_material(const Material& mat=default_material());
+    bool set_material(const uint32_t id, const Material& mat);
+    // Puts a texture loaded with add_texture into the heap once and stores
+    // its slot at textures[kind], kind is one of MATERIAL_ALBEDO etc.
+    bool set_texture(VkWrappedInstance* ins, const uint32_t id, const uint32_t kind,
+        const std::string& tex_name);
+    bool assign(const NodeID node, const uint32_t id);
+
+    // Uploads both tables for frame in flight idx when they changed since
+    // its last upload, the node map covers every node of scene
+    bool sync_gpu(VkWrappedInstance* ins, const uint32_t idx, const Scene& scene);
+
+    inline uint32_t get_assigned(const NodeID node) const {
+        return node < node_materials.size() ? node_materials[node] : 0;
+    }
+
+    inline const std::vector<Material>& get_materials() const {
+        return materials;
+    }
+
+    inline uint64_t get_version() const {
+        return version;
+    }
+
+    static constexpr const char* table_buf_name = "material:table";
+    static constexpr const char* node_buf_name = "material:nodes";
+
+private:
+    std::vector<Material>                   materials;
+    std::vector<uint32_t>                   node_materials;
+    // Heap slot of every texture handed to set_texture
+    std::unordered_map<std::string, uint32_t>
+                                            texture_slots;
+
+    uint64_t                                version = 0;
+    std::vector<uint64_t>                   synced_versions;
+    std::unordered_map<std::string, uint32_t>
+                                            gpu_capacities;
+};
+
+}
@@ -1,8 +1,10 @@
 #include <iostream>
 
 #include <fmt/format.h>
+#include <glm/gtc/type_ptr.hpp>
 
 #include "asset_mgr/mesh_mgr.h"
+#include "utils/thread_pool.h"
 #include "vk_ins/vkabstraction.h"
 
 namespace vkkk
@@ -51,18 +53,31 @@ void MeshMgrDeprecated::load(const std::vector<VERT_COMP>& cs, const uint32_t v,
     meshes.emplace_back(std::move(m));
 }
 
-void MeshMgr::process_node(const std::string& name, aiNode *node, const aiScene *scene,
-    const std::vector<VERT_COMP>& cs)
+static glm::mat4 to_glm(const aiMatrix4x4& m) {
+    // aiMatrix4x4 is row major
+    return glm::transpose(glm::make_mat4(&m.a1));
+}
+
+void MeshMgr::process_node(const std::string& path, aiNode *node, const aiScene *scene,
+    const glm::mat4& parent, std::vector<ImportJob>& jobs)
 {
+    auto transform = parent * to_glm(node->mTransformation);
+
     for (int i = 0; i < node->mNumMeshes; ++i) {
-        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        Mesh m{cs};
-        m.load(mesh);
-        meshes.emplace(name, std::move(m));
+        jobs.emplace_back(ImportJob{
+            .key = fmt::format("{}:{}", path, i),
+            .mesh = scene->mMeshes[node->mMeshes[i]],
+            .transform = transform
+        });
     }
 
-    for (int i = 0; i < node->mNumChildren; ++i)
-        process_node(name, node->mChildren[i], scene, cs);
+    for (int i = 0; i < node->mNumChildren; ++i) {
+        auto child = node->mChildren[i];
+        // Unnamed or duplicated sibling names would collide, the child index
+        // keeps the path unique
+        std::string seg = child->mName.length > 0 ? child->mName.C_Str() : "node";
+        process_node(fmt::format("{}/{}.{}", path, seg, i), child, scene, transform, jobs);
+    }
 }
 
 void MeshMgr::load_file(const fs::path& path, const std::string& name,
@@ -79,8 +94,32 @@ void MeshMgr::load_file(const fs::path& path, const std::string& name,
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
         return;
 
-    auto idx = meshes.size();
-    process_node(name, scene->mRootNode, scene, cs);
+    load_scene(scene, name, cs);
+}
+
+void MeshMgr::load_scene(const aiScene* scene, const std::string& name,
+    const std::vector<VERT_COMP>& cs)
+{
+    // Flatten the node tree first, the conversion itself only reads the
+    // aiScene so the jobs can run concurrently
+    std::vector<ImportJob> jobs;
+    process_node(name, scene->mRootNode, scene, glm::mat4(1.f), jobs);
+
+    std::vector<Mesh> loaded(jobs.size(), Mesh{cs});
+    ThreadPool::instance().parallel_for(jobs.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+            loaded[i].load(jobs[i].mesh);
+    });
+
+    auto& keys = file_keys[name];
+    for (int i = 0; i < jobs.size(); ++i) {
+        if (meshes.contains(jobs[i].key))
+            meshes.erase(jobs[i].key);
+        else
+            keys.push_back(jobs[i].key);
+        meshes.emplace(jobs[i].key, std::move(loaded[i]));
+        transforms[jobs[i].key] = jobs[i].transform;
+    }
 }
 
 void MeshMgr::load(const std::string& name, const std::vector<VERT_COMP>& cs,
@@ -94,11 +133,18 @@ void MeshMgr::load(const std::string& name, const std::vector<VERT_COMP>& cs,
 
 void MeshMgr::upload_gpu(VkWrappedInstance* ins, const std::string& name) const {
     auto found = meshes.find(name);
-    if (found == meshes.end()) {
+    if (found != meshes.end()) {
+        ins->load_mesh(name, found->second);
+        return;
+    }
+
+    auto keys = file_keys.find(name);
+    if (keys == file_keys.end()) {
         std::cout << "Mesh with name " << name << " not found.." << std::endl;
         return;
     }
-    ins->load_mesh(name, found->second);
+    for (const auto& key : keys->second)
+        ins->load_mesh(key, meshes.at(key));
 }
 
 }
\ No newline at end of file
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "concepts/mesh.h"
 #include "utils/singleton.h"
@@ -61,18 +64,50 @@ private:
     MeshMgr& operator= (const MeshMgr&) = delete;
     friend class Singleton<MeshMgr>;
 
+    struct ImportJob {
+        std::string         key;
+        aiMesh*             mesh;
+        glm::mat4           transform;
+    };
+
     void process_node(const std::string&, aiNode* node, const aiScene* scene,
-        const std::vector<VERT_COMP>& cs);
+        const glm::mat4& parent, std::vector<ImportJob>& jobs);
 
 public:
+    // Every aiMesh in the file is stored under "name/node/path:idx", the
+    // accumulated node transform is kept along with it
     void load_file(const fs::path&, const std::string&, const std::vector<VERT_COMP>&);
+    // What load_file does once assimp is done, for scenes built in memory
+    void load_scene(const aiScene*, const std::string&, const std::vector<VERT_COMP>&);
     void load(const std::string&, const std::vector<VERT_COMP>&, const uint32_t,
         const char*, const uint32_t, const uint32_t, const char*, const uint32_t);
     
+    // Accepts either a single mesh key or a file name, the latter uploads
+    // all the meshes imported from it
     void upload_gpu(VkWrappedInstance*, const std::string&) const;
 
+    inline const std::vector<std::string>& get_keys(const std::string& name) const {
+        static const std::vector<std::string> empty;
+        auto found = file_keys.find(name);
+        return found == file_keys.end() ? empty : found->second;
+    }
+
+    inline const Mesh* get_mesh(const std::string& key) const {
+        auto found = meshes.find(key);
+        return found == meshes.end() ? nullptr : &found->second;
+    }
+
+    inline glm::mat4 get_transform(const std::string& key) const {
+        auto found = transforms.find(key);
+        return found == transforms.end() ? glm::mat4(1.f) : found->second;
+    }
+
 private:
     std::unordered_map<std::string, Mesh>   meshes;
+    std::unordered_map<std::string, glm::mat4>
+                                            transforms;
+    std::unordered_map<std::string, std::vector<std::string>>
+                                            file_keys;
 };
 
 }
\ No newline at end of file
@@ -1,16 +1,132 @@
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+#include <fmt/format.h>
 
-#include "asset_mgr/light_mgr.h"
 #include "asset_mgr/mesh_mgr.h"
 #include "asset_mgr/scene.h"
-#include "vk_ins/pipeline_mgr.h"
+#include "utils/simd.h"
+#include "vk_ins/vkabstraction.h"
 
 namespace vkkk
 {
 
-Scene::Scene()
-    : mesh_mgr(&MeshMgrDeprecated::instance())
-    , light_mgr(&LightMgr::instance())
-    //, ppl_mgr(&PipelineMgr::instance())
+Scene::Scene(const uint32_t binding)
+    : transform_binding(binding)
 {}
 
-}
\ No newline at end of file
+NodeID Scene::add_node(const std::string& name, const NodeID parent,
+    const glm::mat4& local, const std::string& mesh_key)
+{
+    if (parent != INVALID_NODE && parent >= parents.size())
+        throw std::out_of_range(fmt::format("invalid parent node {} for {}", parent, name));
+
+    NodeID id = parents.size();
+    parents.push_back(parent);
+    locals.push_back(local);
+    worlds.push_back(local);
+    dirty.push_back(1);
+    names.push_back(name);
+    mesh_keys.push_back(mesh_key);
+    name_lookup.emplace(name, id);
+    return id;
+}
+
+NodeID Scene::add_meshes(const MeshMgr& mgr, const std::string& name, const NodeID parent) {
+    auto root = add_node(name, parent);
+    for (const auto& key : mgr.get_keys(name))
+        add_node(key, root, mgr.get_transform(key), key);
+    return root;
+}
+
+void Scene::set_local(const NodeID id, const glm::mat4& local) {
+    locals[id] = local;
+    dirty[id] = 1;
+}
+
+NodeID Scene::find(const std::string& name) const {
+    auto found = name_lookup.find(name);
+    return found == name_lookup.end() ? INVALID_NODE : found->second;
+}
+
+uint32_t Scene::update() {
+    uint32_t updated = 0;
+    // Parents come first so their flag, and their world matrix, is already
+    // final by the time we reach the children
+    for (NodeID i = 0; i < parents.size(); ++i) {
+        auto parent = parents[i];
+        if (parent != INVALID_NODE)
+            dirty[i] |= dirty[parent];
+
+        if (!dirty[i])
+            continue;
+
+        if (parent == INVALID_NODE)
+            worlds[i] = locals[i];
+        else
+            simd::mat4_mul(&worlds[parent][0][0], &locals[i][0][0], &worlds[i][0][0]);
+        ++updated;
+    }
+
+    // Flags are cleared afterwards, children still need to see them above
+    if (updated > 0) {
+        std::fill(dirty.begin(), dirty.end(), 0);
+        ++version;
+    }
+    return updated;
+}
+
+bool Scene::sync_gpu(VkWrappedInstance* ins, const uint32_t idx) {
+    if (parents.empty())
+        return true;
+
+    if (gpu_capacity < parents.size()) {
+        // Grow geometrically so adding nodes one at a time doesn't keep
+        // stalling the device
+        uint32_t cap = std::max<uint32_t>(64, gpu_capacity);
+        while (cap < parents.size())
+            cap *= 2;
+
+        ins->remove_ssbo(transform_buf_name);
+        if (!ins->add_ssbo(transform_buf_name, transform_binding, sizeof(glm::mat4), cap))
+            return false;
+        gpu_capacity = cap;
+        synced_versions.assign(ins->get_frames_in_flight(), UINT64_MAX);
+    }
+
+    if (synced_versions[idx] == version)
+        return true;
+
+    auto& ssbo = ins->ssbos.at(transform_buf_name);
+    ins->sync_uniform(ssbo.memos[idx], worlds.data(), sizeof(glm::mat4) * worlds.size());
+    synced_versions[idx] = version;
+    return true;
+}
+
+void Scene::emit_draw_cmds(VkCommandBuffer cmd_buf, const VkWrappedInstance* ins,
+    const Pipeline* push_ppl) const
+{
+    VkBuffer bound_vbuf = VK_NULL_HANDLE;
+    VkBuffer bound_ibuf = VK_NULL_HANDLE;
+    for (NodeID i = 0; i < mesh_keys.size(); ++i) {
+        if (mesh_keys[i].empty())
+            continue;
+
+        auto found = ins->meshes.find(mesh_keys[i]);
+        if (found == ins->meshes.end())
+            continue;
+
+        const auto& mesh = found->second;
+        if (mesh.vbuf != bound_vbuf || mesh.ibuf != bound_ibuf) {
+            mesh.emit_bind_cmd(cmd_buf);
+            bound_vbuf = mesh.vbuf;
+            bound_ibuf = mesh.ibuf;
+        }
+        if (push_ppl != nullptr)
+            push_ppl->push(cmd_buf, worlds[i]);
+        mesh.emit_draw_only_cmd(cmd_buf, i);
+    }
+}
+
+}
@@ -1,19 +1,100 @@
 #pragma once
 
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
 namespace vkkk
 {
 
-class MeshMgrDeprecated;
-class LightMgr;
-class PipelineMgr;
+class MeshMgr;
+class VkWrappedInstance;
+struct Pipeline;
+
+using NodeID = uint32_t;
+inline constexpr NodeID INVALID_NODE = UINT32_MAX;
+
+/************************************************************
+ * Transform hierarchy stored as flat arrays, a node is always
+ * stored after its parent so one forward pass is enough to
+ * update the world matrices. Only dirty nodes and their
+ * descendants are recomputed.
+ * World matrices are uploaded to a storage buffer indexed by
+ * node id, draws pass the id as firstInstance so shaders can
+ * fetch it with gl_InstanceIndex.
+ ************************************************************/
 
 class Scene {
 public:
-    Scene();
+    Scene(const uint32_t binding=0);
+
+    NodeID add_node(const std::string& name, const NodeID parent=INVALID_NODE,
+        const glm::mat4& local=glm::mat4(1.f), const std::string& mesh_key="");
+    // Adds every mesh imported from a file under a new root node
+    NodeID add_meshes(const MeshMgr& mgr, const std::string& name,
+        const NodeID parent=INVALID_NODE);
+
+    void set_local(const NodeID id, const glm::mat4& local);
+    NodeID find(const std::string& name) const;
+
+    // Returns the number of world matrices recomputed
+    uint32_t update();
+
+    // Uploads world matrices for frame in flight idx if they changed since
+    // the last upload to it
+    bool sync_gpu(VkWrappedInstance* ins, const uint32_t idx);
+    // With push_ppl the world matrix of each node is pushed at offset 0
+    // before its draw, for shaders taking it as a push constant
+    void emit_draw_cmds(VkCommandBuffer cmd_buf, const VkWrappedInstance* ins,
+        const Pipeline* push_ppl=nullptr) const;
+
+    inline size_t size() const {
+        return parents.size();
+    }
+
+    inline const glm::mat4& get_local(const NodeID id) const {
+        return locals[id];
+    }
+
+    inline const glm::mat4& get_world(const NodeID id) const {
+        return worlds[id];
+    }
+
+    inline NodeID get_parent(const NodeID id) const {
+        return parents[id];
+    }
+
+    inline const std::string& get_mesh_key(const NodeID id) const {
+        return mesh_keys[id];
+    }
+
+    inline uint64_t get_version() const {
+        return version;
+    }
+
+    static constexpr const char* transform_buf_name = "scene:transforms";
+
+private:
+    std::vector<NodeID>                     parents;
+    std::vector<glm::mat4>                  locals;
+    std::vector<glm::mat4>                  worlds;
+    std::vector<uint8_t>                    dirty;
+    std::vector<std::string>                names;
+    std::vector<std::string>                mesh_keys;
+    std::unordered_map<std::string, NodeID> name_lookup;
 
-    MeshMgrDeprecated*        mesh_mgr;
-    LightMgr*       light_mgr;
-    PipelineMgr*    ppl_mgr;
+    // Bumped whenever a world matrix changes
+    uint64_t                                version = 0;
+    std::vector<uint64_t>                   synced_versions;
+    uint32_t                                gpu_capacity = 0;
+    uint32_t                                transform_binding;
 };
 
-}
\ No newline at end of file
+}
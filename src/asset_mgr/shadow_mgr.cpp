@@ -0,0 +1,288 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include "asset_mgr/light_mgr.h"
+#include "asset_mgr/shadow_mgr.h"
+#include "concepts/frustum.h"
+#include "vk_ins/vkabstraction.h"
+
+namespace vkkk
+{
+
+ShadowMgr::ShadowMgr(const ShadowConfig& cfg)
+    : cfg(cfg)
+    , atlas(cfg.atlas_size, cfg.min_tile)
+{
+    this->cfg.cascade_cnt = std::min<uint32_t>(cfg.cascade_cnt, MAX_CASCADES);
+}
+
+void ShadowMgr::update(const Camera& cam, const LightMgr& lights, const Scene& scene,
+    const std::unordered_map<std::string, MeshGPU>& meshes, const uint32_t screen_height)
+{
+    views.clear();
+    update_cascades(cam, lights);
+    update_atlas(cam, lights, screen_height);
+    cull_casters(scene, meshes);
+}
+
+void ShadowMgr::update_cascades(const Camera& cam, const LightMgr& lights) {
+    cascades.clear();
+    info.params = glm::uvec4(0, UINT32_MAX, lights.get_pt_lights().size(), 0);
+    info.splits = glm::vec4(cam.far);
+
+    auto& dir_lights = lights.get_dir_lights();
+    if (dir_lights.empty() || cfg.cascade_cnt == 0)
+        return;
+
+    cascades = fit_cascades(cam, glm::vec3(dir_lights[0].direction), cfg.cascade_cnt,
+        cfg.split_lambda, cfg.cascade_res, cfg.caster_extent);
+    info.params.x = cascades.size();
+    info.params.y = 0;
+
+    for (uint32_t i = 0; i < cascades.size(); ++i) {
+        info.cascades[i] = cascades[i].view_proj;
+        info.splits[i] = cascades[i].split;
+        views.push_back(ShadowView{
+            .view_proj = cascades[i].view_proj,
+            .layer = i,
+            .rect = {{0, 0}, {cfg.cascade_res, cfg.cascade_res}}
+        });
+    }
+}
+
+void ShadowMgr::update_atlas(const Camera& cam, const LightMgr& lights,
+    const uint32_t screen_height)
+{
+    auto& pt_lights = lights.get_pt_lights();
+    auto& spot_lights = lights.get_spot_lights();
+    light_tiles.assign(pt_lights.size() + spot_lights.size(), NO_SHADOW);
+    tiles.clear();
+
+    // Only lights that can touch what the camera sees
+    auto cam_frustum = Frustum::from_matrix(cam.get_proj_mat() * cam.get_view_mat());
+    std::vector<TileRequest> requests;
+    auto request = [&](const uint32_t i, const bool spot, const glm::vec4& pos,
+        const float range, const uint32_t faces)
+    {
+        if (range <= 0.f || !cam_frustum.intersect_sphere(glm::vec3(pos), range))
+            return;
+        auto res = shadow_resolution(cam, glm::vec3(pos), range, screen_height,
+            cfg.min_tile, cfg.max_tile);
+        requests.push_back({i, spot, res, faces});
+    };
+    for (uint32_t i = 0; i < pt_lights.size(); ++i)
+        request(i, false, pt_lights[i].pos, pt_lights[i].params.x, 6);
+    for (uint32_t i = 0; i < spot_lights.size(); ++i)
+        request(i, true, spot_lights[i].pos, spot_lights[i].params.x, 1);
+
+    // Largest first packs the buddy atlas without holes
+    std::stable_sort(requests.begin(), requests.end(), [](auto& a, auto& b) {
+        return a.res > b.res;
+    });
+
+    // Shrink the largest tiles until everything fits, past the minimum
+    // size whatever is left over goes unshadowed
+    struct Placement {
+        uint32_t                            req;
+        glm::uvec2                          offset;
+        uint32_t                            size;
+    };
+    std::vector<Placement> placed;
+    for (uint32_t cap = cfg.max_tile; ; cap /= 2) {
+        atlas.reset();
+        placed.clear();
+        bool all_fit = true;
+        for (uint32_t r = 0; r < requests.size() && all_fit; ++r) {
+            auto res = std::max(std::min(requests[r].res, cap), atlas.get_min_tile());
+            // All faces of a light or none of them
+            auto first = placed.size();
+            for (uint32_t f = 0; f < requests[r].faces; ++f) {
+                auto offset = atlas.alloc(res);
+                if (!offset) {
+                    placed.resize(first);
+                    all_fit = false;
+                    break;
+                }
+                placed.push_back({r, *offset, res});
+            }
+        }
+        if (all_fit || cap <= cfg.min_tile)
+            break;
+    }
+
+    const float inv_size = 1.f / atlas.get_size();
+    for (size_t p = 0; p < placed.size(); ) {
+        auto& req = requests[placed[p].req];
+        std::array<glm::mat4, 6> mats;
+        if (req.spot) {
+            auto& light = spot_lights[req.light];
+            mats[0] = spot_shadow_matrix(glm::vec3(light.pos), glm::vec3(light.direction),
+                light.angle, light.params.x);
+        }
+        else {
+            auto& light = pt_lights[req.light];
+            mats = point_shadow_matrices(glm::vec3(light.pos), light.params.x);
+        }
+
+        light_tiles[req.spot ? pt_lights.size() + req.light : req.light] = tiles.size();
+        for (uint32_t f = 0; f < req.faces; ++f, ++p) {
+            auto& tile = placed[p];
+            tiles.push_back(ShadowTile{
+                .view_proj = mats[f],
+                .rect = glm::vec4(glm::vec2(tile.offset) * inv_size,
+                    glm::vec2(tile.size * inv_size))
+            });
+            views.push_back(ShadowView{
+                .view_proj = mats[f],
+                .layer = ATLAS_LAYER,
+                .rect = {{static_cast<int32_t>(tile.offset.x), static_cast<int32_t>(tile.offset.y)},
+                    {tile.size, tile.size}}
+            });
+        }
+    }
+}
+
+void ShadowMgr::cull_casters(const Scene& scene,
+    const std::unordered_map<std::string, MeshGPU>& meshes)
+{
+    caster_spheres.clear();
+    caster_nodes.clear();
+    for (NodeID i = 0; i < scene.size(); ++i) {
+        auto& key = scene.get_mesh_key(i);
+        if (key.empty())
+            continue;
+        auto found = meshes.find(key);
+        if (found == meshes.end())
+            continue;
+
+        auto& world = scene.get_world(i);
+        auto& bounds = found->second.bounds;
+        float scale = std::max({glm::length(glm::vec3(world[0])),
+            glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))});
+        caster_spheres.push_back(glm::vec4(
+            glm::vec3(world * glm::vec4(glm::vec3(bounds), 1.f)), bounds.w * scale));
+        caster_nodes.push_back(i);
+    }
+
+    for (auto& view : views) {
+        auto frustum = Frustum::from_matrix(view.view_proj);
+        for (size_t c = 0; c < caster_nodes.size(); ++c)
+            if (frustum.intersect_sphere(glm::vec3(caster_spheres[c]), caster_spheres[c].w))
+                view.casters.push_back(caster_nodes[c]);
+    }
+}
+
+bool ShadowMgr::sync_gpu(VkWrappedInstance* ins, const uint32_t idx) {
+    if (!ins->ubos.contains(info_name) &&
+        !ins->add_ubo(info_name, SHADOW_INFO_BINDING, sizeof(ShadowInfo)))
+        return false;
+
+    // Rebinding drops cached sets, only do it when the targets changed
+    auto& targets = ins->shadow_targets;
+    auto bind = [&](const uint32_t binding, const VkDescriptorImageInfo& info) {
+        auto found = ins->bound_images.find(binding);
+        if (found == ins->bound_images.end() || found->second.imageView != info.imageView)
+            ins->bind_image(binding, info);
+    };
+    if (targets.created()) {
+        bind(CASCADE_MAP_BINDING, targets.cascade_descriptor);
+        bind(SHADOW_ATLAS_BINDING, targets.atlas_descriptor);
+    }
+
+    // Buffers always exist so the descriptors stay valid without shadows
+    auto reserve = [&](const char* name, const uint32_t binding, const uint32_t elem_size,
+        const uint32_t cnt)
+    {
+        auto& cap = gpu_capacities[name];
+        if (cap != 0 && cap >= cnt)
+            return true;
+
+        uint32_t new_cap = std::max<uint32_t>(16, cap);
+        while (new_cap < cnt)
+            new_cap *= 2;
+        ins->remove_ssbo(name);
+        if (!ins->add_ssbo(name, binding, elem_size, new_cap))
+            return false;
+        cap = new_cap;
+        return true;
+    };
+    if (!reserve(tile_buf_name, SHADOW_TILE_BINDING, sizeof(ShadowTile), tiles.size()) ||
+        !reserve(lookup_buf_name, SHADOW_LOOKUP_BINDING, sizeof(int32_t), light_tiles.size()))
+        return false;
+
+    // Everything follows the camera, small enough to go up whole
+    ins->sync_uniform(ins->ubos.at(info_name).memos[idx], &info, sizeof(ShadowInfo));
+    if (!tiles.empty())
+        ins->sync_uniform(ins->ssbos.at(tile_buf_name).memos[idx], tiles.data(),
+            sizeof(ShadowTile) * tiles.size());
+    if (!light_tiles.empty())
+        ins->sync_uniform(ins->ssbos.at(lookup_buf_name).memos[idx], light_tiles.data(),
+            sizeof(int32_t) * light_tiles.size());
+    return true;
+}
+
+void ShadowMgr::emit_cmds(VkCommandBuffer cmd_buf, const VkWrappedInstance* ins,
+    const Scene& scene, const std::string& pipeline_name) const
+{
+    auto& targets = ins->shadow_targets;
+    if (!targets.created() || views.empty())
+        return;
+    auto& pipeline = ins->pipelines.at(pipeline_name);
+
+    VkClearValue clear{};
+    clear.depthStencil = {1.f, 0};
+
+    for (auto& view : views) {
+        VkFramebuffer fb;
+        if (view.layer == ATLAS_LAYER)
+            fb = targets.atlas_fb;
+        else if (view.layer < targets.cascade_fbs.size())
+            fb = targets.cascade_fbs[view.layer];
+        else
+            continue;
+
+        // Render area limits the clear to the tile, the rest of the atlas
+        // keeps what earlier passes wrote this frame
+        VkRenderPassBeginInfo begin_info{};
+        begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        begin_info.renderPass = targets.render_pass;
+        begin_info.framebuffer = fb;
+        begin_info.renderArea = view.rect;
+        begin_info.clearValueCount = 1;
+        begin_info.pClearValues = &clear;
+        vkCmdBeginRenderPass(cmd_buf, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+        vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
+
+        VkViewport viewport{};
+        viewport.x = static_cast<float>(view.rect.offset.x);
+        viewport.y = static_cast<float>(view.rect.offset.y);
+        viewport.width = static_cast<float>(view.rect.extent.width);
+        viewport.height = static_cast<float>(view.rect.extent.height);
+        viewport.minDepth = 0.f;
+        viewport.maxDepth = 1.f;
+        vkCmdSetViewport(cmd_buf, 0, 1, &viewport);
+        vkCmdSetScissor(cmd_buf, 0, 1, &view.rect);
+        vkCmdSetDepthBias(cmd_buf, cfg.bias_constant, 0.f, cfg.bias_slope);
+
+        VkBuffer bound_vbuf = VK_NULL_HANDLE;
+        VkBuffer bound_ibuf = VK_NULL_HANDLE;
+        for (auto node : view.casters) {
+            auto found = ins->meshes.find(scene.get_mesh_key(node));
+            if (found == ins->meshes.end())
+                continue;
+
+            const auto& mesh = found->second;
+            if (mesh.vbuf != bound_vbuf || mesh.ibuf != bound_ibuf) {
+                mesh.emit_bind_cmd(cmd_buf);
+                bound_vbuf = mesh.vbuf;
+                bound_ibuf = mesh.ibuf;
+            }
+            pipeline.push(cmd_buf, view.view_proj * scene.get_world(node));
+            mesh.emit_draw_only_cmd(cmd_buf, node);
+        }
+        vkCmdEndRenderPass(cmd_buf);
+    }
+}
+
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "asset_mgr/scene.h"
+#include "concepts/camera.h"
+#include "concepts/lights.h"
+#include "concepts/shadow.h"
+
+namespace vkkk
+{
+
+class LightMgr;
+class VkWrappedInstance;
+struct MeshGPU;
+
+struct ShadowConfig {
+    uint32_t                                cascade_cnt = 4;
+    uint32_t                                cascade_res = 2048;
+    float                                   split_lambda = 0.75f;
+    // How far behind a cascade casters are still picked up
+    float                                   caster_extent = 50.f;
+    uint32_t                                atlas_size = 4096;
+    uint32_t                                min_tile = 128;
+    uint32_t                                max_tile = 1024;
+    float                                   bias_constant = 1.25f;
+    float                                   bias_slope = 1.75f;
+};
+
+// One depth pass, a cascade layer or a tile of the atlas
+struct ShadowView {
+    glm::mat4                               view_proj;
+    uint32_t                                layer;
+    VkRect2D                                rect;
+    std::vector<NodeID>                     casters;
+};
+
+inline constexpr uint32_t ATLAS_LAYER = UINT32_MAX;
+inline constexpr int32_t NO_SHADOW = -1;
+
+/************************************************************
+ * Shadow maps for the lights of LightMgr.
+ * The first directional light gets cascades fitted to the
+ * camera frustum. Spot and point lights visible to the camera
+ * get atlas tiles sized by their screen coverage, a point
+ * light takes six. When the atlas can't hold every request
+ * the largest tile size is halved until it does, lights that
+ * still don't fit go unshadowed.
+ * Casters are culled per view against the scene's node
+ * bounds, passes are depth only with the mvp pushed per draw.
+ ************************************************************/
+
+class ShadowMgr {
+public:
+    ShadowMgr(const ShadowConfig& cfg=ShadowConfig{});
+
+    void update(const Camera& cam, const LightMgr& lights, const Scene& scene,
+        const std::unordered_map<std::string, MeshGPU>& meshes, const uint32_t screen_height);
+
+    // Uploads ShadowInfo, tiles and the tile lookup for frame in flight idx
+    bool sync_gpu(VkWrappedInstance* ins, const uint32_t idx);
+    // Records every shadow pass, call outside of any render pass
+    void emit_cmds(VkCommandBuffer cmd_buf, const VkWrappedInstance* ins, const Scene& scene,
+        const std::string& pipeline_name) const;
+
+    inline const ShadowConfig& get_config() const {
+        return cfg;
+    }
+
+    inline const std::vector<ShadowView>& get_views() const {
+        return views;
+    }
+
+    inline const std::vector<ShadowCascade>& get_cascades() const {
+        return cascades;
+    }
+
+    inline const std::vector<ShadowTile>& get_tiles() const {
+        return tiles;
+    }
+
+    // First tile of every point light followed by every spot light,
+    // NO_SHADOW for unshadowed ones
+    inline const std::vector<int32_t>& get_light_tiles() const {
+        return light_tiles;
+    }
+
+    inline const ShadowInfo& get_info() const {
+        return info;
+    }
+
+    inline const ShadowAtlas& get_atlas() const {
+        return atlas;
+    }
+
+    static constexpr const char* info_name = "shadow:info";
+    static constexpr const char* tile_buf_name = "shadow:tiles";
+    static constexpr const char* lookup_buf_name = "shadow:lookup";
+
+private:
+    struct TileRequest {
+        uint32_t                            light;
+        bool                                spot;
+        uint32_t                            res;
+        uint32_t                            faces;
+    };
+
+    void update_cascades(const Camera& cam, const LightMgr& lights);
+    void update_atlas(const Camera& cam, const LightMgr& lights, const uint32_t screen_height);
+    void cull_casters(const Scene& scene, const std::unordered_map<std::string, MeshGPU>& meshes);
+
+    ShadowConfig                            cfg;
+    ShadowAtlas                             atlas;
+    ShadowInfo                              info{};
+    std::vector<ShadowCascade>              cascades;
+    std::vector<ShadowTile>                 tiles;
+    std::vector<int32_t>                    light_tiles;
+    std::vector<ShadowView>                 views;
+
+    // World space caster spheres, rebuilt by every update
+    std::vector<glm::vec4>                  caster_spheres;
+    std::vector<NodeID>                     caster_nodes;
+
+    std::unordered_map<std::string, uint32_t>
+                                            gpu_capacities;
+};
+
+}
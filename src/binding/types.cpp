@@ -56,6 +56,26 @@ void bind_types(nb::module_& m) {
         .value("CW", VK_FRONT_FACE_CLOCKWISE)
         .export_values();
 
+    nb::enum_<VkPresentModeKHR>(m, "vkPresentMode")
+        .value("IMMEDIATE", VK_PRESENT_MODE_IMMEDIATE_KHR)
+        .value("MAILBOX", VK_PRESENT_MODE_MAILBOX_KHR)
+        .value("FIFO", VK_PRESENT_MODE_FIFO_KHR)
+        .value("FIFO_RELAXED", VK_PRESENT_MODE_FIFO_RELAXED_KHR)
+        .export_values();
+
+    nb::enum_<VkDynamicState>(m, "vkDynamicState")
+        .value("VIEWPORT", VK_DYNAMIC_STATE_VIEWPORT)
+        .value("SCISSOR", VK_DYNAMIC_STATE_SCISSOR)
+        .value("LINE_WIDTH", VK_DYNAMIC_STATE_LINE_WIDTH)
+        .value("DEPTH_BIAS", VK_DYNAMIC_STATE_DEPTH_BIAS)
+        .value("CULL_MODE", VK_DYNAMIC_STATE_CULL_MODE_EXT)
+        .value("FRONT_FACE", VK_DYNAMIC_STATE_FRONT_FACE_EXT)
+        .value("PRIMITIVE_TOPOLOGY", VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT)
+        .value("DEPTH_TEST_ENABLE", VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT)
+        .value("DEPTH_WRITE_ENABLE", VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT)
+        .value("DEPTH_COMPARE_OP", VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT)
+        .export_values();
+
     nb::enum_<VkSampleCountFlagBits>(m, "vkSampleCount")
         .value("_1", VK_SAMPLE_COUNT_1_BIT)
         .value("_2", VK_SAMPLE_COUNT_2_BIT)
@@ -187,13 +207,51 @@ void bind_types(nb::module_& m) {
         .value("COLOR", VERT_COMP::COLOR)
         .export_values();
 
+    nb::enum_<ShaderOptimization>(m, "ShaderOptimization")
+        .value("none", ShaderOptimization::none)
+        .value("performance", ShaderOptimization::performance)
+        .value("size", ShaderOptimization::size);
+
+    nb::class_<ShaderBuildStats>(m, "ShaderBuildStats")
+        .def_ro("module_cnt", &ShaderBuildStats::module_cnt)
+        .def_ro("reflect_size", &ShaderBuildStats::reflect_size)
+        .def_ro("reflect_ms", &ShaderBuildStats::reflect_ms)
+        .def_ro("spirv_size", &ShaderBuildStats::spirv_size)
+        .def_ro("optimize_ms", &ShaderBuildStats::optimize_ms);
+
+    m.def("shader_build_stats", &shader_build_stats);
+
     nb::class_<ShaderModule> smcl(m, "ShaderModule");
     
     smcl.def(nb::init<>())
         .def("load", [](ShaderModule& m, const std::string& path, VkShaderStageFlagBits stage) {
             return m.load(path, stage);
         })
-        .def("get_uniform_info", &ShaderModule::get_uniform_info);
+        .def("get_uniform_info", &ShaderModule::get_uniform_info)
+        .def("add_include_dir", [](ShaderModule& m, const std::string& dir) {
+            m.include_dirs.emplace_back(dir);
+        })
+        .def("get_dependencies", [](const ShaderModule& m) {
+            std::vector<std::string> deps;
+            for (auto& dep : m.dependencies)
+                deps.push_back(dep.string());
+            return deps;
+        })
+        .def("set_spec_constant", &ShaderModule::set_spec_constant<bool>)
+        .def("set_spec_constant", &ShaderModule::set_spec_constant<int32_t>)
+        .def("set_spec_constant", &ShaderModule::set_spec_constant<float>)
+        .def_rw("optimization", &ShaderModule::optimization)
+        .def_ro("build_stats", &ShaderModule::build_stats)
+        .def("get_spec_infos", [](const ShaderModule& m) {
+            return std::map<std::string, std::tuple<uint32_t, uint32_t>>(
+                m.spec_infos.begin(), m.spec_infos.end());
+        });
+
+    nb::class_<PipelineHandle>(m, "PipelineHandle")
+        .def("valid", &PipelineHandle::valid)
+        .def("ready", &PipelineHandle::ready)
+        .def("wait", &PipelineHandle::wait)
+        .def("get_name", &PipelineHandle::get_name);
 
     nb::class_<PipelineOption>(m, "PipelineOption")
         .def(nb::init<>())
@@ -202,7 +260,19 @@ void bind_types(nb::module_& m) {
         .def("setup_scissor", &PipelineOption::setup_scissor)
         .def("setup_rasterizer", &PipelineOption::setup_rasterizer)
         .def("setup_multisampling", &PipelineOption::setup_multisampling)
-        .def("setup_depth_stencil", &PipelineOption::setup_depth_stencil);
+        .def("setup_depth_stencil", &PipelineOption::setup_depth_stencil)
+        .def("add_dynamic_state", &PipelineOption::add_dynamic_state)
+        .def("add_extended_dynamic_states", &PipelineOption::add_extended_dynamic_states)
+        .def_rw("dynamic_states", &PipelineOption::dynamic_states)
+        .def_rw("immutable_samplers", &PipelineOption::immutable_samplers);
+
+    nb::class_<FrameStats> fscl(m, "FrameStats");
+
+    fscl.def_ro("frame_cnt", &FrameStats::frame_cnt)
+        .def_ro("last_wait", &FrameStats::last_wait)
+        .def_ro("max_wait", &FrameStats::max_wait)
+        .def_ro("total_wait", &FrameStats::total_wait)
+        .def("avg_wait", &FrameStats::avg_wait);
 
     nb::class_<VkWrappedInstance> incl(m, "VkInstance");
 
@@ -223,14 +293,46 @@ void bind_types(nb::module_& m) {
         .def("create_framebuffer_from_targets", &VkWrappedInstance::create_framebuffer_from_targets)
         .def("create_resources", &VkWrappedInstance::create_resources)
         .def("create_sync_objects", &VkWrappedInstance::create_sync_objects)
+        .def("set_frames_in_flight", &VkWrappedInstance::set_frames_in_flight)
+        .def("get_frames_in_flight", &VkWrappedInstance::get_frames_in_flight)
+        .def("set_frame_latency", &VkWrappedInstance::set_frame_latency)
+        .def("get_frame_stats", &VkWrappedInstance::get_frame_stats)
+        .def("timeline_semaphore_enabled", &VkWrappedInstance::timeline_semaphore_enabled)
+        .def("extended_dynamic_state_enabled", &VkWrappedInstance::extended_dynamic_state_enabled)
+        .def("set_present_mode", &VkWrappedInstance::set_present_mode)
+        .def("get_present_mode", &VkWrappedInstance::get_present_mode)
+        .def("set_swapchain_image_cnt", &VkWrappedInstance::set_swapchain_image_cnt)
+        .def("set_frame_limit", &VkWrappedInstance::set_frame_limit)
         .def("mainloop", &VkWrappedInstance::mainloop)
         .def("get_image_buffer", &VkWrappedInstance::get_image_buffer)
         .def("create_pipeline", &VkWrappedInstance::create_pipeline)
+        .def("create_pipeline_async", &VkWrappedInstance::create_pipeline_async,
+            nb::arg("name"), nb::arg("modules"), nb::arg("comps"), nb::arg("option"),
+            nb::arg("fallback") = "")
+        .def("poll_pipelines", &VkWrappedInstance::poll_pipelines)
+        .def("pipeline_ready", &VkWrappedInstance::pipeline_ready)
+        .def("enable_shader_hot_reload", &VkWrappedInstance::enable_shader_hot_reload,
+            nb::arg("enable") = true)
+        .def("poll_shader_reloads", &VkWrappedInstance::poll_shader_reloads)
+        .def("set_pipeline_cache_path", [](VkWrappedInstance& ins, const std::string& path) {
+            ins.set_pipeline_cache_path(path);
+        })
+        .def("save_pipeline_cache", &VkWrappedInstance::save_pipeline_cache)
         .def("create_attachment", &VkWrappedInstance::create_attachment)
         .def("create_render_target", &VkWrappedInstance::create_render_target)
         .def("create_render_target_from_swapchain", &VkWrappedInstance::create_render_target_from_swapchain)
+        .def("create_shadow_targets", &VkWrappedInstance::create_shadow_targets)
+        .def("destroy_shadow_targets", &VkWrappedInstance::destroy_shadow_targets)
+        .def("create_shadow_pipeline", &VkWrappedInstance::create_shadow_pipeline)
+        .def("create_bindless_heap", &VkWrappedInstance::create_bindless_heap,
+            nb::arg("image_cnt") = 4096, nb::arg("buffer_cnt") = 1024)
+        .def("add_bindless_texture", &VkWrappedInstance::add_bindless_texture)
+        .def("remove_bindless_texture", &VkWrappedInstance::remove_bindless_texture)
+        .def("descriptor_indexing_enabled", &VkWrappedInstance::descriptor_indexing_enabled)
         .def("find_depth_format", &VkWrappedInstance::find_depth_format)
-        .def("load_mesh", &VkWrappedInstance::load_mesh);
+        .def("load_mesh", &VkWrappedInstance::load_mesh)
+        .def("unload_mesh", &VkWrappedInstance::unload_mesh)
+        .def("setup_geometry_pool_size", &VkWrappedInstance::setup_geometry_pool_size);
 
     nb::class_<UniformMgr> umcl(m, "UniformMgr");
 
@@ -332,6 +434,8 @@ void bind_types(nb::module_& m) {
             const uint32_t v, nb::bytes& vbuf, const uint32_t i, nb::bytes& ibuf) {
                 mgr.load(name, cs, v, vbuf.c_str(), vbuf.size(), i, ibuf.c_str(), ibuf.size());
         })
+        .def("get_keys", &MeshMgr::get_keys)
+        .def("get_transform", &MeshMgr::get_transform)
         .def("upload_gpu", &MeshMgr::upload_gpu);        
 
     nb::class_<LightInfo> licl(m, "LightInfo");
@@ -343,9 +447,20 @@ void bind_types(nb::module_& m) {
     nb::class_<LightMgr> lmcl(m, "LightMgr");
 
     lmcl.def_static("Instance", nb::overload_cast<>(&LightMgr::instance_ptr<>))
-        .def("add_pt_light", &LightMgr::add_pt_light)
+        .def("add_pt_light", &LightMgr::add_pt_light,
+            nb::arg("pos"), nb::arg("color"), nb::arg("range") = 10.f)
         .def("add_dir_light", &LightMgr::add_dir_light)
-        .def("add_spot_light", &LightMgr::add_spot_light);
+        .def("add_spot_light", &LightMgr::add_spot_light,
+            nb::arg("pos"), nb::arg("dir"), nb::arg("color"), nb::arg("angle"),
+            nb::arg("range") = 10.f)
+        .def("set_pt_light", &LightMgr::set_pt_light,
+            nb::arg("idx"), nb::arg("pos"), nb::arg("color"), nb::arg("range") = 10.f)
+        .def("set_dir_light", &LightMgr::set_dir_light)
+        .def("set_spot_light", &LightMgr::set_spot_light,
+            nb::arg("idx"), nb::arg("pos"), nb::arg("dir"), nb::arg("color"),
+            nb::arg("angle"), nb::arg("range") = 10.f)
+        .def("clear", &LightMgr::clear)
+        .def("sync_gpu", &LightMgr::sync_gpu);
 
     nb::class_<Camera> cmcl(m, "Camera");
     cmcl.def(nb::init<>())
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <array>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace vkkk
+{
+
+struct Frustum {
+    // Planes are stored as (normal, distance) with normals pointing inwards
+    // Order : left, right, bottom, top, near, far
+    std::array<glm::vec4, 6> planes;
+
+    // Gribb-Hartmann extraction, expects the [0, 1] depth range we force
+    // for glm, the flipped y of our projection matrices only swaps top
+    // and bottom
+    static inline Frustum from_matrix(const glm::mat4& m) {
+        auto row = [&](int i) {
+            return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+        };
+
+        Frustum f;
+        f.planes[0] = row(3) + row(0);
+        f.planes[1] = row(3) - row(0);
+        f.planes[2] = row(3) + row(1);
+        f.planes[3] = row(3) - row(1);
+        f.planes[4] = row(2);
+        f.planes[5] = row(3) - row(2);
+
+        for (auto& p : f.planes)
+            p /= glm::length(glm::vec3(p));
+        return f;
+    }
+
+    inline bool intersect_sphere(const glm::vec3& center, const float radius) const {
+        for (const auto& p : planes)
+            if (glm::dot(glm::vec3(p), center) + p.w < -radius)
+                return false;
+        return true;
+    }
+};
+
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <assimp/mesh.h>
+#include <fmt/format.h>
+
+#include "utils/simd.h"
+#include "utils/thread_pool.h"
+#include "vk_ins/types.h"
+
+namespace vkkk
+{
+
+static_assert(sizeof(ai_real) == sizeof(float), "interleaver expects single precision assimp");
+
+// Per component source description, width is what ends up in the vertex
+// buffer, src_stride is the float count of the assimp element
+template <VERT_COMP C>
+struct CompTraits;
+
+template <>
+struct CompTraits<VERTEX> {
+    static constexpr uint32_t width = 3;
+    static constexpr uint32_t src_stride = 3;
+    static inline const float* source(const aiMesh* m) {
+        return m->mVertices ? &m->mVertices[0].x : nullptr;
+    }
+};
+
+template <>
+struct CompTraits<NORMAL> {
+    static constexpr uint32_t width = 3;
+    static constexpr uint32_t src_stride = 3;
+    static inline const float* source(const aiMesh* m) {
+        return m->mNormals ? &m->mNormals[0].x : nullptr;
+    }
+};
+
+template <>
+struct CompTraits<UV> {
+    static constexpr uint32_t width = 2;
+    static constexpr uint32_t src_stride = 3;
+    static inline const float* source(const aiMesh* m) {
+        return m->mTextureCoords[0] ? &m->mTextureCoords[0][0].x : nullptr;
+    }
+};
+
+template <>
+struct CompTraits<COLOR> {
+    static constexpr uint32_t width = 3;
+    static constexpr uint32_t src_stride = 4;
+    static inline const float* source(const aiMesh* m) {
+        return m->mColors[0] ? &m->mColors[0][0].r : nullptr;
+    }
+};
+
+// Vertices above this count get split across the thread pool
+inline constexpr uint32_t INTERLEAVE_PARALLEL_THRESHOLD = 1 << 17;
+
+template <VERT_COMP... Cs>
+struct Interleaver {
+    static constexpr uint32_t stride = (CompTraits<Cs>::width + ...);
+
+    // Writes vertices [begin, end). Every attribute goes out as a 4 float
+    // store, the spilled lane lands on the next attribute (or the next
+    // vertex) which is written right after. The last vertex of the range
+    // is done exactly so ranges can be processed concurrently
+    static void run(const aiMesh* mesh, float* dst, const size_t begin, const size_t end) {
+        const float* srcs[] = {CompTraits<Cs>::source(mesh)...};
+        for (auto src : srcs)
+            if (src == nullptr)
+                throw std::runtime_error("mesh lacks a requested vertex component");
+
+        if (begin >= end)
+            return;
+
+        for (size_t i = begin; i < end - 1; ++i)
+            write_vertex<true>(srcs, dst, i);
+        write_vertex<false>(srcs, dst, end - 1);
+    }
+
+    static void run(const aiMesh* mesh, float* dst) {
+        const size_t n = mesh->mNumVertices;
+        if (n < INTERLEAVE_PARALLEL_THRESHOLD) {
+            run(mesh, dst, 0, n);
+            return;
+        }
+
+        ThreadPool::instance().parallel_for(n, [&](size_t begin, size_t end) {
+            run(mesh, dst, begin, end);
+        }, INTERLEAVE_PARALLEL_THRESHOLD / 4);
+    }
+
+private:
+    template <bool Wide>
+    static inline void write_vertex(const float* const* srcs, float* dst, const size_t i) {
+        float* out = dst + i * stride;
+        uint32_t idx = 0;
+        (write_comp<Cs, Wide>(srcs[idx++], out, i), ...);
+    }
+
+    template <VERT_COMP C, bool Wide>
+    static inline void write_comp(const float* src, float*& out, const size_t i) {
+        using T = CompTraits<C>;
+        // Reading 4 floats is fine as long as i isn't the last source element
+        if constexpr (Wide)
+            simd::copy4_f32(src + i * T::src_stride, out);
+        else
+            memcpy(out, src + i * T::src_stride, sizeof(float) * T::width);
+        out += T::width;
+    }
+};
+
+// Generic single pass fallback for layouts without a specialization
+inline void interleave_generic(const aiMesh* mesh, const std::vector<VERT_COMP>& comps,
+    float* dst)
+{
+    struct Src {
+        const float*    ptr;
+        uint32_t        width;
+        uint32_t        src_stride;
+    };
+
+    std::vector<Src> srcs;
+    uint32_t stride = 0;
+    for (const auto& comp : comps) {
+        Src s{};
+        switch (comp) {
+            case VERTEX: s = {CompTraits<VERTEX>::source(mesh), 3, 3}; break;
+            case NORMAL: s = {CompTraits<NORMAL>::source(mesh), 3, 3}; break;
+            case UV:     s = {CompTraits<UV>::source(mesh), 2, 3}; break;
+            case COLOR:  s = {CompTraits<COLOR>::source(mesh), 3, 4}; break;
+        }
+        if (s.ptr == nullptr)
+            throw std::runtime_error(fmt::format("mesh lacks vertex component {}",
+                static_cast<int>(comp)));
+        srcs.push_back(s);
+        stride += s.width;
+    }
+
+    for (size_t i = 0; i < mesh->mNumVertices; ++i) {
+        float* out = dst + i * stride;
+        for (const auto& s : srcs) {
+            memcpy(out, s.ptr + i * s.src_stride, sizeof(float) * s.width);
+            out += s.width;
+        }
+    }
+}
+
+template <VERT_COMP... Cs>
+inline bool match_layout(const std::vector<VERT_COMP>& comps) {
+    constexpr VERT_COMP layout[] = {Cs...};
+    return comps.size() == sizeof...(Cs) && std::equal(comps.begin(), comps.end(), layout);
+}
+
+// Packs the requested attributes of mesh into dst, common layouts are
+// dispatched to the specialized kernels
+inline void interleave_attributes(const aiMesh* mesh, const std::vector<VERT_COMP>& comps,
+    float* dst)
+{
+    if (match_layout<VERTEX>(comps))
+        Interleaver<VERTEX>::run(mesh, dst);
+    else if (match_layout<VERTEX, NORMAL>(comps))
+        Interleaver<VERTEX, NORMAL>::run(mesh, dst);
+    else if (match_layout<VERTEX, UV>(comps))
+        Interleaver<VERTEX, UV>::run(mesh, dst);
+    else if (match_layout<VERTEX, NORMAL, UV>(comps))
+        Interleaver<VERTEX, NORMAL, UV>::run(mesh, dst);
+    else if (match_layout<VERTEX, NORMAL, COLOR>(comps))
+        Interleaver<VERTEX, NORMAL, COLOR>::run(mesh, dst);
+    else if (match_layout<VERTEX, NORMAL, UV, COLOR>(comps))
+        Interleaver<VERTEX, NORMAL, UV, COLOR>::run(mesh, dst);
+    else
+        interleave_generic(mesh, comps, dst);
+}
+
+}
@@ -14,6 +14,8 @@ namespace vkkk
 struct PointLight {
     vec4   pos;
     vec4   color;
+    // x : range, the light has no effect past it
+    vec4   params;
 };
 
 struct DirectionalLight {
@@ -26,6 +28,35 @@ struct SpotLight {
     vec4   direction;
     vec3   color;
     float  angle;
+    // x : range
+    vec4   params;
+};
+
+struct ClusterInfo {
+    mat4   view;
+    // xyz : cluster counts, w : directional light count
+    uvec4  dims;
+    // near, far, slices / log(far / near), log(near)
+    vec4   depth;
+    // xy : tile size in pixels
+    vec4   tile_size;
+};
+
+// One shadow map in the atlas, point lights own six in face order
+// +x, -x, +y, -y, +z, -z
+struct ShadowTile {
+    mat4   view_proj;
+    // xy : uv offset, zw : uv scale
+    vec4   rect;
+};
+
+struct ShadowInfo {
+    mat4   cascades[MAX_CASCADES];
+    // View depth each cascade ends at
+    vec4   splits;
+    // x : cascade count, y : directional light casting them,
+    // z : where spot lights start in the tile lookup
+    uvec4  params;
 };
 
 #ifndef GL_core_profile 
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "utils/macros.h"
+
+#ifndef GL_core_profile
+#include <glm/glm.hpp>
+using namespace glm;
+
+namespace vkkk
+{
+#endif
+
+#define MATERIAL_ALBEDO 0
+#define MATERIAL_NORMAL 1
+#define MATERIAL_METAL_ROUGH 2
+#define MATERIAL_EMISSIVE 3
+
+// Textures are slots in the bindless heap, BINDLESS_NONE when unset
+struct Material {
+    vec4   base_color;
+    uvec4  textures;
+    // x : metallic, y : roughness, z : emissive strength
+    vec4   params;
+};
+
+#ifndef GL_core_profile
+inline Material default_material() {
+    return Material{
+        .base_color = vec4(1.f),
+        .textures = uvec4(BINDLESS_NONE),
+        .params = vec4(0.f, 1.f, 0.f, 0.f)
+    };
+}
+
+}
+#endif
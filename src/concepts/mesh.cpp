@@ -1,9 +1,12 @@
 
+#include <algorithm>
+#include <cmath>
 #include <memory>
 #include <stdexcept>
 
 #include <fmt/format.h>
 
+#include "concepts/interleave.h"
 #include "concepts/mesh.h"
 //#include "vk_ins/cmd_buf.h"
 //#include "vk_ins/pipeline_mgr.h"
@@ -229,7 +232,10 @@ Mesh::Mesh(const Mesh& m)
     , comp_size(m.comp_size)
     , vcnt(m.vcnt)
     , icnt(m.icnt)
+    , index_type(m.index_type)
+    , bounds(m.bounds)
     , loaded(m.loaded)
+    , meshlets(m.meshlets)
 {
     if (loaded) {
         vbuf = new float[vcnt * comp_size];
@@ -245,7 +251,10 @@ Mesh::Mesh(Mesh&& m)
     , comp_size(m.comp_size)
     , vcnt(m.vcnt)
     , icnt(m.icnt)
+    , index_type(m.index_type)
+    , bounds(m.bounds)
     , loaded(m.loaded)
+    , meshlets(std::move(m.meshlets))
 {
     if (loaded) {
         vbuf = m.vbuf;
@@ -270,50 +279,14 @@ void Mesh::load(aiMesh* mesh) {
     vbuf = new float[vcnt * comp_size];
     ibuf = new uint32_t[icnt * 3];
 
-    uint32_t prev = 0;
-    for (const auto& comp : comps) {
-        switch (comp) {
-            case VERTEX: {
-                for (int i = 0; i < vcnt; ++i) {
-                    vbuf[i * comp_size + prev    ] = mesh->mVertices[i].x;
-                    vbuf[i * comp_size + prev + 1] = mesh->mVertices[i].y;
-                    vbuf[i * comp_size + prev + 2] = mesh->mVertices[i].z;
-                }
-                prev += 3;
-                break;
-            }
-
-            case NORMAL: {
-                for (int i = 0; i < vcnt; ++i) {
-                    vbuf[i * comp_size + prev    ] = mesh->mNormals[i].x;
-                    vbuf[i * comp_size + prev + 1] = mesh->mNormals[i].y;
-                    vbuf[i * comp_size + prev + 2] = mesh->mNormals[i].z;
-                }
-                prev += 3;
-                break;
-            }
-
-            case UV: {
-                for (int i = 0; i < vcnt; ++i) {
-                    const auto uv = mesh->mTextureCoords[0][i];
-                    vbuf[i * comp_size + prev    ] = uv.x;
-                    vbuf[i * comp_size + prev + 1] = uv.y;
-                }
-                prev += 2;
-                break;
-            }
-
-            case COLOR: {
-                for (int i = 0; i < vcnt; ++i) {
-                    const auto vcolor = mesh->mColors[0][i];
-                    vbuf[i * comp_size + prev    ] = vcolor.r;
-                    vbuf[i * comp_size + prev + 1] = vcolor.g;
-                    vbuf[i * comp_size + prev + 2] = vcolor.b;
-                }
-                prev += 3;
-                break;
-            }
-        }
+    try {
+        interleave_attributes(mesh, comps, vbuf);
+    }
+    catch (...) {
+        delete[] vbuf;
+        delete[] ibuf;
+        vcnt = icnt = 0;
+        throw;
     }
 
     for (int i = 0; i < icnt; ++i) {
@@ -322,7 +295,9 @@ void Mesh::load(aiMesh* mesh) {
         ibuf[i * 3 + 2] = mesh->mFaces[i].mIndices[2];
     }
 
+    update_index_type();
     loaded = true;
+    update_bounds();
 }
 
 void Mesh::load(const uint32_t v, const char* vdata, const uint32_t vsize,
@@ -348,14 +323,256 @@ void Mesh::load(const uint32_t v, const char* vdata, const uint32_t vsize,
     ibuf = new uint32_t[icnt * 3];
     memcpy(ibuf, idata, ibuf_size);
 
+    update_index_type();
     loaded = true;
+    update_bounds();
 }
 
 void Mesh::unload() {
     vcnt = icnt = 0;
     delete[] vbuf;
     delete[] ibuf;
+    meshlets.clear();
+    bounds = glm::vec4(0.f);
     loaded = false;
 }
 
+static int32_t find_comp_offset(const std::vector<VERT_COMP>& comps, const VERT_COMP target) {
+    int32_t offset = 0;
+    for (const auto& comp : comps) {
+        if (comp == target)
+            return offset;
+        offset += comp_sizes[comp];
+    }
+    return -1;
+}
+
+void Mesh::update_bounds() {
+    bounds = glm::vec4(0.f);
+    const auto pos_offset = find_comp_offset(comps, VERTEX);
+    if (!loaded || vcnt == 0 || pos_offset < 0)
+        return;
+
+    auto pos = [&](const uint32_t i) {
+        const float* p = vbuf + i * comp_size + pos_offset;
+        return glm::vec3(p[0], p[1], p[2]);
+    };
+
+    // Box center is good enough, it's only used for culling
+    glm::vec3 lo = pos(0), hi = pos(0);
+    for (uint32_t i = 1; i < vcnt; ++i) {
+        lo = glm::min(lo, pos(i));
+        hi = glm::max(hi, pos(i));
+    }
+
+    glm::vec3 center = (lo + hi) * 0.5f;
+    float r2 = 0.f;
+    for (uint32_t i = 0; i < vcnt; ++i) {
+        glm::vec3 d = pos(i) - center;
+        r2 = std::max(r2, glm::dot(d, d));
+    }
+    bounds = glm::vec4(center, std::sqrt(r2));
+}
+
+void Mesh::build_meshlets(const uint32_t max_verts, const uint32_t max_tris) {
+    if (!loaded || !indexed)
+        throw std::runtime_error("cannot build meshlets for unloaded or non-indexed mesh");
+    if (max_verts < 3 || max_tris < 1)
+        throw std::invalid_argument(fmt::format("invalid meshlet limits : {} vertices, {} triangles",
+            max_verts, max_tris));
+
+    const auto pos_offset = find_comp_offset(comps, VERTEX);
+    if (pos_offset < 0)
+        throw std::runtime_error("cannot build meshlets for mesh without position component");
+
+    auto position = [&](const uint32_t v) {
+        const float* p = vbuf + v * comp_size + pos_offset;
+        return glm::vec3(p[0], p[1], p[2]);
+    };
+
+    meshlets.clear();
+    std::vector<uint32_t> reordered;
+    reordered.reserve(icnt * 3);
+    // Stamp with the meshlet index instead of clearing a visited set for
+    // every meshlet
+    std::vector<uint32_t> stamps(vcnt, UINT32_MAX);
+    std::vector<uint32_t> cur_verts;
+    cur_verts.reserve(max_verts);
+    uint32_t cur_tri_start = 0;
+
+    auto flush = [&]() {
+        const uint32_t tri_cnt = reordered.size() / 3 - cur_tri_start;
+        if (tri_cnt == 0)
+            return;
+
+        Meshlet m{};
+        m.triangle_offset = cur_tri_start;
+        m.triangle_count = tri_cnt;
+        m.vertex_count = cur_verts.size();
+
+        // Bounding sphere centered at the aabb center, not minimal but
+        // stable and cheap
+        glm::vec3 lo = position(cur_verts[0]);
+        glm::vec3 hi = lo;
+        for (auto v : cur_verts) {
+            lo = glm::min(lo, position(v));
+            hi = glm::max(hi, position(v));
+        }
+        glm::vec3 center = (lo + hi) * 0.5f;
+        float radius = 0.f;
+        for (auto v : cur_verts)
+            radius = std::max(radius, glm::length(position(v) - center));
+        m.sphere = glm::vec4(center, radius);
+
+        // Normal cone, cutoff is sin of the cone half angle so the backface
+        // test becomes dot(c - eye, axis) >= cutoff * |c - eye| + radius
+        std::vector<glm::vec3> normals;
+        normals.reserve(tri_cnt);
+        glm::vec3 axis(0.f);
+        for (uint32_t t = cur_tri_start; t < cur_tri_start + tri_cnt; ++t) {
+            auto a = position(reordered[t * 3]);
+            auto b = position(reordered[t * 3 + 1]);
+            auto c = position(reordered[t * 3 + 2]);
+            auto n = glm::cross(b - a, c - a);
+            auto len = glm::length(n);
+            if (len <= 1e-12f)
+                continue;
+            n /= len;
+            normals.push_back(n);
+            axis += n;
+        }
+
+        float axis_len = glm::length(axis);
+        float mindp = 1.f;
+        if (axis_len > 1e-6f) {
+            axis /= axis_len;
+            for (const auto& n : normals)
+                mindp = std::min(mindp, glm::dot(n, axis));
+        }
+        if (normals.empty() || axis_len <= 1e-6f || mindp <= 0.f)
+            m.cone = glm::vec4(0.f, 0.f, 1.f, 1.f);
+        else
+            m.cone = glm::vec4(axis, std::sqrt(1.f - mindp * mindp));
+
+        meshlets.emplace_back(std::move(m));
+        cur_verts.clear();
+        cur_tri_start = reordered.size() / 3;
+    };
+
+    // Greedy in index order, assimp output usually has decent locality
+    // so we don't bother with a spatial sort here
+    for (uint32_t t = 0; t < icnt; ++t) {
+        const uint32_t* tri = ibuf + t * 3;
+        const uint32_t meshlet_idx = meshlets.size();
+
+        uint32_t new_verts = 0;
+        for (int k = 0; k < 3; ++k) {
+            bool dup = (k > 0 && tri[k] == tri[0]) || (k > 1 && tri[k] == tri[1]);
+            if (!dup && stamps[tri[k]] != meshlet_idx)
+                ++new_verts;
+        }
+
+        const uint32_t cur_tri_cnt = reordered.size() / 3 - cur_tri_start;
+        if (cur_verts.size() + new_verts > max_verts || cur_tri_cnt + 1 > max_tris)
+            flush();
+
+        const uint32_t dst_idx = meshlets.size();
+        for (int k = 0; k < 3; ++k) {
+            if (stamps[tri[k]] != dst_idx) {
+                stamps[tri[k]] = dst_idx;
+                cur_verts.push_back(tri[k]);
+            }
+            reordered.push_back(tri[k]);
+        }
+    }
+    flush();
+
+    memcpy(ibuf, reordered.data(), reordered.size() * sizeof(uint32_t));
+}
+
+static constexpr uint32_t MESH_MAGIC = 0x534d4b56; // "VKMS"
+static constexpr uint32_t MESH_VERSION = 1;
+
+template <typename T>
+static void write_pod(std::ostream& os, const T* data, const size_t cnt=1) {
+    os.write(reinterpret_cast<const char*>(data), sizeof(T) * cnt);
+}
+
+template <typename T>
+static void read_pod(std::istream& is, T* data, const size_t cnt=1) {
+    is.read(reinterpret_cast<char*>(data), sizeof(T) * cnt);
+    if (!is)
+        throw std::runtime_error("unexpected end of serialized mesh");
+}
+
+void Mesh::serialize(std::ostream& os) const {
+    if (!loaded)
+        throw std::runtime_error("cannot serialize unloaded mesh");
+
+    const uint32_t comp_cnt = comps.size();
+    const uint32_t meshlet_cnt = meshlets.size();
+    const uint32_t idx = indexed ? 1 : 0;
+    write_pod(os, &MESH_MAGIC);
+    write_pod(os, &MESH_VERSION);
+    write_pod(os, &comp_cnt);
+    for (const auto& comp : comps) {
+        const uint32_t c = comp;
+        write_pod(os, &c);
+    }
+    write_pod(os, &idx);
+    write_pod(os, &vcnt);
+    write_pod(os, &icnt);
+    write_pod(os, &meshlet_cnt);
+    write_pod(os, vbuf, vcnt * comp_size);
+    write_pod(os, ibuf, icnt * 3);
+    write_pod(os, meshlets.data(), meshlet_cnt);
+}
+
+void Mesh::deserialize(std::istream& is) {
+    uint32_t magic, version, comp_cnt;
+    read_pod(is, &magic);
+    read_pod(is, &version);
+    if (magic != MESH_MAGIC || version != MESH_VERSION)
+        throw std::runtime_error(fmt::format("unsupported serialized mesh, magic : {:#x}, version : {}",
+            magic, version));
+
+    read_pod(is, &comp_cnt);
+    std::vector<VERT_COMP> cs(comp_cnt);
+    for (auto& comp : cs) {
+        uint32_t c;
+        read_pod(is, &c);
+        if (c >= comp_sizes.size())
+            throw std::runtime_error(fmt::format("unknown vertex component {}", c));
+        comp = static_cast<VERT_COMP>(c);
+    }
+
+    uint32_t idx, v, i, meshlet_cnt;
+    read_pod(is, &idx);
+    read_pod(is, &v);
+    read_pod(is, &i);
+    read_pod(is, &meshlet_cnt);
+
+    if (loaded)
+        unload();
+
+    comps = std::move(cs);
+    indexed = idx != 0;
+    comp_size = 0;
+    for (const auto& comp : comps)
+        comp_size += comp_sizes[comp];
+
+    vcnt = v;
+    icnt = i;
+    update_index_type();
+    vbuf = new float[vcnt * comp_size];
+    ibuf = new uint32_t[icnt * 3];
+    // Mark loaded first so a truncated stream doesn't leak the buffers
+    loaded = true;
+    read_pod(is, vbuf, vcnt * comp_size);
+    read_pod(is, ibuf, icnt * 3);
+    meshlets.resize(meshlet_cnt);
+    read_pod(is, meshlets.data(), meshlet_cnt);
+    update_bounds();
+}
+
 }
\ No newline at end of file
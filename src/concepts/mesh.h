@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <concepts>
 #include <functional>
+#include <iostream>
 #include <memory>
 #include <type_traits>
 #include <tuple>
@@ -27,6 +28,23 @@ namespace vkkk
 
 class VkWrappedInstance;
 
+inline constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+inline constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+// A cluster of triangles which occupies a contiguous range of the mesh
+// index buffer, layout kept 16 bytes aligned so the array can be mirrored
+// into a storage buffer directly
+struct Meshlet {
+    // xyz center, w radius
+    glm::vec4                   sphere;
+    // xyz axis, w cutoff, cutoff 1 means the cone is degenerate
+    glm::vec4                   cone;
+    uint32_t                    triangle_offset;
+    uint32_t                    triangle_count;
+    uint32_t                    vertex_count;
+    uint32_t                    padding = 0;
+};
+
 class MeshDeprecated {
 public:
     MeshDeprecated(VkWrappedInstance*, const std::vector<VERT_COMP>&, bool indexed=true);
@@ -75,6 +93,27 @@ public:
         const uint32_t);
     void unload();
 
+    // Reorders the index buffer so triangles are grouped into meshlets
+    void build_meshlets(const uint32_t max_verts=MESHLET_MAX_VERTICES,
+        const uint32_t max_tris=MESHLET_MAX_TRIANGLES);
+
+    void serialize(std::ostream&) const;
+    void deserialize(std::istream&);
+
+    // Index type used on the gpu, the cpu side ibuf always stays 32 bit
+    // since meshlet building and serialization index into it directly
+    inline void update_index_type() {
+        // 0xFFFF is kept free for primitive restart
+        index_type = vcnt <= UINT16_MAX ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    }
+
+    inline uint32_t index_size() const {
+        return index_type == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+    }
+
+    // Bounding sphere of the positions, zero when there are none
+    void update_bounds();
+
     std::vector<VERT_COMP>      comps;
     bool                        indexed = true;
     uint32_t                    comp_size = 0;
@@ -82,7 +121,11 @@ public:
     float*                      vbuf = nullptr;
     uint32_t                    icnt = 0;
     uint32_t*                   ibuf = nullptr;
+    VkIndexType                 index_type = VK_INDEX_TYPE_UINT32;
+    // xyz center, w radius, in mesh space
+    glm::vec4                   bounds{0.f};
     bool                        loaded = false;
+    std::vector<Meshlet>        meshlets;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,237 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "concepts/camera.h"
+
+namespace vkkk
+{
+
+struct ShadowCascade {
+    glm::mat4                   view_proj;
+    // World space bounding sphere of the frustum slice
+    glm::vec4                   sphere;
+    // View depth the cascade ends at
+    float                       split;
+};
+
+// Practical split scheme, lambda blends logarithmic (1) and uniform (0)
+// splits. Returns cnt + 1 depths from near to far
+inline std::vector<float> cascade_splits(const float near, const float far,
+    const uint32_t cnt, const float lambda)
+{
+    std::vector<float> splits(cnt + 1);
+    for (uint32_t i = 0; i <= cnt; ++i) {
+        float t = static_cast<float>(i) / cnt;
+        float log_split = near * std::pow(far / near, t);
+        float uni_split = near + (far - near) * t;
+        splits[i] = lambda * log_split + (1.f - lambda) * uni_split;
+    }
+    splits.front() = near;
+    splits.back() = far;
+    return splits;
+}
+
+// Any up vector not parallel to dir
+inline glm::vec3 stable_up(const glm::vec3& dir) {
+    return std::abs(dir.y) > 0.99f ? glm::vec3(0.f, 0.f, 1.f) : glm::vec3(0.f, 1.f, 0.f);
+}
+
+/************************************************************
+ * Fits an orthographic cascade around the [near, far] slice
+ * of the camera frustum. A bounding sphere is used instead of
+ * a tight box so the projection size doesn't change as the
+ * camera rotates, and the projection is snapped to whole
+ * texels so moving the camera doesn't make edges shimmer.
+ * caster_extent pulls the near plane back towards the light
+ * so casters outside the slice still land in the map.
+ ************************************************************/
+
+inline ShadowCascade fit_cascade(const Camera& cam, const float near, const float far,
+    const glm::vec3& light_dir, const uint32_t resolution, const float caster_extent)
+{
+    auto inv = glm::inverse(
+        glm::perspective(glm::radians(cam.fov), cam.ratio, near, far) * cam.get_view_mat());
+
+    std::array<glm::vec3, 8> corners;
+    glm::vec3 center(0.f);
+    for (uint32_t i = 0; i < 8; ++i) {
+        glm::vec4 ndc(i & 1 ? 1.f : -1.f, i & 2 ? 1.f : -1.f, i & 4 ? 1.f : 0.f, 1.f);
+        glm::vec4 p = inv * ndc;
+        corners[i] = glm::vec3(p) / p.w;
+        center += corners[i];
+    }
+    center /= 8.f;
+
+    float radius = 0.f;
+    for (auto& c : corners)
+        radius = std::max(radius, glm::length(c - center));
+    // Quantize so float noise doesn't change the texel size every frame
+    radius = std::ceil(radius * 16.f) / 16.f;
+
+    auto dir = glm::normalize(light_dir);
+    auto view = glm::lookAt(center - dir * (radius + caster_extent), center, stable_up(dir));
+    auto proj = glm::ortho(-radius, radius, -radius, radius, 0.f,
+        2.f * radius + caster_extent);
+
+    // Snap the world origin to a texel and move the whole projection by
+    // the same sub texel amount
+    auto vp = proj * view;
+    glm::vec4 origin = vp * glm::vec4(0.f, 0.f, 0.f, 1.f);
+    float half_res = resolution * 0.5f;
+    glm::vec2 texel(origin.x * half_res, origin.y * half_res);
+    glm::vec2 offset = (glm::floor(texel + 0.5f) - texel) / half_res;
+    proj[3][0] += offset.x;
+    proj[3][1] += offset.y;
+
+    return ShadowCascade{proj * view, glm::vec4(center, radius), far};
+}
+
+inline std::vector<ShadowCascade> fit_cascades(const Camera& cam, const glm::vec3& light_dir,
+    const uint32_t cnt, const float lambda, const uint32_t resolution,
+    const float caster_extent)
+{
+    auto splits = cascade_splits(cam.near, cam.far, cnt, lambda);
+    std::vector<ShadowCascade> cascades;
+    cascades.reserve(cnt);
+    for (uint32_t i = 0; i < cnt; ++i)
+        cascades.push_back(fit_cascade(cam, splits[i], splits[i + 1], light_dir,
+            resolution, caster_extent));
+    return cascades;
+}
+
+inline glm::mat4 spot_shadow_matrix(const glm::vec3& pos, const glm::vec3& dir,
+    const float angle, const float range)
+{
+    auto d = glm::normalize(dir);
+    // A little wider than the cone so filtering at the edge stays inside
+    float fov = std::min(2.f * glm::radians(angle) * 1.1f, glm::radians(170.f));
+    auto proj = glm::perspective(fov, 1.f, std::max(range * 0.01f, 0.01f), range);
+    return proj * glm::lookAt(pos, pos + d, stable_up(d));
+}
+
+// Faces in +x, -x, +y, -y, +z, -z order
+inline std::array<glm::mat4, 6> point_shadow_matrices(const glm::vec3& pos, const float range) {
+    static const glm::vec3 dirs[] = {
+        {1.f, 0.f, 0.f}, {-1.f, 0.f, 0.f}, {0.f, 1.f, 0.f},
+        {0.f, -1.f, 0.f}, {0.f, 0.f, 1.f}, {0.f, 0.f, -1.f}};
+    auto proj = glm::perspective(glm::radians(90.f), 1.f, std::max(range * 0.01f, 0.01f), range);
+    std::array<glm::mat4, 6> mats;
+    for (int i = 0; i < 6; ++i)
+        mats[i] = proj * glm::lookAt(pos, pos + dirs[i], stable_up(dirs[i]));
+    return mats;
+}
+
+// Picks a power of two resolution from the height in pixels the light's
+// sphere of influence covers on screen
+inline uint32_t shadow_resolution(const Camera& cam, const glm::vec3& center,
+    const float radius, const uint32_t screen_height, const uint32_t min_res,
+    const uint32_t max_res)
+{
+    float depth = -(cam.get_view_mat() * glm::vec4(center, 1.f)).z;
+    if (depth <= radius)
+        return max_res;
+
+    float proj_y = 1.f / std::tan(glm::radians(cam.fov) * 0.5f);
+    float pixels = radius * proj_y / depth * screen_height;
+    uint32_t res = min_res;
+    while (res < pixels && res < max_res)
+        res *= 2;
+    return res;
+}
+
+/************************************************************
+ * Square atlas handing out power of two tiles, a buddy
+ * allocator where every free block is kept in the list of
+ * its size. Allocation order doesn't matter for packing as
+ * long as larger tiles go first, which the shadow manager
+ * ensures by sorting. There's no free, the atlas is rebuilt
+ * from scratch whenever the shadowed light set changes.
+ ************************************************************/
+
+class ShadowAtlas {
+public:
+    ShadowAtlas(const uint32_t size=4096, const uint32_t min_tile=64)
+        : size(size)
+        , min_tile(min_tile)
+    {
+        reset();
+    }
+
+    inline void reset() {
+        levels.clear();
+        for (uint32_t s = size; s >= min_tile; s /= 2)
+            levels.emplace_back();
+        levels[0].push_back(glm::uvec2(0));
+        used = 0;
+    }
+
+    // Offset of a tile of size tile_size, nothing when the atlas is full
+    inline std::optional<glm::uvec2> alloc(uint32_t tile_size) {
+        tile_size = std::clamp(tile_size, min_tile, size);
+        uint32_t level = level_of(tile_size);
+
+        // Closest level above with a free block
+        int32_t src = level;
+        while (src >= 0 && levels[src].empty())
+            --src;
+        if (src < 0)
+            return std::nullopt;
+
+        // Split down, keeping the first quadrant and freeing the other three
+        for (uint32_t l = src; l < level; ++l) {
+            auto block = levels[l].back();
+            levels[l].pop_back();
+            uint32_t half = size >> (l + 1);
+            levels[l + 1].push_back(block + glm::uvec2(half, half));
+            levels[l + 1].push_back(block + glm::uvec2(0, half));
+            levels[l + 1].push_back(block + glm::uvec2(half, 0));
+            levels[l + 1].push_back(block);
+        }
+
+        auto tile = levels[level].back();
+        levels[level].pop_back();
+        uint64_t block = size >> level;
+        used += block * block;
+        return tile;
+    }
+
+    inline uint32_t get_size() const {
+        return size;
+    }
+
+    inline uint32_t get_min_tile() const {
+        return min_tile;
+    }
+
+    // Fraction of texels handed out
+    inline float occupancy() const {
+        return static_cast<float>(used) / (static_cast<float>(size) * size);
+    }
+
+private:
+    inline uint32_t level_of(const uint32_t tile_size) const {
+        uint32_t level = 0;
+        // Smallest block that still holds the tile
+        for (uint32_t s = size / 2; s >= tile_size && s >= min_tile; s /= 2)
+            ++level;
+        return level;
+    }
+
+    uint32_t                                size;
+    uint32_t                                min_tile;
+    std::vector<std::vector<glm::uvec2>>    levels;
+    uint64_t                                used = 0;
+};
+
+}
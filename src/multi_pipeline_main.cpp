@@ -173,9 +173,9 @@ int main() {
         auto light_info_ptr = pipeline_for.uniforms->find_ubo("infos");
         if (!light_info_ptr)
             return;
-        auto light_infos_buf = reinterpret_cast<void*>(light_info_ptr->cpu_buf.get());
-        light_mgr.update_uniform(light_infos_buf);
-        pipeline_for.uniforms->update_ubos(idx);
+        // Lights only upload what changed since this image last saw them
+        xforms_ptr->update(idx);
+        light_mgr.update_uniform(*light_info_ptr, idx);
 
         auto mat_ubo_ptr = pipeline_mat.uniforms->find_ubo("ubo");
         if (!mat_ubo_ptr)
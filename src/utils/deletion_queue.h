@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <utility>
+
+namespace vkkk
+{
+
+// Destruction postponed until the GPU is done with the frame that last
+// used a resource. Frames are pushed in increasing order, so flushing only
+// ever looks at the front
+class DeletionQueue {
+public:
+    inline void push(const uint64_t frame, std::function<void()>&& deleter) {
+        deleters.emplace_back(frame, std::move(deleter));
+    }
+
+    // Runs every deleter of frames up to and including completed
+    inline uint32_t flush(const uint64_t completed) {
+        uint32_t cnt = 0;
+        while (!deleters.empty() && deleters.front().first <= completed) {
+            auto deleter = std::move(deleters.front().second);
+            deleters.pop_front();
+            deleter();
+            ++cnt;
+        }
+        return cnt;
+    }
+
+    // Only once the device is idle
+    inline uint32_t flush_all() {
+        return flush(UINT64_MAX);
+    }
+
+    inline size_t size() const {
+        return deleters.size();
+    }
+
+private:
+    std::deque<std::pair<uint64_t, std::function<void()>>>
+                                            deleters;
+};
+
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <algorithm>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace vkkk
+{
+
+/************************************************************
+ * Reports files that got written since the last poll, poll
+ * never blocks. On Linux the parent directories are watched
+ * with inotify since editors often save by writing a new
+ * file and renaming it over the old one, which a watch on
+ * the file itself wouldn't survive. Elsewhere it falls back
+ * to comparing modification times on every poll.
+ ************************************************************/
+
+class FileWatcher {
+public:
+    FileWatcher() = default;
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    ~FileWatcher() {
+#ifdef __linux__
+        if (fd >= 0)
+            close(fd);
+#endif
+    }
+
+    // False when the file doesn't exist or can't be watched
+    inline bool watch(const fs::path& path) {
+        std::error_code ec;
+        auto abs_path = fs::weakly_canonical(fs::absolute(path), ec);
+        if (ec || !fs::exists(abs_path))
+            return false;
+        if (files.contains(abs_path))
+            return true;
+
+#ifdef __linux__
+        if (fd < 0)
+            fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd < 0)
+            return false;
+
+        auto dir = abs_path.parent_path();
+        auto found = std::find_if(dirs.begin(), dirs.end(), [&](auto& d) {
+            return d.second == dir;
+        });
+        if (found == dirs.end()) {
+            // No IN_CREATE, a recreated file still gets IN_CLOSE_WRITE once
+            // written, reporting it on creation would reload it half empty
+            int wd = inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+            if (wd < 0)
+                return false;
+            dirs.emplace(wd, dir);
+        }
+#endif
+        files.emplace(abs_path, fs::last_write_time(abs_path, ec));
+        return true;
+    }
+
+    inline bool watching(const fs::path& path) const {
+        std::error_code ec;
+        return files.contains(fs::weakly_canonical(fs::absolute(path), ec));
+    }
+
+    inline size_t size() const {
+        return files.size();
+    }
+
+    // Watched files changed since the last call, each reported once
+    inline std::vector<fs::path> poll() {
+        std::set<fs::path> changed;
+
+#ifdef __linux__
+        if (fd >= 0) {
+            alignas(inotify_event) char buf[4096];
+            ssize_t len;
+            while ((len = read(fd, buf, sizeof(buf))) > 0) {
+                for (char* p = buf; p < buf + len; ) {
+                    auto event = reinterpret_cast<inotify_event*>(p);
+                    p += sizeof(inotify_event) + event->len;
+
+                    auto dir = dirs.find(event->wd);
+                    if (dir == dirs.end() || event->len == 0)
+                        continue;
+                    auto file = dir->second / event->name;
+                    if (files.contains(file))
+                        changed.insert(file);
+                }
+            }
+        }
+#else
+        for (auto& [file, stamp] : files) {
+            std::error_code ec;
+            auto now = fs::last_write_time(file, ec);
+            if (!ec && now != stamp) {
+                stamp = now;
+                changed.insert(file);
+            }
+        }
+#endif
+
+        return std::vector<fs::path>(changed.begin(), changed.end());
+    }
+
+private:
+    std::map<fs::path, fs::file_time_type>
+                                        files;
+#ifdef __linux__
+    int                                 fd = -1;
+    std::unordered_map<int, fs::path>   dirs;
+#endif
+};
+
+}
@@ -7,4 +7,40 @@
 
 #define MAX_POINT_LIGHTS 10
 #define MAX_DIRECTIONAL_LIGHTS 4
-#define MAX_SPOT_LIGHTS 10
\ No newline at end of file
+#define MAX_SPOT_LIGHTS 10
+
+// Clustered lighting, froxel grid dimensions and the bindings used by the
+// clustered shaders
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+#define LIGHT_SPOT_FLAG 0x80000000u
+
+#define CLUSTER_INFO_BINDING 1
+#define POINT_LIGHT_BINDING 2
+#define SPOT_LIGHT_BINDING 3
+#define DIR_LIGHT_BINDING 4
+#define CLUSTER_RANGE_BINDING 5
+#define CLUSTER_INDEX_BINDING 6
+
+// Shadows
+#define MAX_CASCADES 4
+#define SHADOW_INFO_BINDING 7
+#define SHADOW_TILE_BINDING 8
+#define SHADOW_LOOKUP_BINDING 9
+#define CASCADE_MAP_BINDING 10
+#define SHADOW_ATLAS_BINDING 11
+
+// Bindless, the heap lives in its own set so per pipeline resources keep
+// set 0. Fallback sizes are used when descriptor indexing is missing and
+// shaders are compiled with BINDLESS_FALLBACK defined
+#define BINDLESS_SET 1
+#define BINDLESS_IMAGE_BINDING 0
+#define BINDLESS_BUFFER_BINDING 1
+#define BINDLESS_NONE 0xFFFFFFFFu
+#define BINDLESS_FALLBACK_IMAGES 16
+#define BINDLESS_FALLBACK_BUFFERS 8
+
+#define TRANSFORM_BINDING 12
+#define MATERIAL_BINDING 13
+#define NODE_MATERIAL_BINDING 14
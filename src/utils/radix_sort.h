@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vkkk
+{
+
+// LSD radix sort of 64 bit keys carrying a 32 bit payload, 8 bits per
+// pass. Passes where every key has the same digit are skipped, which is
+// the common case for the high bits of sort keys. Stable
+inline void radix_sort(std::vector<uint64_t>& keys, std::vector<uint32_t>& vals) {
+    const size_t n = keys.size();
+    if (n < 2)
+        return;
+
+    std::vector<uint64_t> tmp_keys(n);
+    std::vector<uint32_t> tmp_vals(n);
+
+    // Build all histograms in one read over the keys
+    std::array<std::array<uint32_t, 256>, 8> hists{};
+    for (auto key : keys)
+        for (int pass = 0; pass < 8; ++pass)
+            ++hists[pass][(key >> (pass * 8)) & 0xFF];
+
+    for (int pass = 0; pass < 8; ++pass) {
+        auto& hist = hists[pass];
+        const uint32_t shift = pass * 8;
+        if (hist[(keys[0] >> shift) & 0xFF] == n)
+            continue;
+
+        uint32_t sum = 0;
+        for (auto& cnt : hist) {
+            uint32_t c = cnt;
+            cnt = sum;
+            sum += c;
+        }
+
+        for (size_t i = 0; i < n; ++i) {
+            auto dst = hist[(keys[i] >> shift) & 0xFF]++;
+            tmp_keys[dst] = keys[i];
+            tmp_vals[dst] = vals[i];
+        }
+        keys.swap(tmp_keys);
+        vals.swap(tmp_vals);
+    }
+}
+
+}
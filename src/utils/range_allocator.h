@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <optional>
+
+namespace vkkk
+{
+
+// First fit free list over [0, capacity), units are up to the caller.
+// Freed ranges get coalesced with their neighbours so the list stays short
+class RangeAllocator {
+public:
+    RangeAllocator() {}
+    RangeAllocator(const uint64_t cap) {
+        reset(cap);
+    }
+
+    inline void reset(const uint64_t cap) {
+        capacity = cap;
+        used = 0;
+        free_ranges.clear();
+        if (cap > 0)
+            free_ranges.emplace(0, cap);
+    }
+
+    std::optional<uint64_t> alloc(const uint64_t size) {
+        if (size == 0)
+            return std::nullopt;
+
+        for (auto it = free_ranges.begin(); it != free_ranges.end(); ++it) {
+            if (it->second < size)
+                continue;
+
+            uint64_t offset = it->first;
+            uint64_t remain = it->second - size;
+            free_ranges.erase(it);
+            if (remain > 0)
+                free_ranges.emplace(offset + size, remain);
+            used += size;
+            return offset;
+        }
+
+        return std::nullopt;
+    }
+
+    void free(const uint64_t offset, const uint64_t size) {
+        if (size == 0)
+            return;
+
+        auto next = free_ranges.lower_bound(offset);
+        uint64_t start = offset;
+        uint64_t len = size;
+
+        if (next != free_ranges.begin()) {
+            auto prev = std::prev(next);
+            if (prev->first + prev->second == start) {
+                start = prev->first;
+                len += prev->second;
+                free_ranges.erase(prev);
+            }
+        }
+
+        if (next != free_ranges.end() && offset + size == next->first) {
+            len += next->second;
+            free_ranges.erase(next);
+        }
+
+        free_ranges.emplace(start, len);
+        used -= size;
+    }
+
+    inline uint64_t get_capacity() const {
+        return capacity;
+    }
+
+    inline uint64_t get_used() const {
+        return used;
+    }
+
+    inline size_t get_fragment_cnt() const {
+        return free_ranges.size();
+    }
+
+private:
+    uint64_t                        capacity = 0;
+    uint64_t                        used = 0;
+    // offset -> size
+    std::map<uint64_t, uint64_t>    free_ranges;
+};
+
+}
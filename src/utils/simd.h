@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#define VKKK_SSE2 1
+#endif
+
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+#define VKKK_SSE41 1
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define VKKK_NEON 1
+#endif
+
+namespace vkkk
+{
+
+namespace simd
+{
+
+// Narrow 32 bit indices to 16 bit, caller guarantees every value fits.
+// dst may not alias src
+inline void narrow_u32_to_u16(const uint32_t* src, uint16_t* dst, const size_t n) {
+    size_t i = 0;
+
+#if defined(VKKK_SSE41)
+    for (; i + 8 <= n; i += 8) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi32(a, b));
+    }
+#elif defined(VKKK_SSE2)
+    // No unsigned saturating pack before sse4.1, bias into signed range,
+    // pack with signed saturation then bias back
+    const __m128i bias32 = _mm_set1_epi32(0x8000);
+    const __m128i bias16 = _mm_set1_epi16(static_cast<short>(0x8000));
+    for (; i + 8 <= n; i += 8) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 4));
+        a = _mm_sub_epi32(a, bias32);
+        b = _mm_sub_epi32(b, bias32);
+        __m128i packed = _mm_add_epi16(_mm_packs_epi32(a, b), bias16);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), packed);
+    }
+#elif defined(VKKK_NEON)
+    for (; i + 8 <= n; i += 8) {
+        uint16x4_t lo = vmovn_u32(vld1q_u32(src + i));
+        uint16x4_t hi = vmovn_u32(vld1q_u32(src + i + 4));
+        vst1q_u16(dst + i, vcombine_u16(lo, hi));
+    }
+#endif
+
+    for (; i < n; ++i)
+        dst[i] = static_cast<uint16_t>(src[i]);
+}
+
+// out = a * b for column major 4x4 matrices (glm layout), out may alias
+// neither input
+inline void mat4_mul(const float* a, const float* b, float* out) {
+#if defined(VKKK_SSE2)
+    const __m128 c0 = _mm_loadu_ps(a);
+    const __m128 c1 = _mm_loadu_ps(a + 4);
+    const __m128 c2 = _mm_loadu_ps(a + 8);
+    const __m128 c3 = _mm_loadu_ps(a + 12);
+    for (int j = 0; j < 4; ++j) {
+        const float* bc = b + j * 4;
+        __m128 r = _mm_mul_ps(c0, _mm_set1_ps(bc[0]));
+        r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(bc[1])));
+        r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(bc[2])));
+        r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_set1_ps(bc[3])));
+        _mm_storeu_ps(out + j * 4, r);
+    }
+#elif defined(VKKK_NEON)
+    const float32x4_t c0 = vld1q_f32(a);
+    const float32x4_t c1 = vld1q_f32(a + 4);
+    const float32x4_t c2 = vld1q_f32(a + 8);
+    const float32x4_t c3 = vld1q_f32(a + 12);
+    for (int j = 0; j < 4; ++j) {
+        const float* bc = b + j * 4;
+        float32x4_t r = vmulq_n_f32(c0, bc[0]);
+        r = vmlaq_n_f32(r, c1, bc[1]);
+        r = vmlaq_n_f32(r, c2, bc[2]);
+        r = vmlaq_n_f32(r, c3, bc[3]);
+        vst1q_f32(out + j * 4, r);
+    }
+#else
+    for (int j = 0; j < 4; ++j) {
+        for (int i = 0; i < 4; ++i) {
+            out[j * 4 + i] = a[i] * b[j * 4] + a[4 + i] * b[j * 4 + 1]
+                + a[8 + i] * b[j * 4 + 2] + a[12 + i] * b[j * 4 + 3];
+        }
+    }
+#endif
+}
+
+// Unaligned 4 float copy, used to move 2/3 wide attributes with a single
+// load/store when the caller knows the extra lane is safe to touch
+inline void copy4_f32(const float* src, float* dst) {
+#if defined(VKKK_SSE2)
+    _mm_storeu_ps(dst, _mm_loadu_ps(src));
+#elif defined(VKKK_NEON)
+    vst1q_f32(dst, vld1q_f32(src));
+#else
+    memcpy(dst, src, sizeof(float) * 4);
+#endif
+}
+
+}
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace vkkk
+{
+
+// Single slots out of [0, capacity), released slots are handed out again
+// before untouched ones so indices stay dense
+class SlotAllocator {
+public:
+    SlotAllocator() {}
+    SlotAllocator(const uint32_t cap) {
+        reset(cap);
+    }
+
+    inline void reset(const uint32_t cap) {
+        capacity = cap;
+        next = 0;
+        free_slots.clear();
+        taken.assign(cap, false);
+    }
+
+    std::optional<uint32_t> alloc() {
+        uint32_t slot;
+        if (!free_slots.empty()) {
+            slot = free_slots.back();
+            free_slots.pop_back();
+        }
+        else if (next < capacity)
+            slot = next++;
+        else
+            return std::nullopt;
+
+        taken[slot] = true;
+        return slot;
+    }
+
+    // False for slots that aren't currently handed out
+    bool release(const uint32_t slot) {
+        if (slot >= capacity || !taken[slot])
+            return false;
+        taken[slot] = false;
+        free_slots.push_back(slot);
+        return true;
+    }
+
+    inline bool is_taken(const uint32_t slot) const {
+        return slot < capacity && taken[slot];
+    }
+
+    inline uint32_t get_capacity() const {
+        return capacity;
+    }
+
+    inline uint32_t get_used() const {
+        return next - static_cast<uint32_t>(free_slots.size());
+    }
+
+private:
+    uint32_t                        capacity = 0;
+    // Slots below next have been handed out at least once
+    uint32_t                        next = 0;
+    std::vector<uint32_t>           free_slots;
+    std::vector<bool>               taken;
+};
+
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "utils/singleton.h"
+
+namespace vkkk
+{
+
+// Fixed size worker pool, the shared instance is sized to the hardware
+// concurrency and is what the asset loaders use
+class ThreadPool : public Singleton<ThreadPool> {
+public:
+    ThreadPool(const uint32_t n=std::max(1u, std::thread::hardware_concurrency())) {
+        for (uint32_t i = 0; i < n; ++i) {
+            workers.emplace_back([this]() {
+                current_pool() = this;
+                while (true) {
+                    std::function<void()> job;
+                    {
+                        std::unique_lock<std::mutex> lock(mtx);
+                        cv.wait(lock, [this]() { return stopping || !jobs.empty(); });
+                        if (stopping && jobs.empty())
+                            return;
+                        job = std::move(jobs.front());
+                        jobs.pop();
+                    }
+                    job();
+                }
+            });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator =(const ThreadPool&) = delete;
+
+    template <typename F>
+    auto enqueue(F&& f) -> std::future<std::invoke_result_t<F>> {
+        using R = std::invoke_result_t<F>;
+        // std::function needs a copyable callable, hence the shared_ptr
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+        auto fut = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            jobs.emplace([task]() { (*task)(); });
+        }
+        cv.notify_one();
+        return fut;
+    }
+
+    // Splits [0, n) into roughly equal chunks, one per worker, and blocks
+    // until all of them are done. Exceptions are rethrown on the caller.
+    // Called from a job of this pool the worker runs queued jobs while it
+    // waits, just blocking would hold it while the chunks queue up behind
+    // others doing the same, with few workers nothing gets to run
+    template <typename F>
+    void parallel_for(const size_t n, F&& f, const size_t min_chunk=1) {
+        if (n == 0)
+            return;
+
+        size_t chunk = std::max(min_chunk, (n + workers.size() - 1) / workers.size());
+        std::vector<std::future<void>> futs;
+        for (size_t begin = 0; begin < n; begin += chunk) {
+            size_t end = std::min(n, begin + chunk);
+            futs.emplace_back(enqueue([&f, begin, end]() { f(begin, end); }));
+        }
+        // Wait for everything before get() so a throwing chunk can't
+        // leave others running against a dead f
+        const bool help = on_worker();
+        for (auto& fut : futs) {
+            while (help && fut.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                // Nothing queued means the chunk is running elsewhere
+                if (!run_pending())
+                    break;
+            }
+            fut.wait();
+        }
+        for (auto& fut : futs)
+            fut.get();
+    }
+
+    inline size_t get_worker_cnt() const {
+        return workers.size();
+    }
+
+    // True on the threads of this pool
+    inline bool on_worker() const {
+        return current_pool() == this;
+    }
+
+private:
+    // One queued job on the calling thread, false when there was none
+    bool run_pending() {
+        std::function<void()> job;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (jobs.empty())
+                return false;
+            job = std::move(jobs.front());
+            jobs.pop();
+        }
+        job();
+        return true;
+    }
+
+    static inline const ThreadPool*& current_pool() {
+        static thread_local const ThreadPool* pool = nullptr;
+        return pool;
+    }
+
+    std::vector<std::thread>            workers;
+    std::queue<std::function<void()>>   jobs;
+    std::mutex                          mtx;
+    std::condition_variable             cv;
+    bool                                stopping = false;
+};
+
+}
@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <vector>
+
+#include "vk_ins/bindless.h"
+
+namespace vkkk
+{
+
+void BindlessHeap::create(VkDevice device, const bool indexed, const uint32_t image_cnt,
+    const uint32_t buffer_cnt)
+{
+    indexing = indexed;
+    // Fallback shaders declare fixed size arrays, the layout has to match
+    uint32_t images = indexing ? std::max(1u, image_cnt) : BINDLESS_FALLBACK_IMAGES;
+    uint32_t buffers = indexing ? std::max(1u, buffer_cnt) : BINDLESS_FALLBACK_BUFFERS;
+
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings{{
+        {
+            .binding = BINDLESS_IMAGE_BINDING,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = images,
+            .stageFlags = VK_SHADER_STAGE_ALL,
+            .pImmutableSamplers = nullptr
+        },
+        {
+            .binding = BINDLESS_BUFFER_BINDING,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = buffers,
+            .stageFlags = VK_SHADER_STAGE_ALL,
+            .pImmutableSamplers = nullptr
+        }
+    }};
+
+    const VkDescriptorBindingFlagsEXT binding_flag =
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+        VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+        VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+    std::array<VkDescriptorBindingFlagsEXT, 2> binding_flags{binding_flag, binding_flag};
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT flags_info{};
+    flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+    flags_info.bindingCount = binding_flags.size();
+    flags_info.pBindingFlags = binding_flags.data();
+
+    VkDescriptorSetLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = bindings.size();
+    layout_info.pBindings = bindings.data();
+    if (indexing) {
+        layout_info.pNext = &flags_info;
+        layout_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+    }
+    if (vkCreateDescriptorSetLayout(device, &layout_info, nullptr, &layout) != VK_SUCCESS)
+        throw std::runtime_error("failed to create bindless descriptor set layout");
+
+    std::array<VkDescriptorPoolSize, 2> sizes{{
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, images},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, buffers}
+    }};
+    VkDescriptorPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.poolSizeCount = sizes.size();
+    pool_info.pPoolSizes = sizes.data();
+    pool_info.maxSets = 1;
+    if (indexing)
+        pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+    if (vkCreateDescriptorPool(device, &pool_info, nullptr, &pool) != VK_SUCCESS) {
+        destroy(device);
+        throw std::runtime_error("failed to create bindless descriptor pool");
+    }
+
+    VkDescriptorSetAllocateInfo alloc_info{};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = pool;
+    alloc_info.descriptorSetCount = 1;
+    alloc_info.pSetLayouts = &layout;
+    if (vkAllocateDescriptorSets(device, &alloc_info, &set) != VK_SUCCESS) {
+        destroy(device);
+        throw std::runtime_error("failed to allocate bindless descriptor set");
+    }
+
+    image_slots.reset(images);
+    buffer_slots.reset(buffers);
+}
+
+void BindlessHeap::destroy(VkDevice device) {
+    // The set goes with its pool
+    if (pool != VK_NULL_HANDLE)
+        vkDestroyDescriptorPool(device, pool, nullptr);
+    if (layout != VK_NULL_HANDLE)
+        vkDestroyDescriptorSetLayout(device, layout, nullptr);
+    pool = VK_NULL_HANDLE;
+    layout = VK_NULL_HANDLE;
+    set = VK_NULL_HANDLE;
+    image_slots.reset(0);
+    buffer_slots.reset(0);
+    default_image.reset();
+    default_buffer.reset();
+}
+
+uint32_t BindlessHeap::add_image(VkDevice device, const VkDescriptorImageInfo& info) {
+    auto slot = image_slots.alloc();
+    if (!slot)
+        return BINDLESS_NONE;
+
+    if (!indexing && !default_image) {
+        // Nothing valid to fill the array with before this
+        default_image = info;
+        std::vector<VkDescriptorImageInfo> infos(image_slots.get_capacity(), info);
+        write(device, BINDLESS_IMAGE_BINDING, 0, infos.size(), infos.data(), nullptr);
+    }
+    else
+        write(device, BINDLESS_IMAGE_BINDING, *slot, 1, &info, nullptr);
+    return *slot;
+}
+
+uint32_t BindlessHeap::add_buffer(VkDevice device, const VkDescriptorBufferInfo& info) {
+    auto slot = buffer_slots.alloc();
+    if (!slot)
+        return BINDLESS_NONE;
+
+    if (!indexing && !default_buffer) {
+        default_buffer = info;
+        std::vector<VkDescriptorBufferInfo> infos(buffer_slots.get_capacity(), info);
+        write(device, BINDLESS_BUFFER_BINDING, 0, infos.size(), nullptr, infos.data());
+    }
+    else
+        write(device, BINDLESS_BUFFER_BINDING, *slot, 1, nullptr, &info);
+    return *slot;
+}
+
+bool BindlessHeap::remove_image(VkDevice device, const uint32_t slot) {
+    if (!image_slots.release(slot))
+        return false;
+    // Partially bound arrays can keep the stale descriptor around
+    if (!indexing)
+        write(device, BINDLESS_IMAGE_BINDING, slot, 1, &*default_image, nullptr);
+    return true;
+}
+
+bool BindlessHeap::remove_buffer(VkDevice device, const uint32_t slot) {
+    if (!buffer_slots.release(slot))
+        return false;
+    if (!indexing)
+        write(device, BINDLESS_BUFFER_BINDING, slot, 1, nullptr, &*default_buffer);
+    return true;
+}
+
+void BindlessHeap::emit_bind_cmd(VkCommandBuffer cmd_buf, VkPipelineLayout ppl_layout,
+    const VkPipelineBindPoint bind_point) const
+{
+    vkCmdBindDescriptorSets(cmd_buf, bind_point, ppl_layout, BINDLESS_SET, 1, &set, 0, nullptr);
+}
+
+void BindlessHeap::write(VkDevice device, const uint32_t binding, const uint32_t slot,
+    const uint32_t cnt, const VkDescriptorImageInfo* images,
+    const VkDescriptorBufferInfo* buffers) const
+{
+    // Without update after bind the set can't change under a pending
+    // command buffer
+    if (!indexing)
+        vkDeviceWaitIdle(device);
+
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = set;
+    write.dstBinding = binding;
+    write.dstArrayElement = slot;
+    write.descriptorCount = cnt;
+    write.descriptorType = images != nullptr ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER :
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pImageInfo = images;
+    write.pBufferInfo = buffers;
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+}
+
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+#include <vulkan/vulkan.h>
+
+#include "utils/macros.h"
+#include "utils/slot_allocator.h"
+
+namespace vkkk
+{
+
+/************************************************************
+ * One descriptor set holding every texture and storage buffer
+ * a bindless shader can reach, addressed by array slot.
+ * Materials store slots instead of owning descriptors, so
+ * draws with different materials share a single bind of the
+ * heap at set BINDLESS_SET.
+ * With VK_EXT_descriptor_indexing the arrays are large,
+ * partially bound and written after bind, adding a texture
+ * while earlier frames are in flight is fine. Without it the
+ * arrays shrink to BINDLESS_FALLBACK_* entries that all have
+ * to be valid, unused slots repeat the first resource added,
+ * every write waits for the device to go idle and command
+ * buffers that bound the heap have to be recorded again.
+ ************************************************************/
+
+class BindlessHeap {
+public:
+    // Counts are ignored without indexing, the arrays are then exactly
+    // BINDLESS_FALLBACK_* long to match what shaders declare. Throws when
+    // the layout, pool or set can't be created
+    void create(VkDevice device, const bool indexing, const uint32_t image_cnt,
+        const uint32_t buffer_cnt);
+    void destroy(VkDevice device);
+
+    // Slot written with info, BINDLESS_NONE once the array is full
+    uint32_t add_image(VkDevice device, const VkDescriptorImageInfo& info);
+    uint32_t add_buffer(VkDevice device, const VkDescriptorBufferInfo& info);
+    // The slot is handed out again right away, so only call this once no
+    // frame in flight reads it, VkWrappedInstance::remove_bindless_*
+    // defers it until then. Without indexing it is pointed back at the
+    // first resource added, which therefore has to outlive the heap
+    bool remove_image(VkDevice device, const uint32_t slot);
+    bool remove_buffer(VkDevice device, const uint32_t slot);
+
+    void emit_bind_cmd(VkCommandBuffer cmd_buf, VkPipelineLayout ppl_layout,
+        const VkPipelineBindPoint bind_point=VK_PIPELINE_BIND_POINT_GRAPHICS) const;
+
+    inline bool created() const {
+        return set != VK_NULL_HANDLE;
+    }
+
+    inline bool is_indexed() const {
+        return indexing;
+    }
+
+    inline VkDescriptorSetLayout get_layout() const {
+        return layout;
+    }
+
+    inline VkDescriptorSet get_set() const {
+        return set;
+    }
+
+    inline const SlotAllocator& get_image_slots() const {
+        return image_slots;
+    }
+
+    inline const SlotAllocator& get_buffer_slots() const {
+        return buffer_slots;
+    }
+
+private:
+    void write(VkDevice device, const uint32_t binding, const uint32_t slot,
+        const uint32_t cnt, const VkDescriptorImageInfo* images,
+        const VkDescriptorBufferInfo* buffers) const;
+
+    VkDescriptorSetLayout                   layout = VK_NULL_HANDLE;
+    VkDescriptorPool                        pool = VK_NULL_HANDLE;
+    VkDescriptorSet                         set = VK_NULL_HANDLE;
+    bool                                    indexing = false;
+    SlotAllocator                           image_slots;
+    SlotAllocator                           buffer_slots;
+
+    // Fallback only, fills every slot not handed out
+    std::optional<VkDescriptorImageInfo>    default_image;
+    std::optional<VkDescriptorBufferInfo>   default_buffer;
+};
+
+}
@@ -8,7 +8,7 @@ namespace vkkk
 CommandBuffers::CommandBuffers(VkWrappedInstance* i)
     : ins(i)
 {
-    bufs.resize(ins->get_swapchain_cnt());
+    bufs.resize(ins->get_frames_in_flight());
 }
 
 void CommandBuffers::alloc() {
@@ -0,0 +1,317 @@
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+
+#include <fmt/format.h>
+
+#include "vk_ins/descriptor.h"
+
+namespace vkkk
+{
+
+// Non-dispatchable handles are pointers on 64 bit platforms and plain
+// integers elsewhere
+template <typename H>
+static inline uint64_t handle_bits(H h) {
+    if constexpr (std::is_pointer_v<H>)
+        return reinterpret_cast<uintptr_t>(h);
+    else
+        return static_cast<uint64_t>(h);
+}
+
+static inline void hash_combine(size_t& seed, const uint64_t v) {
+    seed ^= std::hash<uint64_t>{}(v) + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+}
+
+DescriptorLayoutKey::DescriptorLayoutKey(std::vector<VkDescriptorSetLayoutBinding> in)
+{
+    std::stable_sort(in.begin(), in.end(), [](auto& a, auto& b) {
+        return a.binding < b.binding;
+    });
+
+    for (auto& b : in) {
+        if (!bindings.empty() && bindings.back().binding == b.binding &&
+            bindings.back().descriptorType == b.descriptorType &&
+            bindings.back().descriptorCount == b.descriptorCount)
+        {
+            bindings.back().stageFlags |= b.stageFlags;
+            continue;
+        }
+        bindings.push_back(b);
+    }
+
+    samplers.resize(bindings.size());
+    for (size_t i = 0; i < bindings.size(); ++i) {
+        auto& b = bindings[i];
+        if (b.pImmutableSamplers != nullptr) {
+            samplers[i].assign(b.pImmutableSamplers, b.pImmutableSamplers + b.descriptorCount);
+            b.pImmutableSamplers = samplers[i].data();
+        }
+
+        hash_combine(hash, b.binding);
+        hash_combine(hash, b.descriptorType);
+        hash_combine(hash, b.descriptorCount);
+        hash_combine(hash, b.stageFlags);
+        for (auto sampler : samplers[i])
+            hash_combine(hash, handle_bits(sampler));
+    }
+}
+
+bool DescriptorLayoutKey::operator==(const DescriptorLayoutKey& other) const {
+    if (hash != other.hash || bindings.size() != other.bindings.size())
+        return false;
+    for (size_t i = 0; i < bindings.size(); ++i) {
+        auto& a = bindings[i];
+        auto& b = other.bindings[i];
+        if (a.binding != b.binding || a.descriptorType != b.descriptorType ||
+            a.descriptorCount != b.descriptorCount || a.stageFlags != b.stageFlags)
+            return false;
+    }
+    return samplers == other.samplers;
+}
+
+static inline bool is_image_type(const VkDescriptorType type) {
+    return type == VK_DESCRIPTOR_TYPE_SAMPLER ||
+        type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER ||
+        type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE ||
+        type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE ||
+        type == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+}
+
+bool DescriptorBinding::operator==(const DescriptorBinding& other) const {
+    if (binding != other.binding || type != other.type)
+        return false;
+    if (is_image_type(type))
+        return image.sampler == other.image.sampler &&
+            image.imageView == other.image.imageView &&
+            image.imageLayout == other.image.imageLayout;
+    return buffer.buffer == other.buffer.buffer && buffer.offset == other.buffer.offset &&
+        buffer.range == other.buffer.range;
+}
+
+DescriptorSetKey::DescriptorSetKey(VkDescriptorSetLayout layout,
+    std::vector<DescriptorBinding> in)
+    : layout(layout)
+    , bindings(std::move(in))
+{
+    std::stable_sort(bindings.begin(), bindings.end(), [](auto& a, auto& b) {
+        return a.binding < b.binding;
+    });
+
+    hash_combine(hash, handle_bits(layout));
+    for (auto& b : bindings) {
+        hash_combine(hash, b.binding);
+        hash_combine(hash, b.type);
+        if (is_image_type(b.type)) {
+            hash_combine(hash, handle_bits(b.image.sampler));
+            hash_combine(hash, handle_bits(b.image.imageView));
+            hash_combine(hash, b.image.imageLayout);
+        }
+        else {
+            hash_combine(hash, handle_bits(b.buffer.buffer));
+            hash_combine(hash, b.buffer.offset);
+            hash_combine(hash, b.buffer.range);
+        }
+    }
+}
+
+bool DescriptorSetKey::operator==(const DescriptorSetKey& other) const {
+    return hash == other.hash && layout == other.layout && bindings == other.bindings;
+}
+
+bool DescriptorSetKey::references(const uint64_t handle) const {
+    for (auto& b : bindings) {
+        if (is_image_type(b.type)) {
+            if (handle_bits(b.image.sampler) == handle || handle_bits(b.image.imageView) == handle)
+                return true;
+        }
+        else if (handle_bits(b.buffer.buffer) == handle)
+            return true;
+    }
+    return false;
+}
+
+VkDescriptorSetLayout DescriptorLayoutCache::get(VkDevice device,
+    const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+{
+    DescriptorLayoutKey key(bindings);
+    auto found = layouts.find(key);
+    if (found != layouts.end())
+        return found->second;
+
+    VkDescriptorSetLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = key.bindings.size();
+    layout_info.pBindings = key.bindings.data();
+
+    VkDescriptorSetLayout layout;
+    if (vkCreateDescriptorSetLayout(device, &layout_info, nullptr, &layout) != VK_SUCCESS)
+        throw std::runtime_error("failed to create descriptor set layout");
+    layouts.emplace(std::move(key), layout);
+    return layout;
+}
+
+void DescriptorLayoutCache::destroy(VkDevice device) {
+    for (auto& [key, layout] : layouts)
+        vkDestroyDescriptorSetLayout(device, layout, nullptr);
+    layouts.clear();
+}
+
+DescriptorAllocator::DescriptorAllocator(const uint32_t first_page_sets,
+    const uint32_t max_page_sets)
+    : page_sets(first_page_sets)
+    , max_page_sets(max_page_sets)
+{
+    // Rough mix of what our shaders declare, a page that runs out of one
+    // type early is simply retired
+    ratios = {
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.f},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4.f},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.f},
+        {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1.f},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.f},
+        {VK_DESCRIPTOR_TYPE_SAMPLER, 0.5f}
+    };
+}
+
+VkDescriptorPool DescriptorAllocator::grab_page(VkDevice device) {
+    if (!free_pages.empty()) {
+        auto page = free_pages.back();
+        free_pages.pop_back();
+        return page;
+    }
+
+    std::vector<VkDescriptorPoolSize> sizes;
+    sizes.reserve(ratios.size());
+    for (auto& r : ratios)
+        sizes.push_back({r.type, std::max(1u, static_cast<uint32_t>(r.ratio * page_sets))});
+
+    VkDescriptorPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.poolSizeCount = sizes.size();
+    pool_info.pPoolSizes = sizes.data();
+    pool_info.maxSets = page_sets;
+    // Sets dropped by the set cache go back one by one
+    pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+
+    VkDescriptorPool page;
+    if (vkCreateDescriptorPool(device, &pool_info, nullptr, &page) != VK_SUCCESS)
+        throw std::runtime_error("failed to create descriptor pool page");
+    page_sets = std::min(page_sets * 2, max_page_sets);
+    return page;
+}
+
+VkDescriptorSet DescriptorAllocator::alloc(VkDevice device, VkDescriptorSetLayout layout) {
+    if (current == VK_NULL_HANDLE)
+        current = grab_page(device);
+
+    VkDescriptorSetAllocateInfo alloc_info{};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = current;
+    alloc_info.descriptorSetCount = 1;
+    alloc_info.pSetLayouts = &layout;
+
+    VkDescriptorSet set;
+    auto result = vkAllocateDescriptorSets(device, &alloc_info, &set);
+    if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+        // Retire the full page and retry once on a fresh one
+        used_pages.push_back(current);
+        current = grab_page(device);
+        alloc_info.descriptorPool = current;
+        result = vkAllocateDescriptorSets(device, &alloc_info, &set);
+    }
+
+    if (result != VK_SUCCESS)
+        throw std::runtime_error(fmt::format("failed to allocate descriptor set : {}",
+            static_cast<int>(result)));
+    ++allocated_cnt;
+    set_pages.emplace(set, current);
+    ++page_live[current];
+    return set;
+}
+
+void DescriptorAllocator::free(VkDevice device, VkDescriptorSet set) {
+    auto found = set_pages.find(set);
+    if (found == set_pages.end())
+        return;
+
+    auto page = found->second;
+    set_pages.erase(found);
+    vkFreeDescriptorSets(device, page, 1, &set);
+    --allocated_cnt;
+    if (--page_live[page] > 0 || page == current)
+        return;
+
+    // Retired for being full, empty now
+    page_live.erase(page);
+    std::erase(used_pages, page);
+    vkResetDescriptorPool(device, page, 0);
+    free_pages.push_back(page);
+}
+
+void DescriptorAllocator::reset(VkDevice device) {
+    if (current != VK_NULL_HANDLE)
+        used_pages.push_back(current);
+    current = VK_NULL_HANDLE;
+    for (auto page : used_pages) {
+        vkResetDescriptorPool(device, page, 0);
+        free_pages.push_back(page);
+    }
+    used_pages.clear();
+    set_pages.clear();
+    page_live.clear();
+    allocated_cnt = 0;
+}
+
+void DescriptorAllocator::destroy(VkDevice device) {
+    reset(device);
+    for (auto page : free_pages)
+        vkDestroyDescriptorPool(device, page, nullptr);
+    free_pages.clear();
+}
+
+VkDescriptorSet DescriptorSetCache::get(VkDevice device, DescriptorAllocator& allocator,
+    VkDescriptorSetLayout layout, const std::vector<DescriptorBinding>& bindings)
+{
+    DescriptorSetKey key(layout, bindings);
+    auto found = sets.find(key);
+    if (found != sets.end()) {
+        ++hits;
+        return found->second;
+    }
+    ++misses;
+
+    auto set = allocator.alloc(device, layout);
+    std::vector<VkWriteDescriptorSet> writes(key.bindings.size());
+    for (size_t i = 0; i < key.bindings.size(); ++i) {
+        auto& b = key.bindings[i];
+        auto& write = writes[i];
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = set;
+        write.dstBinding = b.binding;
+        write.dstArrayElement = 0;
+        write.descriptorType = b.type;
+        write.descriptorCount = 1;
+        if (is_image_type(b.type))
+            write.pImageInfo = &b.image;
+        else
+            write.pBufferInfo = &b.buffer;
+    }
+    vkUpdateDescriptorSets(device, writes.size(), writes.data(), 0, nullptr);
+
+    sets.emplace(std::move(key), set);
+    return set;
+}
+
+std::vector<VkDescriptorSet> DescriptorSetCache::forget_bits(const uint64_t handle) {
+    std::vector<VkDescriptorSet> dropped;
+    std::erase_if(sets, [&](const auto& kv) {
+        if (!kv.first.references(handle))
+            return false;
+        dropped.push_back(kv.second);
+        return true;
+    });
+    return dropped;
+}
+
+}
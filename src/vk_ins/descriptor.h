@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace vkkk
+{
+
+/************************************************************
+ * Descriptor sets are shared between pipelines instead of
+ * every pipeline owning a pool sized for itself.
+ * Layouts are cached by their bindings, two pipelines
+ * declaring the same bindings get the same layout handle.
+ * Sets come from pool pages that are added when the current
+ * one runs out, and a set is looked up by its layout plus the
+ * resources bound to it, so pipelines and materials binding
+ * identical resources end up with one set.
+ ************************************************************/
+
+// Bindings sorted by binding number, a binding declared by several stages
+// is merged into one with the stage flags or'ed. Immutable samplers are
+// copied into the key and compared by handle, pImmutableSamplers of the
+// stored bindings point into that copy, so keys can only be moved
+struct DescriptorLayoutKey {
+    DescriptorLayoutKey(std::vector<VkDescriptorSetLayoutBinding> bindings);
+    DescriptorLayoutKey(DescriptorLayoutKey&&) = default;
+    DescriptorLayoutKey(const DescriptorLayoutKey&) = delete;
+
+    bool operator==(const DescriptorLayoutKey& other) const;
+
+    std::vector<VkDescriptorSetLayoutBinding>   bindings;
+    std::vector<std::vector<VkSampler>>         samplers;
+    size_t                                      hash = 0;
+};
+
+// One resource bound to a binding, only the member matching type is used
+struct DescriptorBinding {
+    uint32_t                                    binding;
+    VkDescriptorType                            type;
+    VkDescriptorBufferInfo                      buffer{};
+    VkDescriptorImageInfo                       image{};
+
+    bool operator==(const DescriptorBinding& other) const;
+};
+
+struct DescriptorSetKey {
+    DescriptorSetKey(VkDescriptorSetLayout layout, std::vector<DescriptorBinding> bindings);
+
+    bool operator==(const DescriptorSetKey& other) const;
+
+    // Whether any binding refers to handle, a buffer, image view or sampler
+    bool references(const uint64_t handle) const;
+
+    VkDescriptorSetLayout                       layout;
+    std::vector<DescriptorBinding>              bindings;
+    size_t                                      hash = 0;
+};
+
+struct DescriptorKeyHash {
+    template <typename K>
+    inline size_t operator()(const K& key) const {
+        return key.hash;
+    }
+};
+
+class DescriptorLayoutCache {
+public:
+    VkDescriptorSetLayout get(VkDevice device,
+        const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+    void destroy(VkDevice device);
+
+    inline size_t size() const {
+        return layouts.size();
+    }
+
+private:
+    std::unordered_map<DescriptorLayoutKey, VkDescriptorSetLayout, DescriptorKeyHash>
+                                                layouts;
+};
+
+class DescriptorAllocator {
+public:
+    // Descriptors of each type a page holds per set
+    struct PoolRatio {
+        VkDescriptorType                        type;
+        float                                   ratio;
+    };
+
+    DescriptorAllocator(const uint32_t first_page_sets=64, const uint32_t max_page_sets=4096);
+
+    // Throws when a fresh page can't hold the set either
+    VkDescriptorSet alloc(VkDevice device, VkDescriptorSetLayout layout);
+    // Back to its page once no frame uses it anymore. A retired page whose
+    // sets are all freed is reset and reused
+    void free(VkDevice device, VkDescriptorSet set);
+    // Every set handed out becomes invalid, pages are kept for reuse
+    void reset(VkDevice device);
+    void destroy(VkDevice device);
+
+    inline size_t page_cnt() const {
+        return used_pages.size() + free_pages.size() + (current != VK_NULL_HANDLE);
+    }
+
+    inline uint32_t get_allocated_cnt() const {
+        return allocated_cnt;
+    }
+
+private:
+    VkDescriptorPool grab_page(VkDevice device);
+
+    std::vector<PoolRatio>                      ratios;
+    VkDescriptorPool                            current = VK_NULL_HANDLE;
+    std::vector<VkDescriptorPool>               used_pages;
+    std::vector<VkDescriptorPool>               free_pages;
+    // Page of every live set, and how many each page has
+    std::unordered_map<VkDescriptorSet, VkDescriptorPool>
+                                                set_pages;
+    std::unordered_map<VkDescriptorPool, uint32_t>
+                                                page_live;
+    // Pages double in size until max_page_sets
+    uint32_t                                    page_sets;
+    uint32_t                                    max_page_sets;
+    uint32_t                                    allocated_cnt = 0;
+};
+
+class DescriptorSetCache {
+public:
+    // Existing set for layout and bindings, or a new one written with them
+    VkDescriptorSet get(VkDevice device, DescriptorAllocator& allocator,
+        VkDescriptorSetLayout layout, const std::vector<DescriptorBinding>& bindings);
+
+    // Drops sets referring to a resource about to be destroyed, a new
+    // resource may come back with the same handle. Returns them for the
+    // caller to free once frames in flight are done with them
+    template <typename H>
+    inline std::vector<VkDescriptorSet> forget(H handle) {
+        if constexpr (std::is_pointer_v<H>)
+            return forget_bits(reinterpret_cast<uintptr_t>(handle));
+        else
+            return forget_bits(static_cast<uint64_t>(handle));
+    }
+
+    // Call along with DescriptorAllocator::reset
+    inline void clear() {
+        sets.clear();
+    }
+
+    inline size_t size() const {
+        return sets.size();
+    }
+
+    inline uint32_t get_hits() const {
+        return hits;
+    }
+
+    inline uint32_t get_misses() const {
+        return misses;
+    }
+
+private:
+    std::vector<VkDescriptorSet> forget_bits(const uint64_t handle);
+
+    std::unordered_map<DescriptorSetKey, VkDescriptorSet, DescriptorKeyHash>
+                                                sets;
+    uint32_t                                    hits = 0;
+    uint32_t                                    misses = 0;
+};
+
+}
@@ -0,0 +1,139 @@
+#include <algorithm>
+
+#include "vk_ins/dynamic_state.h"
+
+namespace vkkk
+{
+
+bool is_extended_dynamic_state(const VkDynamicState state) {
+    switch (state) {
+        case VK_DYNAMIC_STATE_CULL_MODE_EXT:
+        case VK_DYNAMIC_STATE_FRONT_FACE_EXT:
+        case VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT:
+        case VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT:
+        case VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT:
+        case VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+std::vector<VkDynamicState> supported_dynamic_states(const std::vector<VkDynamicState>& states,
+    const bool extended)
+{
+    std::vector<VkDynamicState> ret;
+    ret.reserve(states.size());
+    for (auto state : states) {
+        if (!extended && is_extended_dynamic_state(state))
+            continue;
+        if (std::find(ret.begin(), ret.end(), state) == ret.end())
+            ret.push_back(state);
+    }
+    return ret;
+}
+
+void cmd_set_viewport(VkCommandBuffer cmd_buf, const VkExtent2D& extent) {
+    cmd_set_viewport(cmd_buf, 0.f, 0.f, static_cast<float>(extent.width),
+        static_cast<float>(extent.height));
+}
+
+void cmd_set_viewport(VkCommandBuffer cmd_buf, const float x, const float y, const float w,
+    const float h, const float min_depth, const float max_depth)
+{
+    VkViewport viewport{
+        .x = x,
+        .y = y,
+        .width = w,
+        .height = h,
+        .minDepth = min_depth,
+        .maxDepth = max_depth
+    };
+    vkCmdSetViewport(cmd_buf, 0, 1, &viewport);
+}
+
+void cmd_set_scissor(VkCommandBuffer cmd_buf, const VkExtent2D& extent) {
+    cmd_set_scissor(cmd_buf, 0, 0, extent.width, extent.height);
+}
+
+void cmd_set_scissor(VkCommandBuffer cmd_buf, const int32_t x, const int32_t y,
+    const uint32_t w, const uint32_t h)
+{
+    VkRect2D scissor{{x, y}, {w, h}};
+    vkCmdSetScissor(cmd_buf, 0, 1, &scissor);
+}
+
+void cmd_set_depth_bias(VkCommandBuffer cmd_buf, const float constant, const float slope,
+    const float clamp)
+{
+    vkCmdSetDepthBias(cmd_buf, constant, clamp, slope);
+}
+
+void ExtendedDynamicState::load(VkDevice device) {
+    auto get = [&](const char* name) {
+        return vkGetDeviceProcAddr(device, name);
+    };
+    set_cull_mode_func = reinterpret_cast<PFN_vkCmdSetCullModeEXT>(
+        get("vkCmdSetCullModeEXT"));
+    set_front_face_func = reinterpret_cast<PFN_vkCmdSetFrontFaceEXT>(
+        get("vkCmdSetFrontFaceEXT"));
+    set_topology_func = reinterpret_cast<PFN_vkCmdSetPrimitiveTopologyEXT>(
+        get("vkCmdSetPrimitiveTopologyEXT"));
+    set_depth_test_func = reinterpret_cast<PFN_vkCmdSetDepthTestEnableEXT>(
+        get("vkCmdSetDepthTestEnableEXT"));
+    set_depth_write_func = reinterpret_cast<PFN_vkCmdSetDepthWriteEnableEXT>(
+        get("vkCmdSetDepthWriteEnableEXT"));
+    set_depth_compare_op_func = reinterpret_cast<PFN_vkCmdSetDepthCompareOpEXT>(
+        get("vkCmdSetDepthCompareOpEXT"));
+
+    // All or nothing, the extension brings them together
+    if (!set_cull_mode_func || !set_front_face_func || !set_topology_func ||
+        !set_depth_test_func || !set_depth_write_func || !set_depth_compare_op_func)
+    {
+        *this = ExtendedDynamicState{};
+    }
+}
+
+bool ExtendedDynamicState::set_cull_mode(VkCommandBuffer cmd_buf, const VkCullModeFlags mode) const {
+    if (!loaded())
+        return false;
+    set_cull_mode_func(cmd_buf, mode);
+    return true;
+}
+
+bool ExtendedDynamicState::set_front_face(VkCommandBuffer cmd_buf, const VkFrontFace face) const {
+    if (!loaded())
+        return false;
+    set_front_face_func(cmd_buf, face);
+    return true;
+}
+
+bool ExtendedDynamicState::set_topology(VkCommandBuffer cmd_buf, const VkPrimitiveTopology topo) const {
+    if (!loaded())
+        return false;
+    set_topology_func(cmd_buf, topo);
+    return true;
+}
+
+bool ExtendedDynamicState::set_depth_test(VkCommandBuffer cmd_buf, const bool enable) const {
+    if (!loaded())
+        return false;
+    set_depth_test_func(cmd_buf, enable ? VK_TRUE : VK_FALSE);
+    return true;
+}
+
+bool ExtendedDynamicState::set_depth_write(VkCommandBuffer cmd_buf, const bool enable) const {
+    if (!loaded())
+        return false;
+    set_depth_write_func(cmd_buf, enable ? VK_TRUE : VK_FALSE);
+    return true;
+}
+
+bool ExtendedDynamicState::set_depth_compare_op(VkCommandBuffer cmd_buf, const VkCompareOp op) const {
+    if (!loaded())
+        return false;
+    set_depth_compare_op_func(cmd_buf, op);
+    return true;
+}
+
+}
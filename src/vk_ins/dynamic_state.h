@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace vkkk
+{
+
+// States only VK_EXT_extended_dynamic_state makes dynamic, cull mode,
+// front face, topology and the depth test ones
+bool is_extended_dynamic_state(const VkDynamicState state);
+
+// states without duplicates, and without the extended ones when the
+// extension isn't enabled, the pipeline then bakes those from its option
+std::vector<VkDynamicState> supported_dynamic_states(const std::vector<VkDynamicState>& states,
+    const bool extended);
+
+// Viewport and scissor covering extent, what pipelines with dynamic
+// viewport and scissor need before their first draw
+void cmd_set_viewport(VkCommandBuffer cmd_buf, const VkExtent2D& extent);
+void cmd_set_viewport(VkCommandBuffer cmd_buf, const float x, const float y, const float w,
+    const float h, const float min_depth=0.f, const float max_depth=1.f);
+void cmd_set_scissor(VkCommandBuffer cmd_buf, const VkExtent2D& extent);
+void cmd_set_scissor(VkCommandBuffer cmd_buf, const int32_t x, const int32_t y,
+    const uint32_t w, const uint32_t h);
+void cmd_set_depth_bias(VkCommandBuffer cmd_buf, const float constant, const float slope,
+    const float clamp=0.f);
+
+/************************************************************
+ * Command side of VK_EXT_extended_dynamic_state. The loader
+ * doesn't export extension commands, they are fetched from
+ * the device once. Every setter is a no-op returning false
+ * when the extension isn't there, callers then need a
+ * pipeline with the state baked in instead.
+ ************************************************************/
+
+class ExtendedDynamicState {
+public:
+    void load(VkDevice device);
+
+    inline bool loaded() const {
+        return set_cull_mode_func != nullptr;
+    }
+
+    bool set_cull_mode(VkCommandBuffer cmd_buf, const VkCullModeFlags mode) const;
+    bool set_front_face(VkCommandBuffer cmd_buf, const VkFrontFace face) const;
+    bool set_topology(VkCommandBuffer cmd_buf, const VkPrimitiveTopology topo) const;
+    bool set_depth_test(VkCommandBuffer cmd_buf, const bool enable) const;
+    bool set_depth_write(VkCommandBuffer cmd_buf, const bool enable) const;
+    bool set_depth_compare_op(VkCommandBuffer cmd_buf, const VkCompareOp op) const;
+
+private:
+    PFN_vkCmdSetCullModeEXT                 set_cull_mode_func = nullptr;
+    PFN_vkCmdSetFrontFaceEXT                set_front_face_func = nullptr;
+    PFN_vkCmdSetPrimitiveTopologyEXT        set_topology_func = nullptr;
+    PFN_vkCmdSetDepthTestEnableEXT          set_depth_test_func = nullptr;
+    PFN_vkCmdSetDepthWriteEnableEXT         set_depth_write_func = nullptr;
+    PFN_vkCmdSetDepthCompareOpEXT           set_depth_compare_op_func = nullptr;
+};
+
+}
@@ -0,0 +1,154 @@
+#include <array>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+#include "vk_ins/frame_scheduler.h"
+
+namespace vkkk
+{
+
+void FrameLimiter::set_fps(const double fps) {
+    period = fps > 0. ? std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(1. / fps)) : Clock::duration{0};
+    next = Clock::time_point{};
+}
+
+FrameLimiter::Clock::duration FrameLimiter::next_delay(const Clock::time_point now) {
+    if (!enabled())
+        return Clock::duration{0};
+
+    if (next == Clock::time_point{} || now > next + period)
+        next = now;
+    auto delay = std::max(next - now, Clock::duration{0});
+    next += period;
+    return delay;
+}
+
+void FrameLimiter::wait() {
+    auto delay = next_delay(Clock::now());
+    if (delay.count() > 0)
+        std::this_thread::sleep_for(delay);
+}
+
+void FrameScheduler::create(VkDevice device, const uint32_t cnt, const bool use_timeline) {
+    frames_in_flight = std::max(1u, cnt);
+    latency = std::clamp(latency, 1u, frames_in_flight);
+    frame = 1;
+    completed = 0;
+
+    if (use_timeline) {
+        wait_semaphores = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(
+            vkGetDeviceProcAddr(device, "vkWaitSemaphoresKHR"));
+        get_counter_value = reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(
+            vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValueKHR"));
+        if (wait_semaphores == nullptr || get_counter_value == nullptr)
+            throw std::runtime_error("timeline semaphore functions not available");
+
+        VkSemaphoreTypeCreateInfoKHR type_info{};
+        type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+        type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+        type_info.initialValue = 0;
+
+        VkSemaphoreCreateInfo semaphore_info{};
+        semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphore_info.pNext = &type_info;
+        if (vkCreateSemaphore(device, &semaphore_info, nullptr, &timeline) != VK_SUCCESS)
+            throw std::runtime_error("failed to create frame timeline semaphore");
+        return;
+    }
+
+    VkFenceCreateInfo fence_info{};
+    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    fences.assign(frames_in_flight, VK_NULL_HANDLE);
+    for (auto& fence : fences) {
+        if (vkCreateFence(device, &fence_info, nullptr, &fence) != VK_SUCCESS) {
+            destroy(device);
+            throw std::runtime_error("failed to create frame fence");
+        }
+    }
+}
+
+void FrameScheduler::destroy(VkDevice device) {
+    if (timeline != VK_NULL_HANDLE)
+        vkDestroySemaphore(device, timeline, nullptr);
+    for (auto fence : fences)
+        if (fence != VK_NULL_HANDLE)
+            vkDestroyFence(device, fence, nullptr);
+    timeline = VK_NULL_HANDLE;
+    wait_semaphores = nullptr;
+    get_counter_value = nullptr;
+    fences.clear();
+}
+
+void FrameScheduler::set_latency(const uint32_t l) {
+    latency = timeline != VK_NULL_HANDLE || !fences.empty() ?
+        std::clamp(l, 1u, frames_in_flight) : l;
+}
+
+uint32_t FrameScheduler::wait_for_slot(VkDevice device) {
+    auto start = std::chrono::steady_clock::now();
+
+    auto value = wait_value(frame, latency);
+    if (value != 0) {
+        if (timeline != VK_NULL_HANDLE) {
+            VkSemaphoreWaitInfoKHR wait_info{};
+            wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+            wait_info.semaphoreCount = 1;
+            wait_info.pSemaphores = &timeline;
+            wait_info.pValues = &value;
+            wait_semaphores(device, &wait_info, UINT64_MAX);
+        }
+        else {
+            // Fences only cover their own submit, the slot's last frame
+            // gets waited on as well when latency is below frames in flight
+            std::array<VkFence, 2> wait_fences{fences[value % frames_in_flight],
+                fences[get_slot()]};
+            vkWaitForFences(device, wait_fences[0] == wait_fences[1] ? 1 : 2,
+                wait_fences.data(), VK_TRUE, UINT64_MAX);
+        }
+        completed = std::max(completed, value);
+    }
+
+    std::chrono::duration<double, std::milli> waited =
+        std::chrono::steady_clock::now() - start;
+    stats.record(waited.count());
+    return get_slot();
+}
+
+VkFence FrameScheduler::get_submit_fence(VkDevice device) {
+    if (timeline != VK_NULL_HANDLE)
+        return VK_NULL_HANDLE;
+
+    // Signaled, wait_for_slot waited on it
+    auto fence = fences[get_slot()];
+    vkResetFences(device, 1, &fence);
+    return fence;
+}
+
+void FrameScheduler::advance() {
+    ++frame;
+}
+
+uint64_t FrameScheduler::completed_frame(VkDevice device) {
+    if (timeline != VK_NULL_HANDLE) {
+        uint64_t value = 0;
+        if (get_counter_value(device, timeline, &value) == VK_SUCCESS)
+            completed = std::max(completed, value);
+        return completed;
+    }
+
+    // A slot only got reused after its previous frame was waited on, the
+    // latest frame of each slot needs its fence checked
+    while (completed + 1 < frame) {
+        auto next = completed + 1;
+        if (next + frames_in_flight >= frame &&
+            vkGetFenceStatus(device, fences[next % frames_in_flight]) != VK_SUCCESS)
+            break;
+        completed = next;
+    }
+    return completed;
+}
+
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace vkkk
+{
+
+// How long the CPU sat waiting for the GPU before preparing a frame,
+// in milliseconds
+struct FrameStats {
+    uint64_t                                frame_cnt = 0;
+    double                                  last_wait = 0.;
+    double                                  max_wait = 0.;
+    double                                  total_wait = 0.;
+
+    inline void record(const double wait) {
+        ++frame_cnt;
+        last_wait = wait;
+        max_wait = std::max(max_wait, wait);
+        total_wait += wait;
+    }
+
+    inline double avg_wait() const {
+        return frame_cnt == 0 ? 0. : total_wait / frame_cnt;
+    }
+};
+
+/************************************************************
+ * Caps the frame rate on the CPU for when vsync isn't there,
+ * e.g. immediate or mailbox present modes. Frames are paced
+ * against a schedule rather than the previous frame so short
+ * frames make up for long ones, falling more than a frame
+ * behind restarts the schedule instead of bursting.
+ ************************************************************/
+
+class FrameLimiter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // 0 turns the limiter off
+    void set_fps(const double fps);
+    // How long the frame starting at now should sleep, also moves the
+    // schedule on by one frame
+    Clock::duration next_delay(const Clock::time_point now);
+    void wait();
+
+    inline bool enabled() const {
+        return period.count() > 0;
+    }
+
+private:
+    Clock::duration                         period{0};
+    Clock::time_point                       next{};
+};
+
+/************************************************************
+ * Decides when the CPU may start preparing the next frame.
+ * Frames are numbered from 1, frame n uses the per frame
+ * resources of slot n % frames in flight and may start once
+ * frame n - latency is done on the GPU. Latency 1 gives the
+ * lowest input latency but no CPU/GPU overlap, 2 lets the CPU
+ * prepare frame n + 1 while the GPU renders n, and latency ==
+ * frames in flight only waits until the slot is free again.
+ * With VK_KHR_timeline_semaphore every submit signals its
+ * frame number on one semaphore and waiting on any older
+ * frame is a single vkWaitSemaphoresKHR. Without it each slot
+ * has a fence, the ones of frame n - latency and of the slot
+ * itself get waited on.
+ ************************************************************/
+
+class FrameScheduler {
+public:
+    // Throws when the sync objects can't be created
+    void create(VkDevice device, const uint32_t frames_in_flight, const bool timeline);
+    void destroy(VkDevice device);
+
+    // Clamped to [1, frames in flight] once created
+    void set_latency(const uint32_t latency);
+
+    // Blocks until the current frame may be prepared and returns its slot
+    uint32_t wait_for_slot(VkDevice device);
+    // Fence for vkQueueSubmit, reset and ready to use in fence mode and
+    // VK_NULL_HANDLE with a timeline, whose value goes in the submit instead
+    VkFence get_submit_fence(VkDevice device);
+    // Call once the current frame got submitted
+    void advance();
+    // Latest frame known to be done on the GPU, doesn't block
+    uint64_t completed_frame(VkDevice device);
+
+    // Value the timeline reaches once frame n - latency is done, 0 means
+    // nothing to wait for
+    static inline uint64_t wait_value(const uint64_t frame, const uint32_t latency) {
+        return frame > latency ? frame - latency : 0;
+    }
+
+    inline bool uses_timeline() const {
+        return timeline != VK_NULL_HANDLE;
+    }
+
+    inline VkSemaphore get_timeline() const {
+        return timeline;
+    }
+
+    inline uint64_t get_frame() const {
+        return frame;
+    }
+
+    // What a resource last used by the frames submitted so far gets
+    // retired against
+    inline uint64_t last_submitted() const {
+        return frame - 1;
+    }
+
+    inline uint32_t get_slot() const {
+        return frame % frames_in_flight;
+    }
+
+    inline uint32_t get_latency() const {
+        return latency;
+    }
+
+    inline const FrameStats& get_stats() const {
+        return stats;
+    }
+
+    inline void reset_stats() {
+        stats = FrameStats{};
+    }
+
+private:
+    uint32_t                                frames_in_flight = 1;
+    uint32_t                                latency = UINT32_MAX;
+    // Number of the frame being prepared
+    uint64_t                                frame = 1;
+    uint64_t                                completed = 0;
+
+    VkSemaphore                             timeline = VK_NULL_HANDLE;
+    PFN_vkWaitSemaphoresKHR                 wait_semaphores = nullptr;
+    PFN_vkGetSemaphoreCounterValueKHR       get_counter_value = nullptr;
+    std::vector<VkFence>                    fences;
+
+    FrameStats                              stats;
+};
+
+}
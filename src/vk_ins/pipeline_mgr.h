@@ -72,9 +72,8 @@ public:
     }
     
     inline void     create_descriptor_pools() {
-        // Here's another possible design:
-        // Create a single pool for all modules and you will only to create
-        // the pool once
+        // Pools are shared through the instance now, this is a no-op kept
+        // for existing callers
         for (auto& pipeline : pipelines)
             pipeline.modules->create_descriptor_pool();
     }
@@ -0,0 +1,411 @@
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+#include "utils/thread_pool.h"
+#include "vk_ins/pipeline_registry.h"
+
+namespace vkkk
+{
+
+template <typename H>
+static inline uint64_t handle_bits(H h) {
+    if constexpr (std::is_pointer_v<H>)
+        return reinterpret_cast<uintptr_t>(h);
+    else
+        return static_cast<uint64_t>(h);
+}
+
+static inline void hash_combine(size_t& seed, const uint64_t v) {
+    seed ^= std::hash<uint64_t>{}(v) + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+}
+
+static inline uint64_t float_bits(const float f) {
+    return std::bit_cast<uint32_t>(f);
+}
+
+VkPipeline PipelineBuildInfo::build(VkDevice device, VkPipelineCache cache) const {
+    std::vector<VkShaderModule> modules;
+    std::vector<VkPipelineShaderStageCreateInfo> shader_infos;
+    // Sized up front, the stage infos point into it
+    std::vector<VkSpecializationInfo> spec_infos(stages.size());
+    auto destroy_modules = [&]() {
+        for (auto module : modules)
+            vkDestroyShaderModule(device, module, nullptr);
+    };
+
+    for (size_t i = 0; i < stages.size(); ++i) {
+        auto& [stage, code] = stages[i];
+        VkShaderModuleCreateInfo module_info{
+            .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+            .codeSize = code.size() * sizeof(uint32_t),
+            .pCode = code.data()
+        };
+        VkShaderModule module;
+        if (vkCreateShaderModule(device, &module_info, nullptr, &module) != VK_SUCCESS) {
+            destroy_modules();
+            return VK_NULL_HANDLE;
+        }
+        modules.push_back(module);
+        shader_infos.push_back(VkPipelineShaderStageCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = stage,
+            .module = module,
+            .pName = "main"
+        });
+
+        if (i < specializations.size() && !specializations[i].first.empty()) {
+            auto& [entries, data] = specializations[i];
+            spec_infos[i] = VkSpecializationInfo{
+                .mapEntryCount = static_cast<uint32_t>(entries.size()),
+                .pMapEntries = entries.data(),
+                .dataSize = data.size(),
+                .pData = data.data()
+            };
+            shader_infos.back().pSpecializationInfo = &spec_infos[i];
+        }
+    }
+
+    VkPipelineVertexInputStateCreateInfo input_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        .vertexBindingDescriptionCount = static_cast<uint32_t>(input_bindings.size()),
+        .pVertexBindingDescriptions = input_bindings.data(),
+        .vertexAttributeDescriptionCount = static_cast<uint32_t>(input_attrs.size()),
+        .pVertexAttributeDescriptions = input_attrs.data()
+    };
+    VkPipelineViewportStateCreateInfo vp_state_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .viewportCount = 1,
+        .pViewports = &viewport,
+        .scissorCount = 1,
+        .pScissors = &scissor
+    };
+    auto blend = blend_state;
+    blend.attachmentCount = static_cast<uint32_t>(blend_attachments.size());
+    blend.pAttachments = blend_attachments.data();
+    VkPipelineDynamicStateCreateInfo dynamic_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .dynamicStateCount = static_cast<uint32_t>(dynamic_states.size()),
+        .pDynamicStates = dynamic_states.data()
+    };
+
+    VkGraphicsPipelineCreateInfo pipeline_info{
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .stageCount = static_cast<uint32_t>(shader_infos.size()),
+        .pStages = shader_infos.data(),
+        .pVertexInputState = &input_info,
+        .pInputAssemblyState = &input_assembly,
+        .pViewportState = &vp_state_info,
+        .pRasterizationState = &rasterizer,
+        .pMultisampleState = &multisampling,
+        .pDepthStencilState = &depth_stencil,
+        .pColorBlendState = &blend,
+        .pDynamicState = &dynamic_info,
+        .layout = layout,
+        .renderPass = render_pass,
+        .subpass = subpass,
+        .basePipelineHandle = VK_NULL_HANDLE
+    };
+
+    VkPipeline pipeline;
+    auto ret = vkCreateGraphicsPipelines(device, cache, 1, &pipeline_info, nullptr, &pipeline);
+    destroy_modules();
+    return ret == VK_SUCCESS ? pipeline : VK_NULL_HANDLE;
+}
+
+PipelineKey::PipelineKey(const PipelineBuildInfo& info,
+    const std::vector<VkDescriptorSetLayout>& set_layouts,
+    const std::vector<VkPushConstantRange>& push_ranges)
+{
+    auto add = [&](const uint64_t v) {
+        words.push_back(v);
+    };
+
+    for (size_t i = 0; i < info.stages.size(); ++i) {
+        auto& [stage, code] = info.stages[i];
+        add(stage);
+        add(code.size());
+        words.insert(words.end(), code.begin(), code.end());
+
+        // Same SPIR-V specialized differently is another pipeline, a
+        // missing specialization counts as an empty one
+        static const std::pair<std::vector<VkSpecializationMapEntry>, std::vector<char>> none;
+        auto& [entries, data] = i < info.specializations.size() ? info.specializations[i] : none;
+        add(entries.size());
+        for (auto& e : entries) {
+            add(e.constantID);
+            add(e.offset);
+            add(e.size);
+        }
+        add(data.size());
+        for (auto c : data)
+            add(static_cast<unsigned char>(c));
+    }
+
+    add(info.input_bindings.size());
+    for (auto& b : info.input_bindings) {
+        add(b.binding);
+        add(b.stride);
+        add(b.inputRate);
+    }
+    add(info.input_attrs.size());
+    for (auto& a : info.input_attrs) {
+        add(a.location);
+        add(a.binding);
+        add(a.format);
+        add(a.offset);
+    }
+
+    add(info.input_assembly.topology);
+    add(info.input_assembly.primitiveRestartEnable);
+
+    if (!info.is_dynamic(VK_DYNAMIC_STATE_VIEWPORT)) {
+        auto& vp = info.viewport;
+        for (auto f : {vp.x, vp.y, vp.width, vp.height, vp.minDepth, vp.maxDepth})
+            add(float_bits(f));
+    }
+    if (!info.is_dynamic(VK_DYNAMIC_STATE_SCISSOR)) {
+        auto& sc = info.scissor;
+        add(std::bit_cast<uint32_t>(sc.offset.x));
+        add(std::bit_cast<uint32_t>(sc.offset.y));
+        add(sc.extent.width);
+        add(sc.extent.height);
+    }
+
+    auto& rs = info.rasterizer;
+    add(rs.depthClampEnable);
+    add(rs.rasterizerDiscardEnable);
+    add(rs.polygonMode);
+    add(rs.cullMode);
+    add(rs.frontFace);
+    add(rs.depthBiasEnable);
+    add(float_bits(rs.depthBiasConstantFactor));
+    add(float_bits(rs.depthBiasClamp));
+    add(float_bits(rs.depthBiasSlopeFactor));
+    add(float_bits(rs.lineWidth));
+
+    auto& ms = info.multisampling;
+    add(ms.rasterizationSamples);
+    add(ms.sampleShadingEnable);
+    add(float_bits(ms.minSampleShading));
+    add(ms.alphaToCoverageEnable);
+    add(ms.alphaToOneEnable);
+
+    auto& ds = info.depth_stencil;
+    add(ds.depthTestEnable);
+    add(ds.depthWriteEnable);
+    add(ds.depthCompareOp);
+    add(ds.depthBoundsTestEnable);
+    add(ds.stencilTestEnable);
+    for (auto& op : {ds.front, ds.back}) {
+        add(op.failOp);
+        add(op.passOp);
+        add(op.depthFailOp);
+        add(op.compareOp);
+        add(op.compareMask);
+        add(op.writeMask);
+        add(op.reference);
+    }
+    add(float_bits(ds.minDepthBounds));
+    add(float_bits(ds.maxDepthBounds));
+
+    add(info.blend_attachments.size());
+    for (auto& ba : info.blend_attachments) {
+        add(ba.blendEnable);
+        add(ba.srcColorBlendFactor);
+        add(ba.dstColorBlendFactor);
+        add(ba.colorBlendOp);
+        add(ba.srcAlphaBlendFactor);
+        add(ba.dstAlphaBlendFactor);
+        add(ba.alphaBlendOp);
+        add(ba.colorWriteMask);
+    }
+    add(info.blend_state.logicOpEnable);
+    add(info.blend_state.logicOp);
+    for (auto c : info.blend_state.blendConstants)
+        add(float_bits(c));
+
+    add(info.dynamic_states.size());
+    for (auto state : info.dynamic_states)
+        add(state);
+
+    add(handle_bits(info.render_pass));
+    add(info.subpass);
+
+    add(set_layouts.size());
+    for (auto layout : set_layouts)
+        add(handle_bits(layout));
+    add(push_ranges.size());
+    for (auto& range : push_ranges) {
+        add(range.stageFlags);
+        add(range.offset);
+        add(range.size);
+    }
+
+    for (auto w : words)
+        hash_combine(hash, w);
+}
+
+bool PipelineKey::operator==(const PipelineKey& other) const {
+    return hash == other.hash && words == other.words;
+}
+
+PipelineRegistry::PipelineRegistry()
+    : builder([](VkDevice device, const PipelineBuildInfo& info, VkPipelineCache c) {
+        return info.build(device, c);
+    })
+    , destroyer([](VkDevice device, VkPipeline pipeline, VkPipelineLayout layout) {
+        if (pipeline != VK_NULL_HANDLE)
+            vkDestroyPipeline(device, pipeline, nullptr);
+        if (layout != VK_NULL_HANDLE)
+            vkDestroyPipelineLayout(device, layout, nullptr);
+    })
+{}
+
+PipelineRegistry::PipelineRegistry(Builder b, Destroyer d)
+    : builder(std::move(b))
+    , destroyer(std::move(d))
+{}
+
+PipelineRegistry::Entry* PipelineRegistry::find(const PipelineKey& key) {
+    auto found = entries.find(key);
+    if (found == entries.end())
+        return nullptr;
+    ++hits;
+    return &found->second;
+}
+
+PipelineRegistry::Entry* PipelineRegistry::add(VkDevice device, PipelineKey&& key,
+    PipelineBuildInfo&& info, const bool lazy)
+{
+    auto [it, inserted] = entries.try_emplace(std::move(key));
+    auto& entry = it->second;
+    if (!inserted)
+        return &entry;
+
+    entry.layout = info.layout;
+    if (lazy) {
+        entry.build = ThreadPool::instance().enqueue([device, c = cache, b = builder,
+            info = std::move(info)]() {
+            return b(device, info, c);
+        }).share();
+        return &entry;
+    }
+
+    entry.pipeline = builder(device, info, cache);
+    entry.state = entry.pipeline != VK_NULL_HANDLE ? State::ready : State::failed;
+    return &entry;
+}
+
+bool PipelineRegistry::poll(Entry& entry, const bool block) {
+    if (entry.state != State::pending)
+        return false;
+    if (!entry.build.valid())
+        return false;
+    if (!block && entry.build.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return false;
+
+    entry.pipeline = entry.build.get();
+    entry.state = entry.pipeline != VK_NULL_HANDLE ? State::ready : State::failed;
+    entry.build = {};
+    return true;
+}
+
+void PipelineRegistry::wait_all() {
+    for (auto& [key, entry] : entries)
+        poll(entry, true);
+}
+
+std::function<void()> PipelineRegistry::release(VkDevice device, Entry& entry) {
+    if (entry.refs > 0 && --entry.refs > 0)
+        return {};
+
+    auto found = std::find_if(entries.begin(), entries.end(), [&](auto& e) {
+        return &e.second == &entry;
+    });
+    if (found == entries.end())
+        return {};
+
+    poll(entry, true);
+    auto pipeline = entry.pipeline;
+    auto layout = entry.layout;
+    entries.erase(found);
+    return [device, d = destroyer, pipeline, layout]() {
+        d(device, pipeline, layout);
+    };
+}
+
+void PipelineRegistry::destroy(VkDevice device) {
+    wait_all();
+    for (auto& [key, entry] : entries)
+        destroyer(device, entry.pipeline, entry.layout);
+    entries.clear();
+    hits = 0;
+
+    if (cache != VK_NULL_HANDLE)
+        vkDestroyPipelineCache(device, cache, nullptr);
+    cache = VK_NULL_HANDLE;
+}
+
+void PipelineRegistry::create_cache(VkDevice device, const VkPhysicalDeviceProperties& props,
+    const std::vector<char>& data)
+{
+    VkPipelineCacheCreateInfo cache_info{};
+    cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    if (cache_data_compatible(data, props)) {
+        cache_info.initialDataSize = data.size();
+        cache_info.pInitialData = data.data();
+    }
+
+    if (vkCreatePipelineCache(device, &cache_info, nullptr, &cache) != VK_SUCCESS)
+        throw std::runtime_error("failed to create pipeline cache");
+}
+
+std::vector<char> PipelineRegistry::get_cache_data(VkDevice device) const {
+    if (cache == VK_NULL_HANDLE)
+        return {};
+
+    size_t size = 0;
+    if (vkGetPipelineCacheData(device, cache, &size, nullptr) != VK_SUCCESS)
+        return {};
+    std::vector<char> data(size);
+    if (vkGetPipelineCacheData(device, cache, &size, data.data()) != VK_SUCCESS)
+        return {};
+    data.resize(size);
+    return data;
+}
+
+bool PipelineRegistry::cache_data_compatible(const std::vector<char>& data,
+    const VkPhysicalDeviceProperties& props)
+{
+    // VkPipelineCacheHeaderVersionOne
+    struct {
+        uint32_t                            header_size;
+        uint32_t                            header_version;
+        uint32_t                            vendor_id;
+        uint32_t                            device_id;
+        uint8_t                             uuid[VK_UUID_SIZE];
+    } header;
+    if (data.size() < sizeof(header))
+        return false;
+
+    std::memcpy(&header, data.data(), sizeof(header));
+    return header.header_size >= sizeof(header) &&
+        header.header_version == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+        header.vendor_id == props.vendorID && header.device_id == props.deviceID &&
+        std::memcmp(header.uuid, props.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+std::shared_future<VkPipeline> PipelineRegistry::get_build(const Entry& entry) {
+    if (entry.state == State::pending && entry.build.valid())
+        return entry.build;
+
+    std::promise<VkPipeline> done;
+    done.set_value(entry.pipeline);
+    return done.get_future().share();
+}
+
+}
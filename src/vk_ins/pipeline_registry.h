@@ -0,0 +1,221 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace vkkk
+{
+
+/************************************************************
+ * Everything vkCreateGraphicsPipelines reads, held by value
+ * so the create info can be put back together on any thread
+ * after the PipelineOption and modules it came from are gone.
+ * Pointers inside the state structs are ignored, build()
+ * points them at the members here.
+ ************************************************************/
+
+struct PipelineBuildInfo {
+    std::vector<std::pair<VkShaderStageFlagBits, std::vector<uint32_t>>>
+                                            stages;
+    // Map entries and data per stage, parallel to stages. Missing or empty
+    // ones keep the defaults compiled into the SPIR-V
+    std::vector<std::pair<std::vector<VkSpecializationMapEntry>, std::vector<char>>>
+                                            specializations;
+    std::vector<VkVertexInputBindingDescription>
+                                            input_bindings;
+    std::vector<VkVertexInputAttributeDescription>
+                                            input_attrs;
+    VkPipelineInputAssemblyStateCreateInfo  input_assembly{};
+    VkViewport                              viewport{};
+    VkRect2D                                scissor{};
+    VkPipelineRasterizationStateCreateInfo  rasterizer{};
+    VkPipelineMultisampleStateCreateInfo    multisampling{};
+    VkPipelineDepthStencilStateCreateInfo   depth_stencil{};
+    std::vector<VkPipelineColorBlendAttachmentState>
+                                            blend_attachments;
+    VkPipelineColorBlendStateCreateInfo     blend_state{};
+    std::vector<VkDynamicState>             dynamic_states;
+    VkPipelineLayout                        layout = VK_NULL_HANDLE;
+    VkRenderPass                            render_pass = VK_NULL_HANDLE;
+    uint32_t                                subpass = 0;
+
+    inline bool is_dynamic(const VkDynamicState state) const {
+        for (auto s : dynamic_states)
+            if (s == state)
+                return true;
+        return false;
+    }
+
+    // Shader modules only live for the call, VK_NULL_HANDLE on failure.
+    // Safe to call from worker threads, cache may be VK_NULL_HANDLE
+    VkPipeline build(VkDevice device, VkPipelineCache cache) const;
+};
+
+/************************************************************
+ * Identity of a pipeline: SPIR-V and specialization of every
+ * stage, the fixed function state, vertex layout, render
+ * pass and the layout shape (set layouts from the cache plus
+ * push ranges). Two create_pipeline calls agreeing on all of
+ * it get the same VkPipeline whatever name they use.
+ * Viewport and scissor only count when they aren't dynamic.
+ * The SPIR-V words are kept so equality is exact, a hash
+ * collision can't hand out the wrong pipeline.
+ ************************************************************/
+
+struct PipelineKey {
+    PipelineKey(const PipelineBuildInfo& info, const std::vector<VkDescriptorSetLayout>& set_layouts,
+        const std::vector<VkPushConstantRange>& push_ranges);
+
+    bool operator==(const PipelineKey& other) const;
+
+    std::vector<uint64_t>                   words;
+    size_t                                  hash = 0;
+};
+
+/************************************************************
+ * What create_pipeline_async hands back. The build runs on a
+ * worker, the pipeline itself is only swapped in by the
+ * instance's poll, so ready() going true means the next
+ * frame picks it up rather than that get_pipeline returns it
+ * right now.
+ ************************************************************/
+
+class PipelineHandle {
+public:
+    PipelineHandle() = default;
+    PipelineHandle(const std::string& n, std::shared_future<VkPipeline> b)
+        : name(n), build(std::move(b)) {}
+
+    // False when the request got refused before anything was queued
+    inline bool valid() const {
+        return build.valid();
+    }
+
+    inline bool ready() const {
+        return valid() && build.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    // Blocks until the build is done, false when it failed
+    inline bool wait() const {
+        return valid() && build.get() != VK_NULL_HANDLE;
+    }
+
+    inline const std::string& get_name() const {
+        return name;
+    }
+
+private:
+    std::string                             name;
+    std::shared_future<VkPipeline>          build;
+};
+
+/************************************************************
+ * Owns a pipeline and its layout per distinct key. Entries
+ * added lazily compile on the shared thread pool and sit in
+ * the pending state until poll() sees the build finish,
+ * which only ever happens on the thread calling poll() so
+ * readers of the entry need no locking. Every build goes
+ * through one VkPipelineCache, it is internally synchronized
+ * so workers share it as is.
+ ************************************************************/
+
+class PipelineRegistry {
+public:
+    // How entries get built and torn down, builders run on workers for
+    // lazy adds. The defaults call into the driver
+    using Builder = std::function<VkPipeline(VkDevice, const PipelineBuildInfo&, VkPipelineCache)>;
+    using Destroyer = std::function<void(VkDevice, VkPipeline, VkPipelineLayout)>;
+
+    enum class State {
+        pending,
+        ready,
+        failed
+    };
+
+    struct Entry {
+        VkPipeline                          pipeline = VK_NULL_HANDLE;
+        VkPipelineLayout                    layout = VK_NULL_HANDLE;
+        State                               state = State::pending;
+        std::shared_future<VkPipeline>      build;
+        // Users holding on to it, see release
+        uint32_t                            refs = 0;
+    };
+
+    PipelineRegistry();
+    PipelineRegistry(Builder b, Destroyer d);
+
+    // Existing entry for key, or nullptr and the caller goes on with add
+    Entry* find(const PipelineKey& key);
+    // Takes ownership of info.layout. Builds right away unless lazy, in
+    // which case the build is queued and the entry returned pending
+    Entry* add(VkDevice device, PipelineKey&& key, PipelineBuildInfo&& info, const bool lazy);
+    // Moves a pending entry on once its build is done, true when it did.
+    // block waits for the build instead of checking. Failed entries stay,
+    // the same inputs would only fail again
+    bool poll(Entry& entry, const bool block=false);
+    // Blocks until no entry is pending, before reading the cache back
+    void wait_all();
+
+    inline void retain(Entry& entry) {
+        ++entry.refs;
+    }
+
+    // Drops a user of entry. The last one takes the entry out, waiting
+    // for its build if needed, and gets back what destroys its pipeline
+    // and layout, to run once nothing in flight uses them anymore. Empty
+    // while others still hold it
+    std::function<void()> release(VkDevice device, Entry& entry);
+
+    // Waits for queued builds, then destroys everything
+    void destroy(VkDevice device);
+
+    // Seeded with data from an earlier run, dropped when it came from
+    // another device or driver. Throws when creation fails
+    void create_cache(VkDevice device, const VkPhysicalDeviceProperties& props,
+        const std::vector<char>& data={});
+    std::vector<char> get_cache_data(VkDevice device) const;
+    // Header check, vendor, device and pipelineCacheUUID have to match
+    static bool cache_data_compatible(const std::vector<char>& data,
+        const VkPhysicalDeviceProperties& props);
+
+    // Future of the build for pending entries, an already fulfilled one
+    // otherwise
+    static std::shared_future<VkPipeline> get_build(const Entry& entry);
+
+    inline VkPipelineCache get_cache() const {
+        return cache;
+    }
+
+    inline size_t size() const {
+        return entries.size();
+    }
+
+    inline uint32_t get_hits() const {
+        return hits;
+    }
+
+private:
+    struct KeyHash {
+        inline size_t operator()(const PipelineKey& key) const {
+            return key.hash;
+        }
+    };
+
+    // Node based, entry pointers stay valid until the entry is removed
+    std::unordered_map<PipelineKey, Entry, KeyHash>
+                                            entries;
+    uint32_t                                hits = 0;
+    VkPipelineCache                         cache = VK_NULL_HANDLE;
+    Builder                                 builder;
+    Destroyer                               destroyer;
+};
+
+}
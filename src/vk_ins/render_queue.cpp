@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <numeric>
+#include <type_traits>
+
+#include "utils/radix_sort.h"
+#include "vk_ins/render_queue.h"
+#include "vk_ins/vkabstraction.h"
+
+namespace vkkk
+{
+
+// Non-dispatchable handles are pointers on 64 bit platforms and plain
+// integers elsewhere
+template <typename H>
+static inline uint64_t handle_bits(H h) {
+    if constexpr (std::is_pointer_v<H>)
+        return reinterpret_cast<uintptr_t>(h);
+    else
+        return static_cast<uint64_t>(h);
+}
+
+uint64_t RenderQueue::make_key(const uint32_t pass, const uint32_t pipeline,
+    const uint32_t desc_set, const uint32_t geometry, const uint32_t mesh,
+    const float depth)
+{
+    const uint64_t d = static_cast<uint64_t>(std::clamp(depth, 0.f, 1.f) * ((1 << 20) - 1));
+    return (static_cast<uint64_t>(pass & 0xF) << 60)
+        | (static_cast<uint64_t>(pipeline & 0x3FF) << 50)
+        | (static_cast<uint64_t>(desc_set & 0xFFF) << 38)
+        | (static_cast<uint64_t>(geometry & 0xFF) << 30)
+        | (static_cast<uint64_t>(mesh & 0x3FF) << 20)
+        | d;
+}
+
+uint32_t RenderQueue::intern(std::unordered_map<uint64_t, uint32_t>& ids,
+    const uint64_t handle, const uint32_t bits)
+{
+    auto found = ids.find(handle);
+    if (found != ids.end())
+        return found->second;
+
+    uint32_t id = ids.size() & ((1u << bits) - 1);
+    ids.emplace(handle, id);
+    return id;
+}
+
+void RenderQueue::push(const uint32_t pass, VkPipeline pipeline, VkPipelineLayout ppl_layout,
+    VkDescriptorSet desc_set, const MeshGPU* mesh, const float depth,
+    const uint32_t first_instance)
+{
+    auto key = make_key(pass,
+        intern(pipeline_ids, handle_bits(pipeline), 10),
+        intern(desc_ids, handle_bits(desc_set), 12),
+        intern(geometry_ids, handle_bits(mesh->vbuf), 8),
+        intern(mesh_ids, handle_bits(mesh), 10),
+        depth);
+
+    keys.push_back(key);
+    order.push_back(items.size());
+    items.emplace_back(DrawItem{
+        .pipeline = pipeline,
+        .ppl_layout = ppl_layout,
+        .desc_set = desc_set,
+        .mesh = mesh,
+        .first_instance = first_instance
+    });
+}
+
+void RenderQueue::sort() {
+    // Keys stay in submission order so sort() can be called again
+    sorted_keys = keys;
+    std::iota(order.begin(), order.end(), 0);
+    radix_sort(sorted_keys, order);
+}
+
+RenderStats RenderQueue::traverse(const std::vector<uint32_t>& seq,
+    VkCommandBuffer cmd_buf) const
+{
+    RenderStats stats{};
+    VkPipeline bound_ppl = VK_NULL_HANDLE;
+    VkDescriptorSet bound_set = VK_NULL_HANDLE;
+    VkBuffer bound_vbuf = VK_NULL_HANDLE;
+    VkBuffer bound_ibuf = VK_NULL_HANDLE;
+    VkIndexType bound_type = VK_INDEX_TYPE_MAX_ENUM;
+
+    for (auto idx : seq) {
+        const auto& item = items[idx];
+        if (item.pipeline == VK_NULL_HANDLE) {
+            ++stats.skipped;
+            continue;
+        }
+
+        if (item.pipeline != bound_ppl) {
+            if (cmd_buf != VK_NULL_HANDLE)
+                vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, item.pipeline);
+            bound_ppl = item.pipeline;
+            // Sets stay valid across compatible layouts, but we don't
+            // track compatibility so just rebind
+            bound_set = VK_NULL_HANDLE;
+            ++stats.pipeline_binds;
+        }
+
+        if (item.desc_set != VK_NULL_HANDLE && item.desc_set != bound_set) {
+            if (cmd_buf != VK_NULL_HANDLE) {
+                vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, item.ppl_layout,
+                    0, 1, &item.desc_set, 0, nullptr);
+            }
+            bound_set = item.desc_set;
+            ++stats.descriptor_binds;
+        }
+
+        const auto mesh = item.mesh;
+        if (mesh->vbuf != bound_vbuf || mesh->ibuf != bound_ibuf || mesh->index_type != bound_type) {
+            if (cmd_buf != VK_NULL_HANDLE)
+                mesh->emit_bind_cmd(cmd_buf);
+            bound_vbuf = mesh->vbuf;
+            bound_ibuf = mesh->ibuf;
+            bound_type = mesh->index_type;
+            ++stats.vertex_binds;
+        }
+
+        if (cmd_buf != VK_NULL_HANDLE)
+            mesh->emit_draw_only_cmd(cmd_buf, item.first_instance);
+        ++stats.draws;
+    }
+
+    return stats;
+}
+
+RenderStats RenderQueue::flush(VkCommandBuffer cmd_buf) const {
+    return traverse(order, cmd_buf);
+}
+
+RenderStats RenderQueue::count_unsorted() const {
+    std::vector<uint32_t> seq(items.size());
+    std::iota(seq.begin(), seq.end(), 0);
+    return traverse(seq, VK_NULL_HANDLE);
+}
+
+RenderStats RenderQueue::count_sorted() const {
+    return traverse(order, VK_NULL_HANDLE);
+}
+
+}
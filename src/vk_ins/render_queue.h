@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace vkkk
+{
+
+struct MeshGPU;
+
+/************************************************************
+ * Sort key layout, most significant first:
+ *   pass       4 bits
+ *   pipeline  10 bits
+ *   desc set  12 bits
+ *   geometry   8 bits (vertex buffer, pooled meshes share it)
+ *   mesh      10 bits
+ *   depth     20 bits
+ * Ids are handed out in order of first use and wrap when a
+ * field overflows, that only costs some extra binds.
+ ************************************************************/
+
+struct RenderStats {
+    uint32_t                                draws = 0;
+    uint32_t                                pipeline_binds = 0;
+    uint32_t                                descriptor_binds = 0;
+    uint32_t                                vertex_binds = 0;
+    // Draws left out because their pipeline was still being built
+    uint32_t                                skipped = 0;
+};
+
+class RenderQueue {
+public:
+    struct DrawItem {
+        VkPipeline                          pipeline;
+        VkPipelineLayout                    ppl_layout;
+        VkDescriptorSet                     desc_set;
+        const MeshGPU*                      mesh;
+        uint32_t                            first_instance;
+    };
+
+    // Depth is expected in [0, 1], pass 1 - depth for back to front. A
+    // VK_NULL_HANDLE pipeline, e.g. from get_pipeline while the build and
+    // its fallback are pending, gets the draw skipped at flush
+    void push(const uint32_t pass, VkPipeline pipeline, VkPipelineLayout ppl_layout,
+        VkDescriptorSet desc_set, const MeshGPU* mesh, const float depth,
+        const uint32_t first_instance=0);
+
+    void sort();
+    // Records the queued draws into cmd_buf, binds are only emitted when
+    // the state actually changes. Call sort() first
+    RenderStats flush(VkCommandBuffer cmd_buf) const;
+
+    // State changes the queue would need in submission order vs sorted,
+    // without recording anything
+    RenderStats count_unsorted() const;
+    RenderStats count_sorted() const;
+
+    inline void clear() {
+        keys.clear();
+        sorted_keys.clear();
+        order.clear();
+        items.clear();
+    }
+
+    inline size_t size() const {
+        return items.size();
+    }
+
+    inline const DrawItem& get_sorted(const size_t i) const {
+        return items[order[i]];
+    }
+
+    static uint64_t make_key(const uint32_t pass, const uint32_t pipeline,
+        const uint32_t desc_set, const uint32_t geometry, const uint32_t mesh,
+        const float depth);
+
+private:
+    uint32_t intern(std::unordered_map<uint64_t, uint32_t>& ids, const uint64_t handle,
+        const uint32_t bits);
+    RenderStats traverse(const std::vector<uint32_t>& seq, VkCommandBuffer cmd_buf) const;
+
+    std::vector<uint64_t>                   keys;
+    std::vector<uint64_t>                   sorted_keys;
+    std::vector<uint32_t>                   order;
+    std::vector<DrawItem>                   items;
+
+    // Kept across frames so keys stay stable
+    std::unordered_map<uint64_t, uint32_t>  pipeline_ids;
+    std::unordered_map<uint64_t, uint32_t>  desc_ids;
+    std::unordered_map<uint64_t, uint32_t>  geometry_ids;
+    std::unordered_map<uint64_t, uint32_t>  mesh_ids;
+};
+
+}
@@ -0,0 +1,90 @@
+#include <bit>
+#include <stdexcept>
+
+#include "vk_ins/sampler.h"
+
+namespace vkkk
+{
+
+static inline void hash_combine(size_t& seed, const uint64_t v) {
+    seed ^= std::hash<uint64_t>{}(v) + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+}
+
+SamplerKey::SamplerKey(const VkSamplerCreateInfo& in)
+    : info(in)
+{
+    info.pNext = nullptr;
+    hash_combine(hash, info.flags);
+    hash_combine(hash, info.magFilter);
+    hash_combine(hash, info.minFilter);
+    hash_combine(hash, info.mipmapMode);
+    hash_combine(hash, info.addressModeU);
+    hash_combine(hash, info.addressModeV);
+    hash_combine(hash, info.addressModeW);
+    hash_combine(hash, std::bit_cast<uint32_t>(info.mipLodBias));
+    hash_combine(hash, info.anisotropyEnable);
+    hash_combine(hash, std::bit_cast<uint32_t>(info.maxAnisotropy));
+    hash_combine(hash, info.compareEnable);
+    hash_combine(hash, info.compareOp);
+    hash_combine(hash, std::bit_cast<uint32_t>(info.minLod));
+    hash_combine(hash, std::bit_cast<uint32_t>(info.maxLod));
+    hash_combine(hash, info.borderColor);
+    hash_combine(hash, info.unnormalizedCoordinates);
+}
+
+bool SamplerKey::operator==(const SamplerKey& other) const {
+    auto& a = info;
+    auto& b = other.info;
+    return hash == other.hash && a.flags == b.flags && a.magFilter == b.magFilter &&
+        a.minFilter == b.minFilter && a.mipmapMode == b.mipmapMode &&
+        a.addressModeU == b.addressModeU && a.addressModeV == b.addressModeV &&
+        a.addressModeW == b.addressModeW && a.mipLodBias == b.mipLodBias &&
+        a.anisotropyEnable == b.anisotropyEnable && a.maxAnisotropy == b.maxAnisotropy &&
+        a.compareEnable == b.compareEnable && a.compareOp == b.compareOp &&
+        a.minLod == b.minLod && a.maxLod == b.maxLod && a.borderColor == b.borderColor &&
+        a.unnormalizedCoordinates == b.unnormalizedCoordinates;
+}
+
+VkSamplerCreateInfo default_sampler_info() {
+    VkSamplerCreateInfo sampler_info{};
+    sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_info.magFilter = VK_FILTER_LINEAR;
+    sampler_info.minFilter = VK_FILTER_LINEAR;
+    sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    sampler_info.mipLodBias = 0.f;
+    sampler_info.compareEnable = VK_FALSE;
+    sampler_info.compareOp = VK_COMPARE_OP_ALWAYS;
+    sampler_info.minLod = 0.f;
+    sampler_info.maxLod = 0.f;
+    sampler_info.maxAnisotropy = 1.f;
+    sampler_info.anisotropyEnable = VK_FALSE;
+    sampler_info.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    sampler_info.unnormalizedCoordinates = VK_FALSE;
+    return sampler_info;
+}
+
+VkSampler SamplerCache::get(VkDevice device, const VkSamplerCreateInfo& info) {
+    SamplerKey key(info);
+    auto found = samplers.find(key);
+    if (found != samplers.end()) {
+        ++hits;
+        return found->second;
+    }
+
+    VkSampler sampler;
+    if (vkCreateSampler(device, &key.info, nullptr, &sampler) != VK_SUCCESS)
+        throw std::runtime_error("failed to create sampler");
+    samplers.emplace(std::move(key), sampler);
+    return sampler;
+}
+
+void SamplerCache::destroy(VkDevice device) {
+    for (auto& [key, sampler] : samplers)
+        vkDestroySampler(device, sampler, nullptr);
+    samplers.clear();
+}
+
+}
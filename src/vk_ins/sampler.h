@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+
+#include <vulkan/vulkan.h>
+
+namespace vkkk
+{
+
+/************************************************************
+ * Samplers are shared by every texture asking for the same
+ * parameters, so their count stays far below
+ * maxSamplerAllocationCount and a handle stays the same
+ * across textures, which is what lets layouts bake it in as
+ * an immutable sampler.
+ * pNext chains aren't part of the key and must be null.
+ ************************************************************/
+
+struct SamplerKey {
+    SamplerKey(const VkSamplerCreateInfo& info);
+
+    bool operator==(const SamplerKey& other) const;
+
+    VkSamplerCreateInfo                         info;
+    size_t                                      hash = 0;
+};
+
+// Linear filtering with repeat, what textures loaded from files use
+VkSamplerCreateInfo default_sampler_info();
+
+class SamplerCache {
+public:
+    // Existing sampler created with the same parameters or a new one,
+    // throws when creation fails. Owned by the cache
+    VkSampler get(VkDevice device, const VkSamplerCreateInfo& info);
+    void destroy(VkDevice device);
+
+    inline size_t size() const {
+        return samplers.size();
+    }
+
+    inline uint32_t get_hits() const {
+        return hits;
+    }
+
+private:
+    struct KeyHash {
+        inline size_t operator()(const SamplerKey& key) const {
+            return key.hash;
+        }
+    };
+
+    std::unordered_map<SamplerKey, VkSampler, KeyHash>
+                                                samplers;
+    uint32_t                                    hits = 0;
+};
+
+}
@@ -0,0 +1,40 @@
+#include "vk_ins/shader_include.h"
+
+namespace vkkk
+{
+
+std::vector<fs::path>& default_shader_include_dirs() {
+#ifdef VKKK_SHADER_INCLUDE_DIR
+    static std::vector<fs::path> dirs{VKKK_SHADER_INCLUDE_DIR};
+#else
+    static std::vector<fs::path> dirs;
+#endif
+    return dirs;
+}
+
+std::optional<fs::path> resolve_shader_include(const std::string& requested,
+    const fs::path& requesting, const bool relative, const std::vector<fs::path>& dirs)
+{
+    auto try_path = [](const fs::path& p) -> std::optional<fs::path> {
+        std::error_code ec;
+        if (!fs::is_regular_file(p, ec))
+            return std::nullopt;
+        return fs::weakly_canonical(p, ec);
+    };
+
+    fs::path req(requested);
+    if (req.is_absolute())
+        return try_path(req);
+
+    if (relative) {
+        if (auto found = try_path(requesting.parent_path() / req))
+            return found;
+    }
+
+    for (auto& dir : dirs)
+        if (auto found = try_path(dir / req))
+            return found;
+    return std::nullopt;
+}
+
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace vkkk
+{
+
+// Searched by every shader after its own include dirs. Starts out with the
+// source tree when the build defines VKKK_SHADER_INCLUDE_DIR, that's where
+// shared headers like concepts/lights.h live
+std::vector<fs::path>& default_shader_include_dirs();
+
+// File an #include resolves to, canonical. Quoted includes look next to
+// the including file first, then through dirs in order like angled ones
+std::optional<fs::path> resolve_shader_include(const std::string& requested,
+    const fs::path& requesting, const bool relative, const std::vector<fs::path>& dirs);
+
+}
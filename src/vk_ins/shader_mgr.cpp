@@ -1,8 +1,14 @@
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+
 #include <fmt/format.h>
 #include <shaderc/shaderc.hpp>
 
 #include "utils/io.h"
+#include "utils/macros.h"
 #include "vk_ins/vkabstraction.h"
+#include "vk_ins/shader_include.h"
 #include "vk_ins/shader_mgr.h"
 #include "vk_ins/misc.h"
 
@@ -189,107 +195,128 @@ void ShaderModulesDeprecated::create_descriptor_layouts() {
     for (auto& tex : uniform_mgr->textures)
         setup_binding(tex, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
     
-    // Create descriptor set layout
-    VkDescriptorSetLayoutCreateInfo layout_info{};
-    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layout_info.bindingCount = m_descriptor_layout_bindings.size();
-    layout_info.pBindings = m_descriptor_layout_bindings.data();
-
-    if (vkCreateDescriptorSetLayout(device, &layout_info, nullptr, &m_descriptor_layout) != VK_SUCCESS)
-        throw std::runtime_error("failed to create descriptor set layout");
+    // Shared through the instance's cache, identical modules end up with
+    // one layout
+    m_descriptor_layout = instance->layout_cache.get(device, m_descriptor_layout_bindings);
 }
 
 void ShaderModulesDeprecated::create_descriptor_pool() {
-    // Create the descriptor set layout
-    auto swapchain_img_cnt = instance->get_swapchain_cnt();
-
-    if (uniform_mgr->ubos.size() > 0)
-        setup_pool(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-            uniform_mgr->ubos.size() * instance->get_swapchain_cnt());
-    if (uniform_mgr->textures.size() > 0)
-        setup_pool(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            uniform_mgr->textures.size() * instance->get_swapchain_cnt());
-
-    // Create the pool
-    VkDescriptorPoolCreateInfo pool_info{};
-    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    pool_info.poolSizeCount = m_pool_sizes.size();
-    pool_info.pPoolSizes = m_pool_sizes.data();
-    pool_info.maxSets = swapchain_img_cnt;
-
-    if (vkCreateDescriptorPool(device, &pool_info, nullptr, &m_descriptor_pool) != VK_SUCCESS)
-        throw std::runtime_error("failed to create descriptor pool..");
+    // Sets come from the instance's pool pages now, kept so existing
+    // callers don't need to change
 }
 
 void ShaderModulesDeprecated::create_descriptor_set() {
-    auto swapchain_img_cnt = instance->get_swapchain_cnt();
-    m_descriptor_sets.resize(swapchain_img_cnt);
-
-    // Create descriptor sets
-    std::vector<VkDescriptorSetLayout> layouts(swapchain_img_cnt, m_descriptor_layout);
-    VkDescriptorSetAllocateInfo alloc_info{};
-    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    alloc_info.descriptorPool = m_descriptor_pool;
-    alloc_info.descriptorSetCount = swapchain_img_cnt;
-    alloc_info.pSetLayouts = layouts.data();
-    
-    if (vkAllocateDescriptorSets(device, &alloc_info, m_descriptor_sets.data()) != VK_SUCCESS)
-        throw std::runtime_error("failed to allocate descriptor sets");
-
-    // Update it
-    for (int i = 0; i < swapchain_img_cnt; i++) {
-        auto writes = std::vector<VkWriteDescriptorSet>(uniform_mgr->ubos.size() +
-            uniform_mgr->textures.size());
-        for (int j = 0; auto& [ubo_name, ubo] : uniform_mgr->ubos) {
+    auto frame_cnt = instance->get_frames_in_flight();
+    m_descriptor_sets.resize(frame_cnt);
+
+    // Modules bound to the same uniforms share their sets
+    for (int i = 0; i < frame_cnt; i++) {
+        std::vector<DescriptorBinding> bindings;
+        bindings.reserve(uniform_mgr->ubos.size() + uniform_mgr->textures.size());
+        for (auto& [ubo_name, ubo] : uniform_mgr->ubos) {
             ubo.update_descriptor();
-            
-            auto& write = writes[j++];
-            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            write.dstSet = m_descriptor_sets[i];
-            write.dstBinding = ubo.binding;
-            write.dstArrayElement = 0;
-            write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            write.descriptorCount = 1;
-            write.pBufferInfo = &ubo.descriptors[i];
+            bindings.push_back(DescriptorBinding{
+                .binding = ubo.binding,
+                .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                .buffer = ubo.descriptors[i]
+            });
         }
-        for (int j = 0; auto& tex : uniform_mgr->textures) {
-            auto& write = writes[uniform_mgr->ubos.size() + j];
-            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            write.dstSet = m_descriptor_sets[i];
-            write.dstBinding = tex.binding;
-            write.dstArrayElement = 0;
-            write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            write.descriptorCount = 1;
-            write.pImageInfo = &tex.descriptor;
-            j++;
+        for (auto& tex : uniform_mgr->textures) {
+            bindings.push_back(DescriptorBinding{
+                .binding = tex.binding,
+                .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .image = tex.descriptor
+            });
         }
 
-        vkUpdateDescriptorSets(instance->get_device(), writes.size(), writes.data(), 0, nullptr);
+        m_descriptor_sets[i] = instance->set_cache.get(device, instance->descriptor_allocator,
+            m_descriptor_layout, bindings);
     }
 }
 
-void ShaderModulesDeprecated::setup_pool(const VkDescriptorType des_type, const uint32_t cnt) {
-    VkDescriptorPoolSize pool_size{};
-    pool_size.type = des_type;
-    pool_size.descriptorCount = cnt;
-    m_pool_sizes.emplace_back(std::move(pool_size));
+// Resolves #include for shaderc and notes every file it hands out, one
+// per compile
+class ShaderIncluder : public shaderc::CompileOptions::IncluderInterface {
+public:
+    ShaderIncluder(std::vector<fs::path> d, std::set<fs::path>& deps)
+        : dirs(std::move(d))
+        , dependencies(deps)
+    {}
+
+    shaderc_include_result* GetInclude(const char* requested_source, shaderc_include_type type,
+        const char* requesting_source, size_t include_depth) override
+    {
+        auto include = new Include;
+        auto path = resolve_shader_include(requested_source, requesting_source,
+            type == shaderc_include_type_relative, dirs);
+        if (path.has_value()) {
+            auto content = load_file(*path);
+            include->name = path->string();
+            include->content.assign(content.begin(), content.end());
+            dependencies.insert(*path);
+        }
+        else {
+            // An empty name is how shaderc learns the include failed, the
+            // content ends up in the error message
+            include->content = fmt::format("cannot find {} included from {}",
+                requested_source, requesting_source);
+        }
+
+        include->result = shaderc_include_result{
+            .source_name = include->name.c_str(),
+            .source_name_length = include->name.size(),
+            .content = include->content.c_str(),
+            .content_length = include->content.size(),
+            .user_data = include
+        };
+        return &include->result;
+    }
+
+    void ReleaseInclude(shaderc_include_result* data) override {
+        delete static_cast<Include*>(data->user_data);
+    }
+
+private:
+    struct Include {
+        std::string                                 name;
+        std::string                                 content;
+        shaderc_include_result                      result;
+    };
+
+    std::vector<fs::path>                           dirs;
+    std::set<fs::path>&                             dependencies;
+};
+
+// Modules load on workers during hot reload
+static std::mutex build_stats_mtx;
+static std::map<ShaderOptimization, ShaderBuildStats> build_stats_per_level;
+
+ShaderBuildStats shader_build_stats(const ShaderOptimization level) {
+    std::lock_guard lock(build_stats_mtx);
+    auto found = build_stats_per_level.find(level);
+    return found == build_stats_per_level.end() ? ShaderBuildStats{} : found->second;
 }
 
-bool ShaderModule::load(const fs::path& path, const VkShaderStageFlagBits t) {
+bool ShaderModule::load(const fs::path& p, const VkShaderStageFlagBits t) {
     type = t;
 
-    auto abs_path = ensure_abs_path(path);
+    auto abs_path = ensure_abs_path(p);
+    path = abs_path;
+    dependencies.clear();
+    build_stats = ShaderBuildStats{};
     auto extension = abs_path.extension();
+    // What reflection reads, spirv_code may be optimized with names gone
+    std::vector<uint32_t> reflect_code;
 
     if (extension.string().ends_with(".spv")) {
-        // Compiled SPRIV
+        // Compiled SPRIV, shipped as is
         spirv_code = load_spirv_file(abs_path);
+        reflect_code = spirv_code;
     }
     else {
         source_code = load_file(abs_path);
 
         shaderc::Compiler compiler;
-        shaderc::CompileOptions options;
 
         // Make it a static map to lookup?
         shaderc_shader_kind tt;
@@ -331,33 +358,81 @@ bool ShaderModule::load(const fs::path& path, const VkShaderStageFlagBits t) {
             }
         }
 
-        // Default to performance first
-        //options.SetOptimizationLevel(shaderc_optimization_level_performance);
-        //options.SetOptimizationLevel(shaderc_optimization_level_size);
-
-        // entry point default to "main"
-        shaderc::SpvCompilationResult ret =
-            compiler.CompileGlslToSpv(source_code.data(), source_code.size(),
-                tt, abs_path.filename().string().c_str(), options);
-        
-        if (ret.GetCompilationStatus() != shaderc_compilation_status_success) {
-            std::cout << ret.GetErrorMessage();
+        auto dirs = include_dirs;
+        auto& default_dirs = default_shader_include_dirs();
+        dirs.insert(dirs.end(), default_dirs.begin(), default_dirs.end());
+
+        // Timed in ms, empty code when it doesn't compile
+        auto compile = [&](const ShaderOptimization level, double& ms) {
+            auto start = std::chrono::steady_clock::now();
+            shaderc::CompileOptions options;
+            for (auto& [macro, value] : defines)
+                options.AddMacroDefinition(macro, value);
+            options.SetIncluder(std::make_unique<ShaderIncluder>(dirs, dependencies));
+            // shaderc strips debug info whenever it optimizes
+            if (level == ShaderOptimization::performance)
+                options.SetOptimizationLevel(shaderc_optimization_level_performance);
+            else if (level == ShaderOptimization::size)
+                options.SetOptimizationLevel(shaderc_optimization_level_size);
+
+            // entry point default to "main"
+            shaderc::SpvCompilationResult ret =
+                compiler.CompileGlslToSpv(source_code.data(), source_code.size(),
+                    tt, abs_path.string().c_str(), options);
+            std::chrono::duration<double, std::milli> elapsed =
+                std::chrono::steady_clock::now() - start;
+            ms = elapsed.count();
+
+            if (ret.GetCompilationStatus() != shaderc_compilation_status_success) {
+                std::cout << ret.GetErrorMessage();
+                return std::vector<uint32_t>{};
+            }
+            return std::vector<uint32_t>(ret.cbegin(), ret.cend());
+        };
+
+        // Reflection looks resources up by name, it always gets an
+        // unoptimized compile
+        reflect_code = compile(ShaderOptimization::none, build_stats.reflect_ms);
+        if (reflect_code.empty())
             return false;
+
+        if (optimization == ShaderOptimization::none) {
+            spirv_code = reflect_code;
+        }
+        else {
+            spirv_code = compile(optimization, build_stats.optimize_ms);
+            // An optimizer failure isn't worth losing the shader over
+            if (spirv_code.empty()) {
+                std::cout << "Optimizing " << abs_path << " failed, using it unoptimized"
+                    << std::endl;
+                spirv_code = reflect_code;
+            }
         }
 
-        // Limited to the implementation of shaderc
-        //auto spv_size = (ret.cend() - ret.cbegin()) * sizeof(uint32_t);
-        //spirv_code.resize(spv_size);
-        //memcpy(spirv_code.data(), ret.cbegin(), spv_size);
-        spirv_code.insert(spirv_code.begin(), ret.cbegin(), ret.cend());
+        build_stats.module_cnt = 1;
+        build_stats.reflect_size = reflect_code.size() * sizeof(uint32_t);
+        build_stats.spirv_size = spirv_code.size() * sizeof(uint32_t);
+        std::lock_guard lock(build_stats_mtx);
+        build_stats_per_level[optimization].record(build_stats);
     }
 
     // Collecting uniform&attribute infos
-    spirv_cross::CompilerGLSL comp(spirv_code);
+    spirv_cross::CompilerGLSL comp(std::move(reflect_code));
     auto res = comp.get_shader_resources();
 
+    // The bindless heap isn't created per pipeline, only note that the
+    // shader wants it
+    auto in_heap = [&](auto& resource) {
+        if (comp.get_decoration(resource.id, spv::DecorationDescriptorSet) != BINDLESS_SET)
+            return false;
+        uses_bindless = true;
+        return true;
+    };
+
     // UBOs
     for (auto& ubo : res.uniform_buffers) {
+        if (in_heap(ubo))
+            continue;
         auto name = comp.get_name(ubo.id);
         auto type_info = comp.get_type(ubo.type_id);
         auto base_type_info = comp.get_type(ubo.base_type_id);
@@ -368,8 +443,42 @@ bool ShaderModule::load(const fs::path& path, const VkShaderStageFlagBits t) {
         buf_infos.emplace(name, std::make_tuple(struct_size, array_size, binding_idx));
     }
 
+    // SSBOs
+    for (auto& ssbo : res.storage_buffers) {
+        if (in_heap(ssbo))
+            continue;
+        auto name = comp.get_name(ssbo.id);
+        auto type_info = comp.get_type(ssbo.type_id);
+        auto base_type_info = comp.get_type(ssbo.base_type_id);
+        auto binding_idx = comp.get_decoration(ssbo.id, spv::DecorationBinding);
+        auto struct_size = comp.get_declared_struct_size(base_type_info);
+        auto array_size = type_info.array.size() > 0 ? type_info.array[0] : 1;
+        storage_infos.emplace(name, std::make_tuple(struct_size, array_size, binding_idx));
+    }
+
+    // Push constants, members may start past 0 with layout (offset = N)
+    for (auto& block : res.push_constant_buffers) {
+        auto name = comp.get_name(block.id);
+        auto& base_type_info = comp.get_type(block.base_type_id);
+        uint32_t struct_size = comp.get_declared_struct_size(base_type_info);
+        uint32_t offset = base_type_info.member_types.empty() ? 0 :
+            comp.type_struct_member_offset(base_type_info, 0);
+        push_infos.emplace(name, std::make_tuple(offset, struct_size - offset));
+    }
+
+    // Specialization constants, Vulkan passes bools as VkBool32
+    for (auto& spec : comp.get_specialization_constants()) {
+        auto& constant = comp.get_constant(spec.id);
+        auto& type_info = comp.get_type(constant.constant_type);
+        uint32_t size = type_info.basetype == spirv_cross::SPIRType::Boolean ?
+            sizeof(VkBool32) : type_info.width / 8;
+        spec_infos.emplace(comp.get_name(spec.id), std::make_tuple(spec.constant_id, size));
+    }
+
     // Textures
     for (auto& img : res.sampled_images) {
+        if (in_heap(img))
+            continue;
         auto binding_idx = comp.get_decoration(img.id, spv::DecorationBinding);
         img_infos.emplace(img.name, binding_idx);
     }
@@ -387,4 +496,88 @@ bool ShaderModule::load(const fs::path& path, const VkShaderStageFlagBits t) {
     return true;
 }
 
-}
\ No newline at end of file
+std::optional<ShaderModule> ShaderModule::recompile() const {
+    ShaderModule mod;
+    mod.defines = defines;
+    mod.include_dirs = include_dirs;
+    mod.optimization = optimization;
+    mod.spec_values = spec_values;
+    mod.tex_img_pairs = tex_img_pairs;
+    mod.input_brefs = input_brefs;
+    // Editors may leave the file half written, reflection throws on that
+    try {
+        if (path.empty() || !mod.load(path, type))
+            return std::nullopt;
+    }
+    catch (const std::exception& e) {
+        std::cout << "Reloading " << path << " failed: " << e.what() << std::endl;
+        return std::nullopt;
+    }
+    return mod;
+}
+
+void ShaderModule::set_specialization(const VkSpecializationInfo& info) {
+    auto data = static_cast<const char*>(info.pData);
+    for (uint32_t i = 0; i < info.mapEntryCount; ++i) {
+        auto& entry = info.pMapEntries[i];
+        spec_values[entry.constantID].assign(data + entry.offset, data + entry.offset + entry.size);
+    }
+}
+
+Specialization ShaderModule::get_specialization() const {
+    Specialization spec;
+    auto& [entries, data] = spec;
+    for (auto& [id, value] : spec_values) {
+        auto found = std::find_if(spec_infos.begin(), spec_infos.end(), [id = id](auto& info) {
+            return std::get<0>(info.second) == id;
+        });
+        if (found == spec_infos.end() || std::get<1>(found->second) != value.size())
+            continue;
+
+        entries.push_back(VkSpecializationMapEntry{
+            .constantID = id,
+            .offset = static_cast<uint32_t>(data.size()),
+            .size = value.size()
+        });
+        data.insert(data.end(), value.begin(), value.end());
+    }
+    return spec;
+}
+
+std::vector<VkPushConstantRange> collect_push_ranges(const std::vector<ShaderModule>& modules) {
+    std::vector<VkPushConstantRange> ranges;
+    for (auto& mod : modules) {
+        for (auto& [block_name, info] : mod.push_infos) {
+            auto& [offset, size] = info;
+            if (size == 0)
+                continue;
+
+            auto found = std::find_if(ranges.begin(), ranges.end(), [&](auto& r) {
+                return r.offset == offset && r.size == size;
+            });
+            if (found != ranges.end())
+                found->stageFlags |= mod.type;
+            else
+                ranges.push_back({static_cast<VkShaderStageFlags>(mod.type), offset, size});
+        }
+    }
+    return ranges;
+}
+
+VkShaderStageFlags push_stages(const std::vector<VkPushConstantRange>& ranges,
+    const uint32_t offset, const uint32_t size)
+{
+    VkShaderStageFlags stages = 0;
+    for (auto& r : ranges)
+        if (offset < r.offset + r.size && r.offset < offset + size)
+            stages |= r.stageFlags;
+
+    VkShaderStageFlags covered = 0;
+    for (auto& r : ranges)
+        if (r.offset <= offset && offset + size <= r.offset + r.size)
+            covered |= r.stageFlags;
+
+    return (stages & ~covered) == 0 ? stages : 0;
+}
+
+}
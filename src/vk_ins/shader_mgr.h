@@ -1,11 +1,15 @@
 #pragma once
 
+#include <cstring>
 #include <filesystem>
 #include <iostream>
 #include <map>
+#include <optional>
+#include <set>
 #include <vector>
 #include <utility>
 #include <tuple>
+#include <type_traits>
 
 #include <vulkan/vulkan.h>
 #include <spirv_cross/spirv.hpp>
@@ -32,6 +36,39 @@ using AttrInfoWithLoc = std::tuple<std::string, VkShaderStageFlagBits,
     GLSLTYPE>;
 using AttrInfoMap = std::unordered_map<uint32_t, std::tuple<std::string, uint32_t>>;
 using TexImgPairs = std::unordered_map<std::string, std::pair<std::string, bool>>;
+using PushInfoMap = std::unordered_map<std::string, std::tuple<uint32_t, uint32_t>>;
+using SpecInfoMap = std::unordered_map<std::string, std::tuple<uint32_t, uint32_t>>;
+using Specialization = std::pair<std::vector<VkSpecializationMapEntry>, std::vector<char>>;
+
+// shaderc optimization levels, both optimizing ones strip names
+enum class ShaderOptimization {
+    none,
+    performance,
+    size
+};
+
+// Cost of compiling GLSL, per module or summed up per level. Sizes are in
+// bytes and times in ms
+struct ShaderBuildStats {
+    uint32_t                                        module_cnt = 0;
+    // Unoptimized compile with names intact, what reflection reads
+    size_t                                          reflect_size = 0;
+    double                                          reflect_ms = 0.;
+    // What pipelines get, the unoptimized code again at none
+    size_t                                          spirv_size = 0;
+    double                                          optimize_ms = 0.;
+
+    inline void record(const ShaderBuildStats& stats) {
+        module_cnt += stats.module_cnt;
+        reflect_size += stats.reflect_size;
+        reflect_ms += stats.reflect_ms;
+        spirv_size += stats.spirv_size;
+        optimize_ms += stats.optimize_ms;
+    }
+};
+
+// Every GLSL module loaded at level so far, safe while workers compile
+ShaderBuildStats shader_build_stats(const ShaderOptimization level);
 
 class ShaderModulesDeprecated {
 public:
@@ -90,9 +127,6 @@ public:
         return &m_descriptor_layout;
     }
 
-private:
-    void setup_pool(const VkDescriptorType des_type, const uint32_t cnt);
-    
 private:
     VkWrappedInstance*                              instance;
     VkDevice                                        device;
@@ -107,7 +141,6 @@ private:
 
     VkDescriptorSetLayout                           m_descriptor_layout;
     std::vector<VkDescriptorSetLayoutBinding>       m_descriptor_layout_bindings;
-    VkDescriptorPool                                m_descriptor_pool;
     std::vector<VkDescriptorSet>                    m_descriptor_sets;
     std::unordered_map<VkShaderStageFlagBits, spirv_cross::ShaderResources> shader_resources_map;
 
@@ -122,9 +155,6 @@ private:
     std::map<uint32_t, std::vector<uint32_t>>       m_input_brefs;
     std::map<uint32_t, AttrInfoWithLoc>             m_attr_brefs;
     TexImgPairs                                     m_tex_img_pairs;
-
-    std::vector<VkWriteDescriptorSet>               m_writes;
-    std::vector<VkDescriptorPoolSize>               m_pool_sizes;
 };
 
 class ShaderModule {
@@ -134,14 +164,81 @@ public:
     std::vector<uint32_t>                           spirv_code;
     //std::vector<BufInfoWithBinding>                 m_buf_brefs;
     BufInfoMap                                      buf_infos;
+    // Storage buffers, struct size excludes a trailing runtime array
+    BufInfoMap                                      storage_infos;
     //std::vector<ImgInfoWithBinding>                 m_img_brefs;
     ImgInfoMap                                      img_infos;
     std::map<uint32_t, std::vector<uint32_t>>       input_brefs;
     //std::map<uint32_t, AttrInfoWithLoc>             m_attr_brefs;
     AttrInfoMap                                     attr_infos;
     TexImgPairs                                     tex_img_pairs;
+    // Push constant blocks, name -> offset of the first member and size
+    // from there, GLSL allows one block per stage
+    PushInfoMap                                     push_infos;
+    // Specialization constants, name -> constant_id and size in bytes,
+    // bools take a VkBool32
+    SpecInfoMap                                     spec_infos;
+    // constant_id -> value the pipeline is built with, constants without
+    // one keep the default compiled into the SPIR-V
+    std::map<uint32_t, std::vector<char>>           spec_values;
+    // Declares resources at set BINDLESS_SET, left out of the infos above
+    bool                                            uses_bindless = false;
+    // Defined when compiling GLSL, e.g. BINDLESS_FALLBACK
+    std::unordered_map<std::string, std::string>    defines;
+    // Searched for #include before default_shader_include_dirs()
+    std::vector<fs::path>                           include_dirs;
+    // Applied to GLSL, precompiled SPIR-V is used as is. Reflection reads
+    // an unoptimized compile so the name keyed infos above stay intact
+    ShaderOptimization                              optimization = ShaderOptimization::performance;
+    // Set by load, all zero for precompiled SPIR-V
+    ShaderBuildStats                                build_stats;
+    // Absolute, set by load
+    fs::path                                        path;
+    // Every file pulled in through #include, nested ones included. Set by
+    // load, empty for precompiled SPIR-V
+    std::set<fs::path>                              dependencies;
 
     bool load(const fs::path& path, const VkShaderStageFlagBits t);
+    // Loads path again into a fresh module with the same stage, defines,
+    // include dirs, optimization, specialization, texture assignments and
+    // attribute bindings. Empty when it doesn't compile, this one is left
+    // untouched either way
+    std::optional<ShaderModule> recompile() const;
+
+    // Variants of one SPIR-V module without compiling it again, e.g. a
+    // loop bound the driver can unroll. False when the shader has no such
+    // constant or its size differs from T
+    template <typename T>
+    bool set_spec_constant(const std::string& name, const T value) {
+        static_assert(std::is_arithmetic_v<T>);
+        using V = std::conditional_t<std::is_same_v<T, bool>, VkBool32, T>;
+        V v = static_cast<V>(value);
+
+        auto found = spec_infos.find(name);
+        if (found == spec_infos.end()) {
+            std::cout << "No specialization constant " << name << " found.." << std::endl;
+            return false;
+        }
+        auto [id, size] = found->second;
+        if (size != sizeof(V)) {
+            std::cout << "Specialization constant " << name << " takes " << size
+                << " bytes" << std::endl;
+            return false;
+        }
+
+        auto& bytes = spec_values[id];
+        bytes.resize(sizeof(V));
+        std::memcpy(bytes.data(), &v, sizeof(V));
+        return true;
+    }
+
+    // Takes the values as they'd be handed to Vulkan, by constant_id
+    void set_specialization(const VkSpecializationInfo& info);
+
+    // Map entries and data for VkSpecializationInfo, sorted by constant_id.
+    // Values for constants the shader doesn't declare, or declares with
+    // another size, are left out
+    Specialization get_specialization() const;
     
     std::tuple<std::string, uint32_t, uint32_t, uint32_t>
         get_uniform_info(const std::string& name) const
@@ -157,4 +254,14 @@ public:
     }
 };
 
+// Push constant ranges for a pipeline built from modules, stages declaring
+// the same offset and size share one range
+std::vector<VkPushConstantRange> collect_push_ranges(const std::vector<ShaderModule>& modules);
+
+// Stage flags vkCmdPushConstants needs for [offset, offset + size), every
+// stage of a range overlapping it. 0 when one of those stages has no range
+// covering all of it, the update would be invalid
+VkShaderStageFlags push_stages(const std::vector<VkPushConstantRange>& ranges,
+    const uint32_t offset, const uint32_t size);
+
 }
\ No newline at end of file
@@ -12,11 +12,11 @@ namespace vkkk
 UniformMgr::UniformMgr(VkWrappedInstance* ins)
     : instance(ins)
     , graphic_queue(ins->get_graphic_queue())
-    , swapchain_image_cnt(ins->get_swapchain_cnt())
+    , frame_cnt(ins->get_frames_in_flight())
 {
     device = ins->get_device();
-    //uniform_bufs.resize(swapchain_image_cnt);
-    //uniform_buf_mems.resize(swapchain_image_cnt);
+    //uniform_bufs.resize(frame_cnt);
+    //uniform_buf_mems.resize(frame_cnt);
 }
 
 UniformMgr::UniformMgr(UniformMgr&& rhs)
@@ -26,7 +26,7 @@ UniformMgr::UniformMgr(UniformMgr&& rhs)
     , mem_props(rhs.mem_props)
     , command_pool(rhs.command_pool)
     , graphic_queue(rhs.graphic_queue)
-    , swapchain_image_cnt(rhs.swapchain_image_cnt)
+    , frame_cnt(rhs.frame_cnt)
     , ubos(std::move(rhs.ubos))
     , textures(std::move(rhs.textures))
     , writes(std::move(rhs.writes))
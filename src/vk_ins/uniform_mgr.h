@@ -53,7 +53,7 @@ protected:
     VkPhysicalDeviceMemoryProperties        mem_props;
     VkCommandPool                           command_pool;
     VkQueue                                 graphic_queue;
-    uint32_t                                swapchain_image_cnt;
+    uint32_t                                frame_cnt;
 
 public:
     std::unordered_map<std::string, UBODeprecated>    ubos;
@@ -6,6 +6,7 @@
 #include <set>
 #include <stdexcept>
 
+#include <fmt/format.h>
 #include <OpenImageIO/imagebuf.h>
 #include <OpenImageIO/imagebufalgo.h>
 
@@ -13,7 +14,10 @@
 //#include <stb_image.h>
 
 #include "utils/io.h"
+#include "utils/simd.h"
+#include "utils/thread_pool.h"
 #include "concepts/camera.h"
+#include "concepts/frustum.h"
 #include "vk_ins/vkabstraction.h"
 
 namespace fs = std::filesystem;
@@ -21,7 +25,33 @@ namespace fs = std::filesystem;
 namespace vkkk
 {
 
-inline constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+PipelineOption::PipelineOption(const PipelineOption& other) {
+    *this = other;
+}
+
+PipelineOption& PipelineOption::operator=(const PipelineOption& other) {
+    input_info = other.input_info;
+    input_assembly = other.input_assembly;
+    viewport = other.viewport;
+    vp_state_info = other.vp_state_info;
+    scissor = other.scissor;
+    rasterizer = other.rasterizer;
+    multisampling = other.multisampling;
+    depth_stencil = other.depth_stencil;
+    blend_attachment = other.blend_attachment;
+    blend_state = other.blend_state;
+    immutable_samplers = other.immutable_samplers;
+    dynamic_states = other.dynamic_states;
+
+    // Pointers into other would dangle once it's gone
+    if (other.vp_state_info.pViewports == &other.viewport)
+        vp_state_info.pViewports = &viewport;
+    if (other.vp_state_info.pScissors == &other.scissor)
+        vp_state_info.pScissors = &scissor;
+    if (other.blend_state.pAttachments == &other.blend_attachment)
+        blend_state.pAttachments = &blend_attachment;
+    return *this;
+}
 
 PipelineOption::PipelineOption() {
     input_info = VkPipelineVertexInputStateCreateInfo {
@@ -107,23 +137,135 @@ void MeshGPU::sync(const Mesh& mesh, VkWrappedInstance* ins) {
         throw std::runtime_error("cannot sync unloaded mesh");
 
     ins->create_vertex_buffer(mesh.vbuf, vbuf, vbuf_memo, mesh.comp_size, mesh.vcnt);
+    vcnt = mesh.vcnt;
     // Mesh index count stores triangles; convert to uint32 index count.
-    ins->create_index_buffer(mesh.ibuf, ibuf, ibuf_memo, mesh.icnt * 3);
+    ins->create_index_buffer(mesh.ibuf, ibuf, ibuf_memo, mesh.icnt * 3, mesh.index_type);
     icnt = mesh.icnt;
+    index_type = mesh.index_type;
+
+    if (!mesh.meshlets.empty())
+        sync_meshlets(mesh, ins);
 }
 
-void MeshGPU::emit_draw_cmd(VkCommandBuffer cmd_buf, VkPipelineLayout ppl_layout,
-    const VkDescriptorSet* desc_set) const
+void MeshGPU::sync_meshlets(const Mesh& mesh, VkWrappedInstance* ins) {
+    if (mesh.meshlets.empty())
+        throw std::runtime_error("mesh has no meshlets, call build_meshlets first");
+
+    meshlets = mesh.meshlets;
+    VkDeviceSize bounds_size = sizeof(Meshlet) * meshlets.size();
+    ins->create_device_local_buffer(meshlets.data(), bounds_size,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, meshlet_buf, meshlet_memo);
+
+    std::vector<VkDrawIndexedIndirectCommand> cmds(meshlets.size());
+    for (int i = 0; i < meshlets.size(); ++i) {
+        cmds[i] = VkDrawIndexedIndirectCommand {
+            .indexCount = meshlets[i].triangle_count * 3,
+            .instanceCount = 1,
+            .firstIndex = first_index + meshlets[i].triangle_offset * 3,
+            .vertexOffset = vertex_offset,
+            .firstInstance = 0
+        };
+    }
+
+    // Host visible so culling can rewrite instance counts without
+    // re-recording the command buffers
+    VkDeviceSize cmds_size = sizeof(VkDrawIndexedIndirectCommand) * cmds.size();
+    auto cnt = ins->get_frames_in_flight();
+    indirect_bufs.resize(cnt);
+    indirect_memos.resize(cnt);
+    for (int i = 0; i < cnt; ++i) {
+        ins->create_buffer(cmds_size, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            indirect_bufs[i], indirect_memos[i]);
+        ins->sync_uniform(indirect_memos[i], cmds.data(), cmds_size);
+    }
+
+    if (ins->get_enabled_features().multiDrawIndirect)
+        max_draw_cnt = std::max(1u, ins->get_physical_device_props().limits.maxDrawIndirectCount);
+    else
+        max_draw_cnt = 1;
+}
+
+uint32_t MeshGPU::cull_meshlets(const uint32_t idx, const glm::mat4& model, const Camera& cam,
+    VkWrappedInstance* ins) const
 {
+    if (idx >= indirect_memos.size())
+        throw std::runtime_error(fmt::format("invalid swapchain index {} for meshlet culling", idx));
+
+    // Test in object space so the meshlet bounds can stay untouched
+    auto frustum = Frustum::from_matrix(cam.get_proj_mat() * cam.get_view_mat() * model);
+    glm::vec3 eye = glm::inverse(model) * glm::vec4(cam.pos, 1.f);
+
+    std::vector<VkDrawIndexedIndirectCommand> cmds(meshlets.size());
+    uint32_t visible = 0;
+    for (int i = 0; i < meshlets.size(); ++i) {
+        const auto& m = meshlets[i];
+        glm::vec3 center = m.sphere;
+        bool vis = frustum.intersect_sphere(center, m.sphere.w);
+        if (vis && m.cone.w < 1.f) {
+            auto d = center - eye;
+            vis = glm::dot(d, glm::vec3(m.cone)) < m.cone.w * glm::length(d) + m.sphere.w;
+        }
+
+        cmds[i] = VkDrawIndexedIndirectCommand {
+            .indexCount = m.triangle_count * 3,
+            .instanceCount = vis ? 1u : 0u,
+            .firstIndex = first_index + m.triangle_offset * 3,
+            .vertexOffset = vertex_offset,
+            .firstInstance = 0
+        };
+        visible += vis;
+    }
+
+    ins->sync_uniform(indirect_memos[idx], cmds.data(),
+        sizeof(VkDrawIndexedIndirectCommand) * cmds.size());
+    return visible;
+}
+
+void MeshGPU::emit_bind_cmd(VkCommandBuffer cmd_buf) const {
     VkBuffer bufs[] = {vbuf};
     VkDeviceSize offsets[] = {0};
     vkCmdBindVertexBuffers(cmd_buf, 0, 1, bufs, offsets);
+    vkCmdBindIndexBuffer(cmd_buf, ibuf, 0, index_type);
+}
+
+void MeshGPU::emit_draw_only_cmd(VkCommandBuffer cmd_buf, const uint32_t first_instance) const {
+    vkCmdDrawIndexed(cmd_buf, icnt * 3, 1, first_index, vertex_offset, first_instance);
+}
+
+void MeshGPU::emit_draw_cmd(VkCommandBuffer cmd_buf, VkPipelineLayout ppl_layout,
+    const VkDescriptorSet* desc_set) const
+{
+    emit_bind_cmd(cmd_buf);
     if (desc_set != nullptr) {
         vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, ppl_layout,
             0, 1, desc_set, 0, nullptr);
     }
-    vkCmdBindIndexBuffer(cmd_buf, ibuf, 0, VK_INDEX_TYPE_UINT32);
-    vkCmdDrawIndexed(cmd_buf, icnt * 3, 1, 0, 0, 0);
+    emit_draw_only_cmd(cmd_buf);
+}
+
+void MeshGPU::emit_meshlet_draw_cmd(VkCommandBuffer cmd_buf, const uint32_t idx,
+    VkPipelineLayout ppl_layout, const VkDescriptorSet* desc_set) const
+{
+    if (indirect_bufs.empty()) {
+        emit_draw_cmd(cmd_buf, ppl_layout, desc_set);
+        return;
+    }
+
+    emit_bind_cmd(cmd_buf);
+    if (desc_set != nullptr) {
+        vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, ppl_layout,
+            0, 1, desc_set, 0, nullptr);
+    }
+
+    // Without multiDrawIndirect max_draw_cnt is 1 and this degrades into
+    // one indirect draw per meshlet
+    constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+    uint32_t total = meshlets.size();
+    for (uint32_t first = 0; first < total; first += max_draw_cnt) {
+        uint32_t cnt = std::min(max_draw_cnt, total - first);
+        vkCmdDrawIndexedIndirect(cmd_buf, indirect_bufs[idx], first * stride, cnt, stride);
+    }
 }
 
 VkWrappedInstance::VkWrappedInstance()
@@ -138,14 +280,22 @@ VkWrappedInstance::VkWrappedInstance(uint32_t w, uint32_t h, const std::string&
 {}
 
 VkWrappedInstance::~VkWrappedInstance() {
+    // Background builds read the render pass and add to the pipeline
+    // cache, both have to outlive them
+    pipeline_registry.wait_all();
+    if (queue_created)
+        vkDeviceWaitIdle(device);
+    // Queues its resources for deletion like any other call of it
+    destroy_shadow_targets();
+    deletion_queue.flush_all();
     cleanup_swapchain();
 
     if (syncobj_created) {
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-            vkDestroySemaphore(device, render_finished_semaphores[i], nullptr);
-            vkDestroySemaphore(device, image_available_semaphores[i], nullptr);
-            vkDestroyFence(device, in_flight_fences[i], nullptr);
-        }
+        for (auto semaphore : render_finished_semaphores)
+            vkDestroySemaphore(device, semaphore, nullptr);
+        for (auto semaphore : image_available_semaphores)
+            vkDestroySemaphore(device, semaphore, nullptr);
+        frame_scheduler.destroy(device);
     }
 
     for (auto& [name, ubo] : ubos) {
@@ -155,18 +305,27 @@ VkWrappedInstance::~VkWrappedInstance() {
         }
     }
 
+    for (auto& [name, ssbo] : ssbos) {
+        for (int i = 0; i < ssbo.gpu_bufs.size(); ++i) {
+            vkDestroyBuffer(device, ssbo.gpu_bufs[i], nullptr);
+            vkFreeMemory(device, ssbo.memos[i], nullptr);
+        }
+    }
+
     for (auto& [name, tex] : textures) {
-        vkDestroySampler(device, tex.sampler, nullptr);
         vkDestroyImageView(device, tex.view, nullptr);
         vkDestroyImage(device, tex.image, nullptr);
         vkFreeMemory(device, tex.memo, nullptr);
     }
 
-    for (auto& [name, mesh] : meshes) {
-        vkDestroyBuffer(device, mesh.vbuf, nullptr);
-        vkFreeMemory(device, mesh.vbuf_memo, nullptr);
-        vkDestroyBuffer(device, mesh.ibuf, nullptr);
-        vkFreeMemory(device, mesh.ibuf_memo, nullptr);
+    for (auto& [name, mesh] : meshes)
+        destroy_mesh_gpu(mesh);
+
+    for (auto& [key, pool] : geometry_pools) {
+        vkDestroyBuffer(device, pool.vbuf, nullptr);
+        vkFreeMemory(device, pool.vbuf_memo, nullptr);
+        vkDestroyBuffer(device, pool.ibuf, nullptr);
+        vkFreeMemory(device, pool.ibuf_memo, nullptr);
     }
 
     for (auto& [name, rt] : render_targets) {
@@ -185,6 +344,14 @@ VkWrappedInstance::~VkWrappedInstance() {
             vkDestroyFramebuffer(device, fb, nullptr);
     }
 
+    bindless.destroy(device);
+    descriptor_allocator.destroy(device);
+    if (queue_created && !pipeline_cache_path.empty())
+        save_pipeline_cache();
+    pipeline_registry.destroy(device);
+    layout_cache.destroy(device);
+    sampler_cache.destroy(device);
+
     vkDestroyDevice(device, nullptr);
 
     if (enable_validation_layers) {
@@ -416,6 +583,13 @@ void VkWrappedInstance::transition_image_layout(VkImage image, VkFormat format,
         src_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
         dst_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
     }
+    else if (old_layout == VK_IMAGE_LAYOUT_UNDEFINED && new_layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL) {
+        // Shadow maps, their render pass expects to find them this way
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+        src_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        dst_stage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    }
     else {
         throw std::invalid_argument("unsupported layout transition!");
     }
@@ -556,8 +730,20 @@ void VkWrappedInstance::create_logical_device() {
     }
 
     // Device feature
+    VkPhysicalDeviceFeatures supported_features;
+    vkGetPhysicalDeviceFeatures(physical_device, &supported_features);
     VkPhysicalDeviceFeatures device_features{};
     device_features.samplerAnisotropy = VK_TRUE;
+    // Optional, meshlet draws fall back to one indirect draw per cluster
+    device_features.multiDrawIndirect = supported_features.multiDrawIndirect;
+    // Optional, shadow casters in front of a cascade get clipped without it
+    device_features.depthClamp = supported_features.depthClamp;
+    // The bindless heap is indexed with slots read from memory, no heap
+    // without these
+    device_features.shaderSampledImageArrayDynamicIndexing =
+        supported_features.shaderSampledImageArrayDynamicIndexing;
+    device_features.shaderStorageBufferArrayDynamicIndexing =
+        supported_features.shaderStorageBufferArrayDynamicIndexing;
 
     // Device create info
     VkDeviceCreateInfo device_create_info{};
@@ -567,6 +753,92 @@ void VkWrappedInstance::create_logical_device() {
     device_create_info.pEnabledFeatures = &device_features;
 
     auto default_device_extensions = get_default_device_extensions();
+
+    // Optional, the bindless heap shrinks to small fully written arrays
+    // without it
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexing_features{};
+    indexing_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    const char* indexing_extensions[] = { VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME };
+    descriptor_indexing = false;
+    if (check_device_extension_support(indexing_extensions)) {
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT supported{};
+        supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+        VkPhysicalDeviceFeatures2 features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &supported;
+        vkGetPhysicalDeviceFeatures2(physical_device, &features2);
+
+        if (supported.runtimeDescriptorArray &&
+            supported.descriptorBindingPartiallyBound &&
+            supported.descriptorBindingUpdateUnusedWhilePending &&
+            supported.descriptorBindingSampledImageUpdateAfterBind &&
+            supported.descriptorBindingStorageBufferUpdateAfterBind &&
+            supported.shaderSampledImageArrayNonUniformIndexing)
+        {
+            indexing_features.runtimeDescriptorArray = VK_TRUE;
+            indexing_features.descriptorBindingPartiallyBound = VK_TRUE;
+            indexing_features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+            indexing_features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+            indexing_features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+            indexing_features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+            indexing_features.shaderStorageBufferArrayNonUniformIndexing =
+                supported.shaderStorageBufferArrayNonUniformIndexing;
+            device_create_info.pNext = &indexing_features;
+            default_device_extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+            descriptor_indexing = true;
+
+            indexing_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+            VkPhysicalDeviceProperties2 props2{};
+            props2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+            props2.pNext = &indexing_props;
+            vkGetPhysicalDeviceProperties2(physical_device, &props2);
+        }
+    }
+
+    // Optional, frames are paced with one fence per slot without it
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline_features{};
+    timeline_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+    const char* timeline_extensions[] = { VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME };
+    timeline_semaphore = false;
+    if (check_device_extension_support(timeline_extensions)) {
+        VkPhysicalDeviceTimelineSemaphoreFeaturesKHR supported{};
+        supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+        VkPhysicalDeviceFeatures2 features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &supported;
+        vkGetPhysicalDeviceFeatures2(physical_device, &features2);
+
+        if (supported.timelineSemaphore) {
+            timeline_features.timelineSemaphore = VK_TRUE;
+            timeline_features.pNext = const_cast<void*>(device_create_info.pNext);
+            device_create_info.pNext = &timeline_features;
+            default_device_extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+            timeline_semaphore = true;
+        }
+    }
+
+    // Optional, pipelines bake cull and depth state in without it
+    VkPhysicalDeviceExtendedDynamicStateFeaturesEXT dynamic_features{};
+    dynamic_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+    const char* dynamic_extensions[] = { VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME };
+    extended_dynamic_state = false;
+    if (check_device_extension_support(dynamic_extensions)) {
+        VkPhysicalDeviceExtendedDynamicStateFeaturesEXT supported{};
+        supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+        VkPhysicalDeviceFeatures2 features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &supported;
+        vkGetPhysicalDeviceFeatures2(physical_device, &features2);
+
+        if (supported.extendedDynamicState) {
+            dynamic_features.extendedDynamicState = VK_TRUE;
+            dynamic_features.pNext = const_cast<void*>(device_create_info.pNext);
+            device_create_info.pNext = &dynamic_features;
+            default_device_extensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+            extended_dynamic_state = true;
+        }
+    }
+
     device_create_info.enabledExtensionCount = static_cast<uint32_t>(default_device_extensions.size());
     device_create_info.ppEnabledExtensionNames = default_device_extensions.data();
 
@@ -582,6 +854,18 @@ void VkWrappedInstance::create_logical_device() {
     // Create logical device
     if (vkCreateDevice(physical_device, &device_create_info, nullptr, &device) != VK_SUCCESS)
         throw std::runtime_error("failed to create logical device!");
+    enabled_features = device_features;
+    if (extended_dynamic_state)
+        dynamic_state_cmds.load(device);
+
+    // Shared by every pipeline build, seeded from the last run if any
+    std::vector<char> cache_data;
+    if (!pipeline_cache_path.empty() && fs::exists(pipeline_cache_path))
+        cache_data = load_file(pipeline_cache_path);
+    if (!cache_data.empty() && !PipelineRegistry::cache_data_compatible(cache_data, physical_device_props))
+        std::cout << "Pipeline cache " << pipeline_cache_path << " is from another device or driver, "
+            "starting empty" << std::endl;
+    pipeline_registry.create_cache(device, physical_device_props, cache_data);
 
     // Retrieve queue
     vkGetDeviceQueue(device, queue_family_idx.graphic_family.value(), 0, &graphic_queue);
@@ -595,13 +879,19 @@ uint32_t VkWrappedInstance::create_swapchain() {
     if (!queue_created)
         throw std::runtime_error("Queue not created yet, cannot create swapchain");
 
+    // The extent follows the window, stale capabilities would keep the
+    // size from before a resize
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical_device, surface, &swapchain_details.capabilities);
+
     swapchain_surface_format = choose_swap_surface_format(swapchain_details.formats);
-    VkPresentModeKHR present_mode = choose_swap_present_mode(swapchain_details.present_modes);
+    present_mode = choose_swap_present_mode(swapchain_details.present_modes);
     swapchain_extent = choose_swap_extent(swapchain_details.capabilities);
 
-    uint32_t image_cnt = swapchain_details.capabilities.minImageCount + 1;
-    if (swapchain_details.capabilities.maxImageCount > 0 && image_cnt > swapchain_details.capabilities.maxImageCount)
-        image_cnt = swapchain_details.capabilities.maxImageCount;
+    auto& caps = swapchain_details.capabilities;
+    uint32_t image_cnt = preferred_image_cnt == 0 ? caps.minImageCount + 1 :
+        std::max(preferred_image_cnt, caps.minImageCount);
+    if (caps.maxImageCount > 0 && image_cnt > caps.maxImageCount)
+        image_cnt = caps.maxImageCount;
 
     VkSwapchainCreateInfoKHR create_info{};
     create_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
@@ -627,7 +917,9 @@ uint32_t VkWrappedInstance::create_swapchain() {
     create_info.presentMode = present_mode;
     create_info.clipped = VK_TRUE;
 
-    create_info.oldSwapchain = VK_NULL_HANDLE;
+    // Null on first creation, otherwise the one recreate_swapchain
+    // retires, which lets the driver hand its resources over
+    create_info.oldSwapchain = swapchain;
 
     if (vkCreateSwapchainKHR(device, &create_info, nullptr, &swapchain) != VK_SUCCESS)
         throw std::runtime_error("failed to create swap chain");
@@ -676,25 +968,50 @@ void VkWrappedInstance::cleanup_swapchain() {
 }
 
 void VkWrappedInstance::recreate_swapchain() {
-    int width = 0, height = 0;
-    glfwGetFramebufferSize(window, &width, &height);
-    while (width == 0 || height == 0) {
-        glfwGetFramebufferSize(window, &width, &height);
+    int w = 0, h = 0;
+    glfwGetFramebufferSize(window, &w, &h);
+    while (w == 0 || h == 0) {
+        glfwGetFramebufferSize(window, &w, &h);
         glfwWaitEvents();
     }
 
-    vkDeviceWaitIdle(device);
-
-    cleanup_swapchain();
+    // Only what depends on the size is rebuilt, the render pass, command
+    // pool and pipelines stay. Frames in flight may still use the old
+    // attachments, they go once those frames are done instead of waiting
+    // for the device to go idle
+    auto old_format = swapchain_surface_format.format;
+    auto old_swapchain = swapchain;
+    auto old_views = std::move(swapchain_imageviews);
+    auto old_fbs = std::move(swapchain_framebuffers);
+    std::array<VkImage, 2> old_imgs{color_img, depth_img};
+    std::array<VkImageView, 2> old_img_views{color_img_view, depth_img_view};
+    std::array<VkDeviceMemory, 2> old_memos{color_img_memo, depth_img_memo};
+    defer_delete([=, this] {
+        for (auto fb : old_fbs)
+            vkDestroyFramebuffer(device, fb, nullptr);
+        for (int i = 0; i < 2; ++i) {
+            vkDestroyImageView(device, old_img_views[i], nullptr);
+            vkDestroyImage(device, old_imgs[i], nullptr);
+            vkFreeMemory(device, old_memos[i], nullptr);
+        }
+        for (auto view : old_views)
+            vkDestroyImageView(device, view, nullptr);
+        vkDestroySwapchainKHR(device, old_swapchain, nullptr);
+    });
 
     create_swapchain();
+    if (swapchain_surface_format.format != old_format)
+        std::cout << "Swapchain format changed, pipelines need the render pass recreated"
+            << std::endl;
+    width = swapchain_extent.width;
+    height = swapchain_extent.height;
     create_imageviews();
-    create_renderpass_deprecated();
     create_color_resource(swapchain_surface_format.format);
     create_depth_resource();
     create_framebuffers();
 
-    images_in_flight.resize(swapchain_images.size(), VK_NULL_HANDLE);
+    if (syncobj_created)
+        create_present_semaphores();
 }
 
 VkImageView VkWrappedInstance::create_imageview(VkImage image, VkFormat format, VkImageAspectFlags aspect_flags) {
@@ -962,6 +1279,8 @@ void VkWrappedInstance::create_command_pool() {
     VkCommandPoolCreateInfo pool_info{};
     pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     pool_info.queueFamilyIndex = queue_family_idx.graphic_family.value();
+    // Frame command buffers are recorded again every time they come around
+    pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
     if (vkCreateCommandPool(device, &pool_info, nullptr, &command_pool) != VK_SUCCESS)
         throw std::runtime_error("failed to create command pool!");
@@ -1059,8 +1378,9 @@ void VkWrappedInstance::create_vertex_buffer(const float *source_data, VkBuffer&
     vkFreeMemory(device, staging_buf_memo, nullptr);
 }
 
-void VkWrappedInstance::create_index_buffer(const uint32_t* index_data, VkBuffer& buf, VkDeviceMemory& memo, size_t idx_cnt) {
-    VkDeviceSize buf_size = sizeof(uint32_t) * idx_cnt;
+void VkWrappedInstance::create_index_buffer(const uint32_t* index_data, VkBuffer& buf, VkDeviceMemory& memo, size_t idx_cnt, VkIndexType type) {
+    const bool narrow = type == VK_INDEX_TYPE_UINT16;
+    VkDeviceSize buf_size = (narrow ? sizeof(uint16_t) : sizeof(uint32_t)) * idx_cnt;
 
     VkBuffer staging_buf;
     VkDeviceMemory staging_buf_memo;
@@ -1069,7 +1389,11 @@ void VkWrappedInstance::create_index_buffer(const uint32_t* index_data, VkBuffer
     
     void* data;
     vkMapMemory(device, staging_buf_memo, 0, buf_size, 0, &data);
-    memcpy(data, index_data, static_cast<size_t>(buf_size));
+    // Narrow straight into the staging memory, saves a temporary copy
+    if (narrow)
+        simd::narrow_u32_to_u16(index_data, static_cast<uint16_t*>(data), idx_cnt);
+    else
+        memcpy(data, index_data, static_cast<size_t>(buf_size));
     vkUnmapMemory(device, staging_buf_memo);
 
     create_buffer(buf_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
@@ -1080,6 +1404,27 @@ void VkWrappedInstance::create_index_buffer(const uint32_t* index_data, VkBuffer
     vkFreeMemory(device, staging_buf_memo, nullptr);
 }
 
+void VkWrappedInstance::create_device_local_buffer(const void* source_data, VkDeviceSize buf_size,
+    VkBufferUsageFlags usage, VkBuffer& buf, VkDeviceMemory& memo)
+{
+    VkBuffer staging_buf;
+    VkDeviceMemory staging_buf_memo;
+    create_buffer(buf_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+        | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buf, staging_buf_memo);
+
+    void* data;
+    vkMapMemory(device, staging_buf_memo, 0, buf_size, 0, &data);
+    memcpy(data, source_data, static_cast<size_t>(buf_size));
+    vkUnmapMemory(device, staging_buf_memo);
+
+    create_buffer(buf_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buf, memo);
+    copy_buffer(staging_buf, buf, buf_size);
+
+    vkDestroyBuffer(device, staging_buf, nullptr);
+    vkFreeMemory(device, staging_buf_memo, nullptr);
+}
+
 VkFormat VkWrappedInstance::find_supported_format(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
     for (VkFormat format : candidates) {
         VkFormatProperties props;
@@ -1132,68 +1477,134 @@ void VkWrappedInstance::alloc_commandbuffers(std::vector<VkCommandBuffer>& bufs)
 void VkWrappedInstance::record_cmds(std::vector<VkCommandBuffer>& cmd_bufs,
     std::vector<VkFramebuffer>& fbs, const std::function<void(uint32_t)>& emit_func)
 {
-    auto swapchain_cnt = get_swapchain_cnt();
-    assert(cmd_bufs.size() == swapchain_cnt);
-    assert(fbs.size() == swapchain_cnt);
+    assert(cmd_bufs.size() == frames_in_flight);
+    assert(fbs.size() == get_swapchain_cnt());
+
+    // Which framebuffer a frame renders to is only known after acquiring,
+    // so the actual recording happens in draw_frame
+    record_bufs = &cmd_bufs;
+    record_fbs = &fbs;
+    record_func = emit_func;
+}
 
-    for (int i = 0; i < swapchain_cnt; ++i) {
-        VkCommandBufferBeginInfo begin_info{};
-        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+void VkWrappedInstance::record_frame_cmds(const uint32_t frame, const uint32_t image_idx) {
+    auto cmd_buf = (*record_bufs)[frame];
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-        if (vkBeginCommandBuffer(cmd_bufs[i], &begin_info) != VK_SUCCESS)
-            throw std::runtime_error("failed to begin recording command buffer");
+    if (vkBeginCommandBuffer(cmd_buf, &begin_info) != VK_SUCCESS)
+        throw std::runtime_error("failed to begin recording command buffer");
 
-        VkRenderPassBeginInfo renderpass_info{};
-        renderpass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderpass_info.renderPass = render_pass;
-        renderpass_info.framebuffer = fbs[i];
-        renderpass_info.renderArea.offset = { 0, 0 };
-        renderpass_info.renderArea.extent = swapchain_extent;
+    VkRenderPassBeginInfo renderpass_info{};
+    renderpass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderpass_info.renderPass = render_pass;
+    renderpass_info.framebuffer = (*record_fbs)[image_idx];
+    renderpass_info.renderArea.offset = { 0, 0 };
+    renderpass_info.renderArea.extent = swapchain_extent;
 
-        std::array<VkClearValue, 2> clear_values{};
-        clear_values[0].color = {{ 0.f, 0.f, 0.f, 1.f }};
-        clear_values[1].depthStencil = { 1.f, 0 };
-        renderpass_info.clearValueCount = clear_values.size();
-        renderpass_info.pClearValues = clear_values.data();
+    std::array<VkClearValue, 2> clear_values{};
+    clear_values[0].color = {{ 0.f, 0.f, 0.f, 1.f }};
+    clear_values[1].depthStencil = { 1.f, 0 };
+    renderpass_info.clearValueCount = clear_values.size();
+    renderpass_info.pClearValues = clear_values.data();
 
-        vkCmdBeginRenderPass(cmd_bufs[i], &renderpass_info, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBeginRenderPass(cmd_buf, &renderpass_info, VK_SUBPASS_CONTENTS_INLINE);
 
-            emit_func(i);
+        // Pipelines from create_pipeline leave both dynamic by default,
+        // emit_func can still narrow them down
+        cmd_set_viewport(cmd_buf, swapchain_extent);
+        cmd_set_scissor(cmd_buf, swapchain_extent);
 
-        vkCmdEndRenderPass(cmd_bufs[i]);        
+        record_func(frame);
 
-        if (vkEndCommandBuffer(cmd_bufs[i]) != VK_SUCCESS)
-            throw std::runtime_error("failed to record command buffer!");
+    vkCmdEndRenderPass(cmd_buf);
+
+    if (vkEndCommandBuffer(cmd_buf) != VK_SUCCESS)
+        throw std::runtime_error("failed to record command buffer!");
+}
+
+bool VkWrappedInstance::set_frames_in_flight(const uint32_t cnt) {
+    if (cnt == 0 || cnt > MAX_FRAMES_IN_FLIGHT) {
+        std::cout << "Frames in flight must be within 1 and " << MAX_FRAMES_IN_FLIGHT
+            << ", got " << cnt << std::endl;
+        return false;
+    }
+    if (syncobj_created || !ubos.empty() || !ssbos.empty()) {
+        std::cout << "Frames in flight can't change once per frame resources exist"
+            << std::endl;
+        return false;
     }
+
+    frames_in_flight = cnt;
+    return true;
 }
 
-void VkWrappedInstance::create_sync_objects() {
-    image_available_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    render_finished_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    in_flight_fences.resize(MAX_FRAMES_IN_FLIGHT);
-    images_in_flight.resize(swapchain_images.size(), VK_NULL_HANDLE);
+void VkWrappedInstance::create_present_semaphores() {
+    // Presents of the old swapchain may still wait on them
+    defer_delete([this, old = std::move(render_finished_semaphores)] {
+        for (auto semaphore : old)
+            vkDestroySemaphore(device, semaphore, nullptr);
+    });
+    render_finished_semaphores.assign(swapchain_images.size(), VK_NULL_HANDLE);
 
     VkSemaphoreCreateInfo semaphor_info{};
     semaphor_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    for (auto& semaphore : render_finished_semaphores)
+        if (vkCreateSemaphore(device, &semaphor_info, nullptr, &semaphore) != VK_SUCCESS)
+            throw std::runtime_error("failed to create present semaphore");
+}
 
-    VkFenceCreateInfo fence_info{};
-    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+void VkWrappedInstance::create_sync_objects() {
+    image_available_semaphores.resize(frames_in_flight);
+
+    VkSemaphoreCreateInfo semaphor_info{};
+    semaphor_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-        if (vkCreateSemaphore(device, &semaphor_info, nullptr, &image_available_semaphores[i]) != VK_SUCCESS ||
-            vkCreateSemaphore(device, &semaphor_info, nullptr, &render_finished_semaphores[i]) != VK_SUCCESS ||
-            vkCreateFence(device, &fence_info, nullptr, &in_flight_fences[i]) != VK_SUCCESS)
+    for (size_t i = 0; i < frames_in_flight; ++i) {
+        if (vkCreateSemaphore(device, &semaphor_info, nullptr, &image_available_semaphores[i]) != VK_SUCCESS)
             throw std::runtime_error("failed to create synchronization objects for a frame");
     }
+    frame_scheduler.create(device, frames_in_flight, timeline_semaphore);
+    // Presentation holds on to the semaphore it waits on until the image
+    // comes back, so these follow the images rather than the frames
+    create_present_semaphores();
+    syncobj_created = true;
+}
+
+void VkWrappedInstance::set_present_mode(const VkPresentModeKHR mode) {
+    preferred_present_mode = mode;
+    if (swapchain_created)
+        framebuffer_resized = true;
+}
+
+void VkWrappedInstance::set_swapchain_image_cnt(const uint32_t cnt) {
+    preferred_image_cnt = cnt;
+    if (swapchain_created)
+        framebuffer_resized = true;
 }
 
 void VkWrappedInstance::draw_frame(const CommandBuffers& cmd_bufs) {
-    vkWaitForFences(device, 1, &in_flight_fences[current_frame], VK_TRUE, UINT64_MAX);
+    frame_limiter.wait();
+
+    // Every per frame resource of the slot is free to touch afterwards
+    auto slot = frame_scheduler.wait_for_slot(device);
+    deletion_queue.flush(frame_scheduler.completed_frame(device));
+    poll_shader_reloads();
+    poll_pipelines();
+
+    // The update only needs the slot, running it before acquiring keeps
+    // the CPU busy while the presentation engine holds every image
+    auto now = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::seconds>(now - time);
+    time = now;
+
+    if (update_cbk)
+        update_cbk(slot, duration.count());
 
     uint32_t image_idx;
     auto result = vkAcquireNextImageKHR(device, swapchain, UINT64_MAX,
-        image_available_semaphores[current_frame], VK_NULL_HANDLE, &image_idx);
+        image_available_semaphores[slot], VK_NULL_HANDLE, &image_idx);
 
     if (result == VK_ERROR_OUT_OF_DATE_KHR) {
         recreate_swapchain();
@@ -1202,24 +1613,13 @@ void VkWrappedInstance::draw_frame(const CommandBuffers& cmd_bufs) {
     else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
         throw std::runtime_error("failed to acquire swap chain image!");
 
-    if (images_in_flight[image_idx] != VK_NULL_HANDLE)
-        vkWaitForFences(device, 1, &images_in_flight[image_idx], VK_TRUE, UINT64_MAX);
-    images_in_flight[image_idx] = in_flight_fences[current_frame];
-
-    auto now = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::seconds>(now - time);
-    time = now;
-
-    //update_uniform_buffer(image_idx);
-    if (update_cbk)
-        update_cbk(image_idx, duration.count());
-
-    vkResetFences(device, 1, &in_flight_fences[current_frame]);
+    if (record_func)
+        record_frame_cmds(slot, image_idx);
 
     VkSubmitInfo submit_info{};
     submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-    VkSemaphore wait_semaphores[] = { image_available_semaphores[current_frame] };
+    VkSemaphore wait_semaphores[] = { image_available_semaphores[slot] };
     VkPipelineStageFlags wait_stages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
     submit_info.waitSemaphoreCount = 1;
     submit_info.pWaitSemaphores = wait_semaphores;
@@ -1227,14 +1627,29 @@ void VkWrappedInstance::draw_frame(const CommandBuffers& cmd_bufs) {
 
     // Multiple cmds, possible usage?
     submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers = &cmd_bufs.bufs[image_idx];
-
-    VkSemaphore signal_semaphores[] = { render_finished_semaphores[current_frame] };
+    submit_info.pCommandBuffers = &cmd_bufs.bufs[slot];
+
+    // Present only takes binary semaphores, the timeline one rides along
+    VkSemaphore signal_semaphores[] = { render_finished_semaphores[image_idx],
+        frame_scheduler.get_timeline() };
+    uint64_t signal_values[] = { 0, frame_scheduler.get_frame() };
+    VkTimelineSemaphoreSubmitInfoKHR timeline_info{};
+    timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+    timeline_info.signalSemaphoreValueCount = 2;
+    timeline_info.pSignalSemaphoreValues = signal_values;
     submit_info.signalSemaphoreCount = 1;
     submit_info.pSignalSemaphores = signal_semaphores;
+    if (frame_scheduler.uses_timeline()) {
+        submit_info.pNext = &timeline_info;
+        submit_info.signalSemaphoreCount = 2;
+    }
 
-    if (vkQueueSubmit(graphic_queue, 1, &submit_info, in_flight_fences[current_frame]) != VK_SUCCESS)
+    if (vkQueueSubmit(graphic_queue, 1, &submit_info,
+        frame_scheduler.get_submit_fence(device)) != VK_SUCCESS)
+    {
         throw std::runtime_error("failed to submit draw command buffer!");
+    }
+    frame_scheduler.advance();
 
     VkPresentInfoKHR present_info{};
     present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -1256,8 +1671,6 @@ void VkWrappedInstance::draw_frame(const CommandBuffers& cmd_bufs) {
     }
     else if (result != VK_SUCCESS)
         throw std::runtime_error("failed to present swap chain image!");
-
-    current_frame = (current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
 }
 
 void VkWrappedInstance::mainloop(const CommandBuffers& cmd_bufs) {
@@ -1309,6 +1722,17 @@ VkSurfaceFormatKHR VkWrappedInstance::choose_swap_surface_format(const std::vect
 }
 
 VkPresentModeKHR VkWrappedInstance::choose_swap_present_mode(const std::vector<VkPresentModeKHR>& available_present_modes) const {
+    // FIFO is the only mode every surface supports
+    if (preferred_present_mode) {
+        auto found = std::find(available_present_modes.begin(), available_present_modes.end(),
+            *preferred_present_mode);
+        if (found != available_present_modes.end())
+            return *found;
+        std::cout << "Present mode " << *preferred_present_mode
+            << " not supported, falling back to FIFO" << std::endl;
+        return VK_PRESENT_MODE_FIFO_KHR;
+    }
+
     for (const auto& available_present_mode : available_present_modes) {
         if (available_present_mode == VK_PRESENT_MODE_MAILBOX_KHR)
             return available_present_mode;
@@ -1382,9 +1806,11 @@ void VkWrappedInstance::delete_buffer(VkBuffer buf, VkDeviceMemory memo) const {
     vkFreeMemory(device, memo, nullptr);
 }
 
-void VkWrappedInstance::sync_uniform(VkDeviceMemory memo, const void* data, uint32_t size) const {
+void VkWrappedInstance::sync_uniform(VkDeviceMemory memo, const void* data, uint32_t size,
+    uint32_t offset) const
+{
     void* mapped = nullptr;
-    if (vkMapMemory(device, memo, 0, size, 0, &mapped) != VK_SUCCESS)
+    if (vkMapMemory(device, memo, offset, size, 0, &mapped) != VK_SUCCESS)
         throw std::runtime_error("failed to map uniform memory");
 
     memcpy(mapped, data, size);
@@ -1396,20 +1822,72 @@ bool VkWrappedInstance::add_ubo(const std::string& name, const uint32_t binding,
 {
     UBO ubo{.size = size, .vecsize = vecsize, .binding = binding};
     ubo.cpu_buf = std::make_shared<char[]>(size * vecsize);
-    ubo.gpu_bufs.resize(swapchain_cnt);
-    ubo.memos.resize(swapchain_cnt);
-    ubo.descriptors.resize(swapchain_cnt);
+    ubo.gpu_bufs.resize(frames_in_flight);
+    ubo.memos.resize(frames_in_flight);
+    ubo.descriptors.resize(frames_in_flight);
 
-    for (int i = 0; i < swapchain_cnt; ++i)
+    for (int i = 0; i < frames_in_flight; ++i) {
         create_buffer(size * vecsize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
             ubo.gpu_bufs[i], ubo.memos[i]);
+        ubo.descriptors[i] = VkDescriptorBufferInfo{
+            .buffer = ubo.gpu_bufs[i],
+            .offset = 0,
+            .range = size * vecsize
+        };
+    }
 
     ubos.emplace(name, std::move(ubo));
 
     return true;
 }
 
+bool VkWrappedInstance::add_ssbo(const std::string& name, const uint32_t binding,
+    uint32_t size, uint32_t vecsize)
+{
+    if (ssbos.contains(name)) {
+        std::cout << "SSBO with name " << name << " already exists.." << std::endl;
+        return false;
+    }
+
+    UBO ssbo{.size = size, .vecsize = vecsize, .binding = binding};
+    ssbo.gpu_bufs.resize(frames_in_flight);
+    ssbo.memos.resize(frames_in_flight);
+    ssbo.descriptors.resize(frames_in_flight);
+
+    for (int i = 0; i < frames_in_flight; ++i) {
+        create_buffer(size * vecsize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            ssbo.gpu_bufs[i], ssbo.memos[i]);
+        ssbo.descriptors[i] = VkDescriptorBufferInfo{
+            .buffer = ssbo.gpu_bufs[i],
+            .offset = 0,
+            .range = size * vecsize
+        };
+    }
+
+    ssbos.emplace(name, std::move(ssbo));
+    return true;
+}
+
+void VkWrappedInstance::remove_ssbo(const std::string& name) {
+    auto found = ssbos.find(name);
+    if (found == ssbos.end())
+        return;
+
+    // Frames in flight may still read the buffers, sets don't hand them
+    // out anymore from now on
+    auto bufs = std::move(found->second.gpu_bufs);
+    auto memos = std::move(found->second.memos);
+    for (auto buf : bufs)
+        forget_descriptor_sets(buf);
+    defer_delete([this, bufs = std::move(bufs), memos = std::move(memos)]() {
+        for (int i = 0; i < bufs.size(); ++i)
+            delete_buffer(bufs[i], memos[i]);
+    });
+    ssbos.erase(found);
+}
+
 bool VkWrappedInstance::add_texture(const std::string& name, const uint32_t binding,
     const fs::path& path)
 {
@@ -1482,27 +1960,15 @@ bool VkWrappedInstance::add_texture(const std::string& name, const uint32_t bind
         return false;
     }
 
-    VkSamplerCreateInfo sampler_info{};
-    sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-    sampler_info.magFilter = VK_FILTER_LINEAR;
-    sampler_info.minFilter = VK_FILTER_LINEAR;
-    sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-    sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    sampler_info.mipLodBias = 0.f;
-    sampler_info.compareEnable = VK_FALSE;
-    sampler_info.compareOp = VK_COMPARE_OP_ALWAYS;
-    sampler_info.minLod = 0.f;
-    sampler_info.maxLod = 0.f;
-    sampler_info.maxAnisotropy = 1.f;
-    sampler_info.anisotropyEnable = false;
-    sampler_info.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-    sampler_info.unnormalizedCoordinates = VK_FALSE;
-    if (vkCreateSampler(device, &sampler_info, nullptr, &tex.sampler) != VK_SUCCESS) {
+    try {
+        tex.sampler = sampler_cache.get(device, default_sampler_info());
+    }
+    catch (const std::runtime_error& e) {
         std::cout << "Create sampler for texture " << name << " failed" << std::endl;
         return false;
     }
+    tex.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    tex.descriptor = {tex.sampler, tex.view, tex.layout};
 
     textures.emplace(name, std::move(tex));
 
@@ -1604,26 +2070,15 @@ bool VkWrappedInstance::add_cubemap(const std::string& name, const uint32_t bind
         return false;
     }
 
-    VkSamplerCreateInfo sampler_info{};
-    sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-    sampler_info.magFilter = VK_FILTER_LINEAR;
-    sampler_info.minFilter = VK_FILTER_LINEAR;
-    sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-    sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    sampler_info.mipLodBias = 0.f;
-    sampler_info.compareEnable = VK_FALSE;
-    sampler_info.compareOp = VK_COMPARE_OP_ALWAYS;
-    sampler_info.minLod = 0.f;
-    sampler_info.maxLod = 0.f;
-    sampler_info.maxAnisotropy = 1.f;
-    sampler_info.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-    sampler_info.unnormalizedCoordinates = VK_FALSE;
-    if (vkCreateSampler(device, &sampler_info, nullptr, &tex.sampler) != VK_SUCCESS) {
+    try {
+        tex.sampler = sampler_cache.get(device, default_sampler_info());
+    }
+    catch (const std::runtime_error& e) {
         std::cout << "Create sampler for cubemap " << name << " failed" << std::endl;
         return false;
     }
+    tex.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    tex.descriptor = {tex.sampler, tex.view, tex.layout};
 
     textures.emplace(name, std::move(tex));
 
@@ -1635,41 +2090,55 @@ bool VkWrappedInstance::create_pipeline(const std::string& name,
     const std::vector<VERT_COMP>& comps,
     PipelineOption& option)
 {
+    return register_pipeline(name, modules, comps, option, false, "") != nullptr;
+}
+
+PipelineHandle VkWrappedInstance::create_pipeline_async(const std::string& name,
+    std::vector<ShaderModule>& modules,
+    const std::vector<VERT_COMP>& comps,
+    PipelineOption& option,
+    const std::string& fallback)
+{
+    auto entry = register_pipeline(name, modules, comps, option, true, fallback);
+    if (entry == nullptr)
+        return PipelineHandle{};
+    return PipelineHandle(name, PipelineRegistry::get_build(*entry));
+}
+
+PipelineRegistry::Entry* VkWrappedInstance::register_pipeline(const std::string& name,
+    std::vector<ShaderModule>& modules,
+    const std::vector<VERT_COMP>& comps,
+    PipelineOption& option,
+    const bool lazy,
+    const std::string& fallback,
+    const Pipeline* replacing)
+{
+    if (replacing == nullptr && pipelines.contains(name)) {
+        std::cout << "Pipeline " << name << " already exists" << std::endl;
+        return nullptr;
+    }
+
     // Pipeline creation resources
-    std::vector<VkShaderModule>                     vkmodules;
+    PipelineBuildInfo                               info;
     std::vector<VkVertexInputBindingDescription>    input_descriptions;
     std::vector<VkVertexInputAttributeDescription>  attr_descriptions;
     std::vector<VkDescriptorSetLayoutBinding>       descriptor_layouts;
-    std::vector<VkPipelineShaderStageCreateInfo>    shader_infos;
+    // Backing the pImmutableSamplers pointers until the layout is created
+    std::vector<std::vector<VkSampler>>             immutable_samplers;
+    std::unordered_map<uint32_t, std::string>       resource_names;
 
     for (auto& mod : modules) {
-        // Create vk shadermodules
-        VkShaderModuleCreateInfo module_info{
-            .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-            .codeSize = mod.spirv_code.size() * sizeof(uint32_t),
-            .pCode = mod.spirv_code.data()
-        };
-        VkShaderModule vkmodule;
-        if (vkCreateShaderModule(device, &module_info, nullptr, &vkmodule) != VK_SUCCESS) {
-            std::cout << "Module creation for pipeline " << name << " failed" << std::endl;
-            return false;
-        }
-        vkmodules.emplace_back(vkmodule);
-
-        // Create shader infos for pipeline creation
-        VkPipelineShaderStageCreateInfo shader_info{
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-            .stage = mod.type,
-            .module = vkmodule,
-            .pName = "main"
-        };
-
-        shader_infos.emplace_back(std::move(shader_info));
+        // Modules are created by the build itself, possibly on a worker
+        info.stages.emplace_back(mod.type, mod.spirv_code);
+        info.specializations.push_back(mod.get_specialization());
 
         for (auto& [ubo_name, ubo_info] : mod.buf_infos) {
             auto& [struct_size, array_size, binding] = ubo_info;
+            // Rebuilds keep the resources of the pipeline they replace
             auto ppl_ubo_name = name + ":" + ubo_name;
-            add_ubo(ppl_ubo_name, binding, struct_size, array_size);
+            if (replacing == nullptr)
+                add_ubo(ppl_ubo_name, binding, struct_size, array_size);
+            resource_names[binding] = ubo_name;
 
             VkDescriptorSetLayoutBinding desc_layout_binding {
                 .binding = binding,
@@ -1681,6 +2150,21 @@ bool VkWrappedInstance::create_pipeline(const std::string& name,
             descriptor_layouts.emplace_back(std::move(desc_layout_binding));
         }
 
+        // Storage buffers are owned by whoever fills them (e.g. Scene), only
+        // the layout is set up here
+        for (auto& [ssbo_name, ssbo_info] : mod.storage_infos) {
+            auto& [struct_size, array_size, binding] = ssbo_info;
+            resource_names[binding] = ssbo_name;
+            VkDescriptorSetLayoutBinding desc_layout_binding {
+                .binding = binding,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = array_size,
+                .stageFlags = mod.type,
+                .pImmutableSamplers = nullptr
+            };
+            descriptor_layouts.emplace_back(std::move(desc_layout_binding));
+        }
+
         for (auto& [tex_name, tex_binding] : mod.img_infos) {
             auto tex_path_info = mod.tex_img_pairs.find(tex_name);
             if (tex_path_info == mod.tex_img_pairs.end()) {
@@ -1690,10 +2174,11 @@ bool VkWrappedInstance::create_pipeline(const std::string& name,
 
             auto& [path, is_cubemap] = tex_path_info->second;
             auto ppl_tex_name = name + ":" + tex_name;
-            if (!is_cubemap)
+            if (replacing == nullptr && !is_cubemap)
                 add_texture(ppl_tex_name, tex_binding, path);
-            else
+            else if (replacing == nullptr)
                 add_cubemap(ppl_tex_name, tex_binding, path);
+            resource_names[tex_binding] = tex_name;
 
             VkDescriptorSetLayoutBinding binding {
                 .binding = tex_binding,
@@ -1702,6 +2187,13 @@ bool VkWrappedInstance::create_pipeline(const std::string& name,
                 .stageFlags = mod.type,
                 .pImmutableSamplers = nullptr
             };
+
+            // Cached samplers keep their handle, safe to bake in
+            auto tex = textures.find(ppl_tex_name);
+            if (option.immutable_samplers && tex != textures.end()) {
+                immutable_samplers.emplace_back(binding.descriptorCount, tex->second.sampler);
+                binding.pImmutableSamplers = immutable_samplers.back().data();
+            }
             descriptor_layouts.emplace_back(std::move(binding));
         }
 
@@ -1723,7 +2215,8 @@ bool VkWrappedInstance::create_pipeline(const std::string& name,
                     attr_descriptions.emplace_back(std::move(attr_des));
                 }
 
-                uint32_t stride = 0;
+                // Tightly packed attributes when no layout is given
+                uint32_t stride = comps.empty() ? offset : 0;
                 for (const auto& c : comps)
                     stride += comp_sizes[c] * sizeof(float);
 
@@ -1737,57 +2230,463 @@ bool VkWrappedInstance::create_pipeline(const std::string& name,
     
     Pipeline ppl{};
 
-    // Create descriptor set layout
-    VkDescriptorSetLayoutCreateInfo descriptor_layout_info{};
-    descriptor_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    descriptor_layout_info.bindingCount = descriptor_layouts.size();
-    descriptor_layout_info.pBindings = descriptor_layouts.data();
-
-    if (vkCreateDescriptorSetLayout(device, &descriptor_layout_info, nullptr, &ppl.descriptor_layout) != VK_SUCCESS) {
+    // Layouts come from the cache, sets are only allocated once something
+    // asks for them through get_descriptor_set
+    try {
+        ppl.descriptor_layout = layout_cache.get(device, descriptor_layouts);
+    }
+    catch (const std::runtime_error& e) {
         std::cout << "Descriptor layout creation failed for pipeline " << name << std::endl;
+        return nullptr;
+    }
+    ppl.bindings = std::move(descriptor_layouts);
+    ppl.resource_names = std::move(resource_names);
+    // The cache keeps its own copy of the immutable samplers
+    for (auto& b : ppl.bindings)
+        b.pImmutableSamplers = nullptr;
+
+    // Shaders reaching into the bindless heap get it as the second set
+    std::vector<VkDescriptorSetLayout> set_layouts{ppl.descriptor_layout};
+    ppl.bindless = std::any_of(modules.begin(), modules.end(), [](auto& mod) {
+        return mod.uses_bindless;
+    });
+    if (ppl.bindless) {
+        if (!bindless.created()) {
+            std::cout << "Pipeline " << name << " uses the bindless heap but it wasn't created"
+                << std::endl;
+            return nullptr;
+        }
+        set_layouts.push_back(bindless.get_layout());
+    }
+
+    // Push constant blocks reflected from the modules
+    ppl.push_ranges = collect_push_ranges(modules);
+    for (auto& range : ppl.push_ranges) {
+        if (range.offset + range.size > physical_device_props.limits.maxPushConstantsSize) {
+            std::cout << "Push constants of pipeline " << name << " exceed the "
+                << physical_device_props.limits.maxPushConstantsSize << " bytes limit" << std::endl;
+            return nullptr;
+        }
+    }
+
+    // Sets and resources stay as they are on a rebuild, so the shaders
+    // have to keep declaring the same ones
+    if (replacing != nullptr) {
+        auto same_ranges = std::equal(ppl.push_ranges.begin(), ppl.push_ranges.end(),
+            replacing->push_ranges.begin(), replacing->push_ranges.end(), [](auto& a, auto& b) {
+                return a.stageFlags == b.stageFlags && a.offset == b.offset && a.size == b.size;
+            });
+        if (ppl.descriptor_layout != replacing->descriptor_layout || ppl.bindless != replacing->bindless ||
+            !same_ranges)
+        {
+            std::cout << "Resources of pipeline " << name << " changed, restart to pick the new "
+                "shaders up" << std::endl;
+            return nullptr;
+        }
+    }
+
+    ppl.dynamic_states = supported_dynamic_states(option.dynamic_states, extended_dynamic_state);
+    if (!extended_dynamic_state && ppl.dynamic_states.size() <
+        supported_dynamic_states(option.dynamic_states, true).size())
+        std::cout << "Extended dynamic states of pipeline " << name
+            << " not supported, baking them in" << std::endl;
+
+    // Vertex input reflected from the vertex stage unless the option
+    // brings its own
+    if (option.input_info.vertexBindingDescriptionCount > 0) {
+        auto& in = option.input_info;
+        info.input_bindings.assign(in.pVertexBindingDescriptions,
+            in.pVertexBindingDescriptions + in.vertexBindingDescriptionCount);
+        info.input_attrs.assign(in.pVertexAttributeDescriptions,
+            in.pVertexAttributeDescriptions + in.vertexAttributeDescriptionCount);
+    }
+    else {
+        info.input_bindings = std::move(input_descriptions);
+        info.input_attrs = std::move(attr_descriptions);
+    }
+    info.input_assembly = option.input_assembly;
+    info.viewport = option.viewport;
+    info.scissor = option.scissor;
+    info.rasterizer = option.rasterizer;
+    info.multisampling = option.multisampling;
+    info.depth_stencil = option.depth_stencil;
+    info.blend_attachments.assign(option.blend_state.pAttachments,
+        option.blend_state.pAttachments + option.blend_state.attachmentCount);
+    info.blend_state = option.blend_state;
+    info.dynamic_states = ppl.dynamic_states;
+    info.render_pass = get_renderpass();
+    info.subpass = 0;
+
+    // Same shaders, state and layout shape as an existing pipeline, share
+    // its VkPipeline and layout whatever it was called
+    PipelineKey key(info, set_layouts, ppl.push_ranges);
+    auto entry = pipeline_registry.find(key);
+    if (entry == nullptr) {
+        VkPipelineLayoutCreateInfo ppl_layout_info{};
+        ppl_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        ppl_layout_info.setLayoutCount = static_cast<uint32_t>(set_layouts.size());
+        ppl_layout_info.pSetLayouts = set_layouts.data();
+        ppl_layout_info.pushConstantRangeCount = static_cast<uint32_t>(ppl.push_ranges.size());
+        ppl_layout_info.pPushConstantRanges = ppl.push_ranges.data();
+
+        if (vkCreatePipelineLayout(device, &ppl_layout_info, nullptr, &info.layout) != VK_SUCCESS) {
+            std::cout << "Pipeline layout creation failed for pipeline " << name << std::endl;
+            return nullptr;
+        }
+        entry = pipeline_registry.add(device, std::move(key), std::move(info), lazy);
+    }
+    else if (!lazy) {
+        // Queued by an earlier request, this one can't wait for the poll
+        pipeline_registry.poll(*entry, true);
+    }
+
+    if (entry->state == PipelineRegistry::State::failed) {
+        std::cout << "Pipeline " << name << " creation failed" << std::endl;
+        return nullptr;
+    }
+
+    ppl.pipeline = entry->pipeline;
+    ppl.ppl_layout = entry->layout;
+    ppl.entry = entry;
+    ppl.fallback = fallback;
+    pipeline_registry.retain(*entry);
+
+    // Swapped in by poll_pipelines once built, the old one keeps drawing
+    // until then. A rebuild still queued from an earlier edit is dropped
+    if (replacing != nullptr) {
+        auto queued = pipeline_swaps.find(name);
+        if (queued != pipeline_swaps.end())
+            release_pipeline_entry(queued->second.entry);
+        pipeline_swaps.insert_or_assign(name, std::move(ppl));
+        return entry;
+    }
+
+    if (hot_reload) {
+        for (auto& mod : modules)
+            watch_shader(mod);
+        pipeline_sources.insert_or_assign(name, PipelineSource{modules, comps, option});
+    }
+    pipelines.emplace(name, std::move(ppl));
+
+    return entry;
+}
+
+void VkWrappedInstance::release_pipeline_entry(PipelineRegistry::Entry* entry) {
+    if (entry == nullptr)
+        return;
+    if (auto deleter = pipeline_registry.release(device, *entry))
+        defer_delete(std::move(deleter));
+}
+
+bool VkWrappedInstance::save_pipeline_cache() const {
+    if (pipeline_cache_path.empty())
         return false;
+
+    auto data = pipeline_registry.get_cache_data(device);
+    std::ofstream file(pipeline_cache_path, std::ios::binary | std::ios::trunc);
+    if (data.empty() || !file.good()) {
+        std::cout << "Failed to save pipeline cache to " << pipeline_cache_path << std::endl;
+        return false;
+    }
+    file.write(data.data(), data.size());
+    return true;
+}
+
+void VkWrappedInstance::watch_shader(const ShaderModule& mod) {
+    if (mod.path.empty())
+        return;
+    if (!shader_watcher.watch(mod.path))
+        std::cout << "Can't watch " << mod.path << " for changes" << std::endl;
+    for (auto& dep : mod.dependencies)
+        if (!shader_watcher.watch(dep))
+            std::cout << "Can't watch " << dep << " for changes" << std::endl;
+}
+
+void VkWrappedInstance::poll_shader_reloads() {
+    if (!hot_reload)
+        return;
+
+    // Only the modules reading the file get compiled again, on a worker.
+    // An edited header recompiles every module including it
+    for (auto& changed : shader_watcher.poll()) {
+        for (auto& [name, src] : pipeline_sources) {
+            for (size_t i = 0; i < src.modules.size(); ++i) {
+                auto& mod = src.modules[i];
+                std::error_code ec;
+                if (fs::weakly_canonical(mod.path, ec) != changed &&
+                    !mod.dependencies.contains(changed))
+                {
+                    continue;
+                }
+                std::cout << "Shader " << changed << " changed, reloading" << std::endl;
+                shader_reloads.push_back(ShaderReload{name, i,
+                    ThreadPool::instance().enqueue([mod = src.modules[i]]() {
+                        return mod.recompile();
+                    })});
+            }
+        }
+    }
+
+    std::set<std::string> rebuilds;
+    for (auto it = shader_reloads.begin(); it != shader_reloads.end();) {
+        if (it->result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            ++it;
+            continue;
+        }
+
+        auto mod = it->result.get();
+        auto& src = pipeline_sources.at(it->pipeline);
+        if (mod.has_value()) {
+            // The edit may have pulled in new headers
+            watch_shader(*mod);
+            src.modules[it->module_idx] = std::move(*mod);
+            rebuilds.insert(it->pipeline);
+        }
+        else {
+            std::cout << "Shader " << src.modules[it->module_idx].path << " doesn't compile, "
+                "keeping pipeline " << it->pipeline << std::endl;
+        }
+        it = shader_reloads.erase(it);
+    }
+
+    // Built on the thread pool through the pipeline cache like any request
+    for (auto& name : rebuilds) {
+        auto found = pipelines.find(name);
+        if (found == pipelines.end())
+            continue;
+        auto& src = pipeline_sources.at(name);
+        register_pipeline(name, src.modules, src.comps, src.option, true, found->second.fallback,
+            &found->second);
     }
+}
 
-    // Create pipeline layout
-    VkPipelineLayoutCreateInfo ppl_layout_info{};
-    ppl_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    ppl_layout_info.setLayoutCount = 1;
-    ppl_layout_info.pSetLayouts = &ppl.descriptor_layout;
+void VkWrappedInstance::poll_pipelines() {
+    for (auto it = pipeline_swaps.begin(); it != pipeline_swaps.end();) {
+        auto& [name, swap] = *it;
+        pipeline_registry.poll(*swap.entry);
+        if (swap.entry->state == PipelineRegistry::State::pending) {
+            ++it;
+            continue;
+        }
+
+        // Frames in flight may still use the old VkPipeline, its entry
+        // goes through the deletion queue once nothing else shares it
+        auto found = pipelines.find(name);
+        if (swap.entry->state == PipelineRegistry::State::ready && found != pipelines.end()) {
+            auto old = found->second.entry;
+            swap.pipeline = swap.entry->pipeline;
+            found->second = std::move(swap);
+            release_pipeline_entry(old);
+            std::cout << "Pipeline " << name << " reloaded" << std::endl;
+        }
+        else {
+            release_pipeline_entry(swap.entry);
+            std::cout << "Rebuilding pipeline " << name << " failed, keeping the old one" << std::endl;
+        }
+        it = pipeline_swaps.erase(it);
+    }
+
+    for (auto& [name, ppl] : pipelines) {
+        if (ppl.entry == nullptr || ppl.pipeline != VK_NULL_HANDLE)
+            continue;
+        // Entries are shared, an earlier pipeline may have polled it already
+        auto done = pipeline_registry.poll(*ppl.entry);
+        if (ppl.entry->state == PipelineRegistry::State::ready)
+            ppl.pipeline = ppl.entry->pipeline;
+        else if (done && ppl.entry->state == PipelineRegistry::State::failed)
+            std::cout << "Background build of pipeline " << name << " failed" << std::endl;
+    }
+}
 
-    if (vkCreatePipelineLayout(device, &ppl_layout_info, nullptr, &ppl.ppl_layout) != VK_SUCCESS) {
-        std::cout << "Pipeline layout creation failed for pipeline " << name << std::endl;
+bool VkWrappedInstance::get_descriptor_bindings(const std::string& ppl_name,
+    const uint32_t idx, std::vector<DescriptorBinding>& bindings)
+{
+    auto found = pipelines.find(ppl_name);
+    if (found == pipelines.end()) {
+        std::cout << "No pipeline named " << ppl_name << std::endl;
         return false;
     }
 
-    // Create pipeline
-    VkGraphicsPipelineCreateInfo pipeline_info{
-        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-        .stageCount = static_cast<uint32_t>(shader_infos.size()),
-        .pStages = shader_infos.data(),
-        .pVertexInputState = &option.input_info,
-        .pInputAssemblyState = &option.input_assembly,
-        .pViewportState = &option.vp_state_info,
-        .pRasterizationState = &option.rasterizer,
-        .pMultisampleState = &option.multisampling,
-        .pDepthStencilState = &option.depth_stencil,
-        .pColorBlendState = &option.blend_state,
-        .layout = ppl.ppl_layout,
-        .renderPass = get_renderpass(),
-        .subpass = 0,
-        .basePipelineHandle = VK_NULL_HANDLE
+    // The pipeline's own copy of the reflected resource first, otherwise
+    // whatever sits on the binding as long as nothing else does
+    auto& ppl = found->second;
+    bool ambiguous = false;
+    auto find_bound = [&](auto& resources, const uint32_t binding) {
+        decltype(&resources.begin()->second) any = nullptr;
+        if (auto res_name = ppl.resource_names.find(binding); res_name != ppl.resource_names.end()) {
+            auto own = resources.find(ppl_name + ":" + res_name->second);
+            if (own != resources.end() && own->second.binding == binding)
+                return &own->second;
+        }
+        for (auto& [name, res] : resources) {
+            if (res.binding != binding)
+                continue;
+            if (any != nullptr) {
+                std::cout << "Several resources on binding " << binding << " of pipeline "
+                    << ppl_name << ", name one " << ppl_name << ":<resource>" << std::endl;
+                ambiguous = true;
+                return decltype(any)(nullptr);
+            }
+            any = &res;
+        }
+        return any;
     };
 
-    // Pipelines could be created batched, maybe postpone the creation
-    // will be better?
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_info,
-        nullptr, &ppl.pipeline) != VK_SUCCESS)
+    bindings.clear();
+    bindings.reserve(ppl.bindings.size());
+    for (auto& layout_binding : ppl.bindings) {
+        DescriptorBinding b{.binding = layout_binding.binding,
+            .type = layout_binding.descriptorType};
+        bool resolved = false;
+        switch (layout_binding.descriptorType) {
+            case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+            case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER: {
+                auto buf = layout_binding.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER ?
+                    find_bound(ubos, b.binding) : find_bound(ssbos, b.binding);
+                if (buf != nullptr && idx < buf->descriptors.size()) {
+                    b.buffer = buf->descriptors[idx];
+                    resolved = true;
+                }
+                break;
+            }
+            case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER: {
+                if (auto tex = find_bound(textures, b.binding)) {
+                    b.image = tex->descriptor;
+                    resolved = true;
+                }
+                else if (auto img = bound_images.find(b.binding); img != bound_images.end()) {
+                    b.image = img->second;
+                    resolved = true;
+                }
+                break;
+            }
+            default:
+                break;
+        }
+
+        if (ambiguous)
+            return false;
+        if (!resolved) {
+            std::cout << "No resource for binding " << b.binding << " of pipeline "
+                << ppl_name << std::endl;
+            return false;
+        }
+        bindings.push_back(b);
+    }
+    return true;
+}
+
+VkDescriptorSet VkWrappedInstance::get_descriptor_set(const std::string& ppl_name,
+    const uint32_t idx)
+{
+    std::vector<DescriptorBinding> bindings;
+    if (!get_descriptor_bindings(ppl_name, idx, bindings))
+        return VK_NULL_HANDLE;
+
+    try {
+        return set_cache.get(device, descriptor_allocator, pipelines.at(ppl_name).descriptor_layout,
+            bindings);
+    }
+    catch (const std::runtime_error& e) {
+        std::cout << "Descriptor set allocation failed for pipeline " << ppl_name << " : "
+            << e.what() << std::endl;
+        return VK_NULL_HANDLE;
+    }
+}
+
+void VkWrappedInstance::bind_image(const uint32_t binding, const VkDescriptorImageInfo& info) {
+    auto found = bound_images.find(binding);
+    if (found != bound_images.end())
+        forget_descriptor_sets(found->second.imageView);
+    bound_images[binding] = info;
+}
+
+bool VkWrappedInstance::create_bindless_heap(const uint32_t image_cnt,
+    const uint32_t buffer_cnt)
+{
+    if (!enabled_features.shaderSampledImageArrayDynamicIndexing ||
+        !enabled_features.shaderStorageBufferArrayDynamicIndexing)
     {
-        std::cout << "Pipeline " << name << " creation failed" << std::endl;
+        std::cout << "Bindless heap needs dynamic indexing of image and storage buffer arrays"
+            << std::endl;
+        return false;
+    }
+
+    // Leave room for what set 0 of the same pipelines binds
+    auto& limits = physical_device_props.limits;
+    uint32_t images, buffers;
+    if (descriptor_indexing) {
+        const uint32_t reserved = 32;
+        auto image_limit = std::min({indexing_props.maxPerStageDescriptorUpdateAfterBindSamplers,
+            indexing_props.maxPerStageDescriptorUpdateAfterBindSampledImages,
+            indexing_props.maxDescriptorSetUpdateAfterBindSampledImages});
+        auto buffer_limit = std::min(indexing_props.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+            indexing_props.maxDescriptorSetUpdateAfterBindStorageBuffers);
+        images = std::min(image_cnt, image_limit > reserved ? image_limit - reserved : 1);
+        buffers = std::min(buffer_cnt, buffer_limit > reserved ? buffer_limit - reserved : 1);
+    }
+    else {
+        // Shaders declare the fallback arrays with exactly these sizes, a
+        // smaller layout wouldn't be compatible with them
+        images = BINDLESS_FALLBACK_IMAGES;
+        buffers = BINDLESS_FALLBACK_BUFFERS;
+        if (std::min(limits.maxPerStageDescriptorSamplers,
+                limits.maxPerStageDescriptorSampledImages) / 2 < images ||
+            limits.maxPerStageDescriptorStorageBuffers / 2 < buffers)
+        {
+            std::cout << "Device limits can't hold the fallback bindless heap" << std::endl;
+            return false;
+        }
+    }
+
+    if (bindless.created()) {
+        vkDeviceWaitIdle(device);
+        bindless.destroy(device);
+    }
+
+    try {
+        bindless.create(device, descriptor_indexing, images, buffers);
+    }
+    catch (const std::runtime_error& e) {
+        std::cout << "Bindless heap creation failed : " << e.what() << std::endl;
         return false;
     }
+    return true;
+}
+
+uint32_t VkWrappedInstance::add_bindless_texture(const std::string& name) {
+    auto found = textures.find(name);
+    if (found == textures.end() || !bindless.created()) {
+        std::cout << "No texture named " << name << " or no bindless heap" << std::endl;
+        return BINDLESS_NONE;
+    }
+    return bindless.add_image(device, found->second.descriptor);
+}
 
-    pipelines.emplace(name, ppl);
+uint32_t VkWrappedInstance::add_bindless_ssbo(const std::string& name, const uint32_t idx) {
+    auto found = ssbos.find(name);
+    if (found == ssbos.end() || idx >= found->second.descriptors.size() || !bindless.created()) {
+        std::cout << "No storage buffer named " << name << " or no bindless heap" << std::endl;
+        return BINDLESS_NONE;
+    }
+    return bindless.add_buffer(device, found->second.descriptors[idx]);
+}
 
+bool VkWrappedInstance::remove_bindless_texture(const uint32_t slot) {
+    if (!bindless.get_image_slots().is_taken(slot))
+        return false;
+    defer_delete([this, slot]() {
+        bindless.remove_image(device, slot);
+    });
+    return true;
+}
+
+bool VkWrappedInstance::remove_bindless_ssbo(const uint32_t slot) {
+    if (!bindless.get_buffer_slots().is_taken(slot))
+        return false;
+    defer_delete([this, slot]() {
+        bindless.remove_buffer(device, slot);
+    });
     return true;
 }
 
@@ -1863,11 +2762,521 @@ bool VkWrappedInstance::create_framebuffer_from_targets(const std::string& name)
     return true;
 }
 
+bool VkWrappedInstance::create_shadow_targets(const uint32_t cascade_res,
+    const uint32_t cascade_cnt, const uint32_t atlas_size)
+{
+    destroy_shadow_targets();
+
+    auto& st = shadow_targets;
+    st.format = find_depth_format();
+    st.cascade_res = cascade_res;
+    st.cascade_cnt = cascade_cnt;
+    st.atlas_size = atlas_size;
+
+    VkAttachmentDescription depth_attachment{
+        .format = st.format,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        // Atlas tiles are rendered one pass each, clearing only the
+        // render area, the rest of the atlas has to survive. Coming from
+        // UNDEFINED would discard it, so every pass starts from the layout
+        // the last one left and both images get there once at creation
+        .initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+        .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+    };
+
+    VkAttachmentReference depth_ref{
+        .attachment = 0,
+        .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+    };
+
+    VkSubpassDescription subpass{
+        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .colorAttachmentCount = 0,
+        .pDepthStencilAttachment = &depth_ref
+    };
+
+    // Previous frame's lighting pass reads the map, the next one waits
+    // for the depth writes
+    std::array<VkSubpassDependency, 2> deps{
+        VkSubpassDependency{
+            .srcSubpass = VK_SUBPASS_EXTERNAL,
+            .dstSubpass = 0,
+            .srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+            .srcAccessMask = VK_ACCESS_SHADER_READ_BIT,
+            .dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            .dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT
+        },
+        VkSubpassDependency{
+            .srcSubpass = 0,
+            .dstSubpass = VK_SUBPASS_EXTERNAL,
+            .srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            .srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+            .dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT
+        }
+    };
+
+    VkRenderPassCreateInfo pass_info{
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .attachmentCount = 1,
+        .pAttachments = &depth_attachment,
+        .subpassCount = 1,
+        .pSubpasses = &subpass,
+        .dependencyCount = static_cast<uint32_t>(deps.size()),
+        .pDependencies = deps.data()
+    };
+
+    if (vkCreateRenderPass(device, &pass_info, nullptr, &st.render_pass) != VK_SUCCESS) {
+        std::cout << "Shadow render pass creation failed" << std::endl;
+        return false;
+    }
+
+    auto create_view = [&](VkImage image, VkImageViewType type, uint32_t base_layer,
+        uint32_t layer_cnt)
+    {
+        VkImageViewCreateInfo view_info{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .image = image,
+            .viewType = type,
+            .format = st.format,
+            .subresourceRange = {
+                .aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT,
+                .baseMipLevel = 0,
+                .levelCount = 1,
+                .baseArrayLayer = base_layer,
+                .layerCount = layer_cnt
+            }
+        };
+        VkImageView view;
+        if (vkCreateImageView(device, &view_info, nullptr, &view) != VK_SUCCESS)
+            throw std::runtime_error("failed to create shadow map view");
+        return view;
+    };
+
+    auto create_fb = [&](VkImageView view, uint32_t size) {
+        VkFramebufferCreateInfo fb_info{
+            .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+            .renderPass = st.render_pass,
+            .attachmentCount = 1,
+            .pAttachments = &view,
+            .width = size,
+            .height = size,
+            .layers = 1
+        };
+        VkFramebuffer fb;
+        if (vkCreateFramebuffer(device, &fb_info, nullptr, &fb) != VK_SUCCESS)
+            throw std::runtime_error("failed to create shadow framebuffer");
+        return fb;
+    };
+
+    const VkImageUsageFlags usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
+        | VK_IMAGE_USAGE_SAMPLED_BIT;
+
+    auto to_read_only = [&](VkImage image, uint32_t layer_cnt) {
+        VkImageSubresourceRange range{
+            .aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT,
+            .baseMipLevel = 0,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = layer_cnt
+        };
+        if (has_stencil_comp(st.format))
+            range.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+        transition_image_layout(image, st.format, VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, range);
+    };
+
+    if (cascade_cnt > 0) {
+        create_vk_image(cascade_res, cascade_res, cascade_cnt, VK_SAMPLE_COUNT_1_BIT, st.format,
+            VK_IMAGE_TILING_OPTIMAL, usage, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            st.cascade_image, st.cascade_memo);
+        to_read_only(st.cascade_image, cascade_cnt);
+        st.cascade_view = create_view(st.cascade_image, VK_IMAGE_VIEW_TYPE_2D_ARRAY, 0,
+            cascade_cnt);
+        for (uint32_t i = 0; i < cascade_cnt; ++i) {
+            st.cascade_layer_views.push_back(create_view(st.cascade_image,
+                VK_IMAGE_VIEW_TYPE_2D, i, 1));
+            st.cascade_fbs.push_back(create_fb(st.cascade_layer_views.back(), cascade_res));
+        }
+    }
+
+    if (atlas_size > 0) {
+        create_vk_image(atlas_size, atlas_size, 1, VK_SAMPLE_COUNT_1_BIT, st.format,
+            VK_IMAGE_TILING_OPTIMAL, usage, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            st.atlas_image, st.atlas_memo);
+        to_read_only(st.atlas_image, 1);
+        st.atlas_view = create_view(st.atlas_image, VK_IMAGE_VIEW_TYPE_2D, 0, 1);
+        st.atlas_fb = create_fb(st.atlas_view, atlas_size);
+    }
+
+    // Outside the map counts as lit
+    VkSamplerCreateInfo sampler_info{
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_LINEAR,
+        .minFilter = VK_FILTER_LINEAR,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
+        .mipLodBias = 0.f,
+        .anisotropyEnable = VK_FALSE,
+        .maxAnisotropy = 1.f,
+        .compareEnable = VK_TRUE,
+        .compareOp = VK_COMPARE_OP_LESS_OR_EQUAL,
+        .minLod = 0.f,
+        .maxLod = 1.f,
+        .borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE,
+        .unnormalizedCoordinates = VK_FALSE
+    };
+
+    try {
+        st.sampler = sampler_cache.get(device, sampler_info);
+    }
+    catch (const std::runtime_error& e) {
+        std::cout << "Shadow sampler creation failed" << std::endl;
+        return false;
+    }
+
+    st.cascade_descriptor = VkDescriptorImageInfo{
+        .sampler = st.sampler,
+        .imageView = st.cascade_view,
+        .imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+    };
+    st.atlas_descriptor = VkDescriptorImageInfo{
+        .sampler = st.sampler,
+        .imageView = st.atlas_view,
+        .imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+    };
+
+    return true;
+}
+
+void VkWrappedInstance::destroy_shadow_targets() {
+    auto& st = shadow_targets;
+    if (!st.created())
+        return;
+
+    forget_descriptor_sets(st.cascade_view);
+    forget_descriptor_sets(st.atlas_view);
+    std::erase_if(bound_images, [&](const auto& kv) {
+        return kv.second.imageView == st.cascade_view || kv.second.imageView == st.atlas_view;
+    });
+
+    // Frames in flight may still render into or sample the maps
+    defer_delete([this, old = std::move(st)]() {
+        for (auto fb : old.cascade_fbs)
+            vkDestroyFramebuffer(device, fb, nullptr);
+        for (auto view : old.cascade_layer_views)
+            vkDestroyImageView(device, view, nullptr);
+        if (old.cascade_image != VK_NULL_HANDLE) {
+            vkDestroyImageView(device, old.cascade_view, nullptr);
+            vkDestroyImage(device, old.cascade_image, nullptr);
+            vkFreeMemory(device, old.cascade_memo, nullptr);
+        }
+
+        if (old.atlas_image != VK_NULL_HANDLE) {
+            vkDestroyFramebuffer(device, old.atlas_fb, nullptr);
+            vkDestroyImageView(device, old.atlas_view, nullptr);
+            vkDestroyImage(device, old.atlas_image, nullptr);
+            vkFreeMemory(device, old.atlas_memo, nullptr);
+        }
+
+        vkDestroyRenderPass(device, old.render_pass, nullptr);
+    });
+    st = ShadowTargets{};
+}
+
+bool VkWrappedInstance::create_shadow_pipeline(const std::string& name,
+    std::vector<ShaderModule>& modules, const std::vector<VERT_COMP>& comps,
+    PipelineOption& option)
+{
+    if (!shadow_targets.created()) {
+        std::cout << "Shadow targets must be created before pipeline " << name << std::endl;
+        return false;
+    }
+
+    if (pipelines.contains(name)) {
+        std::cout << "Pipeline " << name << " already exists" << std::endl;
+        return false;
+    }
+
+    int32_t pos_offset = -1;
+    uint32_t stride = 0;
+    for (const auto& c : comps) {
+        if (c == VERTEX)
+            pos_offset = stride;
+        stride += comp_sizes[c] * sizeof(float);
+    }
+    if (pos_offset < 0) {
+        std::cout << "Shadow pipeline " << name << " needs a position component" << std::endl;
+        return false;
+    }
+
+    PipelineBuildInfo info;
+    for (auto& mod : modules) {
+        info.stages.emplace_back(mod.type, mod.spirv_code);
+        info.specializations.push_back(mod.get_specialization());
+    }
+    info.input_bindings.push_back({0, stride, VK_VERTEX_INPUT_RATE_VERTEX});
+    info.input_attrs.push_back({0, 0, VK_FORMAT_R32G32B32_SFLOAT,
+        static_cast<uint32_t>(pos_offset)});
+    info.input_assembly = option.input_assembly;
+    info.viewport = option.viewport;
+    info.scissor = option.scissor;
+
+    // Depth clamp keeps casters in front of the cascade near plane from
+    // being clipped away, it's an optional feature
+    info.rasterizer = option.rasterizer;
+    info.rasterizer.depthClampEnable = VK_BOOL(enabled_features.depthClamp);
+    info.rasterizer.depthBiasEnable = VK_TRUE;
+
+    // The shadow pass is single sampled whatever the scene uses
+    info.multisampling = option.multisampling;
+    info.multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    info.multisampling.sampleShadingEnable = VK_FALSE;
+    info.depth_stencil = option.depth_stencil;
+    // Depth only, no color attachment to blend into
+    info.blend_state = option.blend_state;
+    info.dynamic_states = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR,
+        VK_DYNAMIC_STATE_DEPTH_BIAS
+    };
+    info.render_pass = shadow_targets.render_pass;
+    info.subpass = 0;
+
+    Pipeline ppl{};
+    ppl.push_ranges = {VkPushConstantRange{
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+        .offset = 0,
+        .size = sizeof(glm::mat4)
+    }};
+    ppl.dynamic_states = info.dynamic_states;
+    try {
+        ppl.descriptor_layout = layout_cache.get(device, {});
+    }
+    catch (const std::runtime_error& e) {
+        std::cout << "Descriptor layout creation failed for pipeline " << name << std::endl;
+        return false;
+    }
+
+    // Shared and cached like any other pipeline, the registry owns the
+    // pipeline and its layout
+    std::vector<VkDescriptorSetLayout> set_layouts{ppl.descriptor_layout};
+    PipelineKey key(info, set_layouts, ppl.push_ranges);
+    auto entry = pipeline_registry.find(key);
+    if (entry == nullptr) {
+        VkPipelineLayoutCreateInfo ppl_layout_info{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .setLayoutCount = static_cast<uint32_t>(set_layouts.size()),
+            .pSetLayouts = set_layouts.data(),
+            .pushConstantRangeCount = static_cast<uint32_t>(ppl.push_ranges.size()),
+            .pPushConstantRanges = ppl.push_ranges.data()
+        };
+        if (vkCreatePipelineLayout(device, &ppl_layout_info, nullptr, &info.layout) != VK_SUCCESS) {
+            std::cout << "Pipeline layout creation failed for pipeline " << name << std::endl;
+            return false;
+        }
+        entry = pipeline_registry.add(device, std::move(key), std::move(info), false);
+    }
+    else {
+        pipeline_registry.poll(*entry, true);
+    }
+
+    if (entry->state == PipelineRegistry::State::failed) {
+        std::cout << "Pipeline " << name << " creation failed" << std::endl;
+        return false;
+    }
+
+    ppl.pipeline = entry->pipeline;
+    ppl.ppl_layout = entry->layout;
+    ppl.entry = entry;
+    pipeline_registry.retain(*entry);
+    pipelines.emplace(name, std::move(ppl));
+    return true;
+}
+
 bool VkWrappedInstance::load_mesh(const std::string& name, const Mesh& m) {
+    if (meshes.contains(name)) {
+        std::cout << "Mesh with name " << name << " already loaded.." << std::endl;
+        return false;
+    }
+
+    if (!m.loaded) {
+        std::cout << "Mesh " << name << " not loaded on cpu side.." << std::endl;
+        return false;
+    }
+
     MeshGPU mgpu{};
-    mgpu.sync(m, this);
-    meshes.emplace(name, mgpu);
+    if (upload_to_geometry_pool(m, mgpu)) {
+        if (!m.meshlets.empty())
+            mgpu.sync_meshlets(m, this);
+    }
+    else {
+        // Too big for the pool, or the pool is full
+        mgpu.sync(m, this);
+    }
+    mgpu.bounds = m.bounds;
+    meshes.emplace(name, std::move(mgpu));
+    return true;
+}
+
+bool VkWrappedInstance::unload_mesh(const std::string& name) {
+    auto found = meshes.find(name);
+    if (found == meshes.end()) {
+        std::cout << "Mesh with name " << name << " not found.." << std::endl;
+        return false;
+    }
+
+    // Frames in flight may still draw from the buffers or the pool range,
+    // the range can't be handed to another mesh before they are done
+    defer_delete([this, mesh = std::move(found->second)]() mutable {
+        destroy_mesh_gpu(mesh);
+    });
+    meshes.erase(found);
+    return true;
+}
+
+void VkWrappedInstance::emit_mesh_draw_cmds(VkCommandBuffer cmd_buf,
+    const std::vector<std::string>& names, VkPipelineLayout ppl_layout,
+    const VkDescriptorSet* desc_set) const
+{
+    if (desc_set != nullptr) {
+        vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, ppl_layout,
+            0, 1, desc_set, 0, nullptr);
+    }
+
+    VkBuffer bound_vbuf = VK_NULL_HANDLE;
+    VkBuffer bound_ibuf = VK_NULL_HANDLE;
+    VkIndexType bound_type = VK_INDEX_TYPE_MAX_ENUM;
+    for (const auto& name : names) {
+        auto found = meshes.find(name);
+        if (found == meshes.end()) {
+            std::cout << "Mesh with name " << name << " not found.." << std::endl;
+            continue;
+        }
+
+        const auto& mesh = found->second;
+        if (mesh.vbuf != bound_vbuf || mesh.ibuf != bound_ibuf || mesh.index_type != bound_type) {
+            mesh.emit_bind_cmd(cmd_buf);
+            bound_vbuf = mesh.vbuf;
+            bound_ibuf = mesh.ibuf;
+            bound_type = mesh.index_type;
+        }
+        mesh.emit_draw_only_cmd(cmd_buf);
+    }
+}
+
+std::string VkWrappedInstance::get_geometry_pool_key(const std::vector<VERT_COMP>& comps,
+    const VkIndexType type)
+{
+    std::string key;
+    for (const auto& comp : comps)
+        key += std::to_string(comp) + ",";
+    key += type == VK_INDEX_TYPE_UINT16 ? "u16" : "u32";
+    return key;
+}
+
+bool VkWrappedInstance::upload_to_geometry_pool(const Mesh& m, MeshGPU& mgpu) {
+    if (!m.indexed || m.vcnt > pool_vertex_cnt || m.icnt * 3 > pool_index_cnt)
+        return false;
+
+    auto key = get_geometry_pool_key(m.comps, m.index_type);
+    auto found = geometry_pools.find(key);
+    if (found == geometry_pools.end()) {
+        GeometryPool pool{
+            .stride = m.comp_size * static_cast<uint32_t>(sizeof(float)),
+            .index_type = m.index_type
+        };
+        create_buffer(static_cast<VkDeviceSize>(pool_vertex_cnt) * pool.stride,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, pool.vbuf, pool.vbuf_memo);
+        create_buffer(static_cast<VkDeviceSize>(pool_index_cnt) * m.index_size(),
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, pool.ibuf, pool.ibuf_memo);
+        pool.vranges.reset(pool_vertex_cnt);
+        pool.iranges.reset(pool_index_cnt);
+        found = geometry_pools.emplace(key, std::move(pool)).first;
+    }
+
+    auto& pool = found->second;
+    auto voff = pool.vranges.alloc(m.vcnt);
+    if (!voff)
+        return false;
+    auto ioff = pool.iranges.alloc(m.icnt * 3);
+    if (!ioff) {
+        pool.vranges.free(*voff, m.vcnt);
+        return false;
+    }
+
+    // One staging buffer for both ranges, indices right after vertices
+    VkDeviceSize vsize = static_cast<VkDeviceSize>(m.vcnt) * pool.stride;
+    VkDeviceSize isize = static_cast<VkDeviceSize>(m.icnt) * 3 * m.index_size();
+    VkBuffer staging_buf;
+    VkDeviceMemory staging_buf_memo;
+    create_buffer(vsize + isize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+        | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buf, staging_buf_memo);
+
+    void* data;
+    vkMapMemory(device, staging_buf_memo, 0, vsize + isize, 0, &data);
+    auto dst = static_cast<char*>(data);
+    memcpy(dst, m.vbuf, vsize);
+    if (m.index_type == VK_INDEX_TYPE_UINT16)
+        simd::narrow_u32_to_u16(m.ibuf, reinterpret_cast<uint16_t*>(dst + vsize), m.icnt * 3);
+    else
+        memcpy(dst + vsize, m.ibuf, isize);
+    vkUnmapMemory(device, staging_buf_memo);
+
+    auto cmd_buf = begin_single_time_commands();
+    VkBufferCopy regions[] = {
+        {.srcOffset = 0, .dstOffset = *voff * pool.stride, .size = vsize},
+        {.srcOffset = vsize, .dstOffset = *ioff * m.index_size(), .size = isize}
+    };
+    vkCmdCopyBuffer(cmd_buf, staging_buf, pool.vbuf, 1, &regions[0]);
+    vkCmdCopyBuffer(cmd_buf, staging_buf, pool.ibuf, 1, &regions[1]);
+    end_single_time_commands(cmd_buf);
+    delete_buffer(staging_buf, staging_buf_memo);
+
+    mgpu.vbuf = pool.vbuf;
+    mgpu.vbuf_memo = pool.vbuf_memo;
+    mgpu.ibuf = pool.ibuf;
+    mgpu.ibuf_memo = pool.ibuf_memo;
+    mgpu.vcnt = m.vcnt;
+    mgpu.icnt = m.icnt;
+    mgpu.index_type = m.index_type;
+    mgpu.pool_key = key;
+    mgpu.first_index = *ioff;
+    mgpu.vertex_offset = *voff;
     return true;
 }
 
+void VkWrappedInstance::destroy_mesh_gpu(MeshGPU& mesh) {
+    if (mesh.pooled()) {
+        auto& pool = geometry_pools.at(mesh.pool_key);
+        pool.vranges.free(mesh.vertex_offset, mesh.vcnt);
+        pool.iranges.free(mesh.first_index, mesh.icnt * 3);
+    }
+    else {
+        vkDestroyBuffer(device, mesh.vbuf, nullptr);
+        vkFreeMemory(device, mesh.vbuf_memo, nullptr);
+        vkDestroyBuffer(device, mesh.ibuf, nullptr);
+        vkFreeMemory(device, mesh.ibuf_memo, nullptr);
+    }
+
+    if (mesh.meshlet_buf != VK_NULL_HANDLE) {
+        vkDestroyBuffer(device, mesh.meshlet_buf, nullptr);
+        vkFreeMemory(device, mesh.meshlet_memo, nullptr);
+    }
+    for (int i = 0; i < mesh.indirect_bufs.size(); ++i) {
+        vkDestroyBuffer(device, mesh.indirect_bufs[i], nullptr);
+        vkFreeMemory(device, mesh.indirect_memos[i], nullptr);
+    }
+}
+
 }
\ No newline at end of file
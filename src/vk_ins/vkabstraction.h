@@ -1,11 +1,14 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <chrono>
 #include <filesystem>
 #include <functional>
+#include <future>
 #include <iostream>
 #include <span>
+#include <type_traits>
 #include <vector>
 #include <optional>
 #include <unordered_map>
@@ -20,8 +23,17 @@
 
 #include "concepts/mesh.h"
 #include "asset_mgr/mesh_mgr.h"
+#include "utils/deletion_queue.h"
+#include "utils/file_watcher.h"
+#include "utils/range_allocator.h"
+#include "vk_ins/bindless.h"
 #include "vk_ins/cmd_buf.h"
+#include "vk_ins/descriptor.h"
+#include "vk_ins/dynamic_state.h"
+#include "vk_ins/frame_scheduler.h"
+#include "vk_ins/pipeline_registry.h"
 #include "vk_ins/render_target.h"
+#include "vk_ins/sampler.h"
 #include "vk_ins/shader_mgr.h"
 
 namespace fs = std::filesystem;
@@ -54,6 +66,11 @@ struct Pixel {
     char a;
 };
 
+// Upper bound of set_frames_in_flight, a deeper queue only adds latency
+inline constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 3;
+
+// Called with the frame in flight index, the copy of every per frame
+// resource that is safe to write
 using UpdateCBK = std::function<void(uint32_t, float)>;
 
 struct UBO {
@@ -74,6 +91,7 @@ struct Texture {
     VkImageView                             view;
     VkImageLayout                           layout;
     VkDescriptorImageInfo                   descriptor;
+    // Owned by the instance's sampler cache
     VkSampler                               sampler;
 };
 
@@ -98,7 +116,63 @@ enum AttachmentType {
 struct Pipeline {
     VkPipeline                              pipeline;
     VkPipelineLayout                        ppl_layout;
+    // Owned by the instance's layout cache, shared with every pipeline
+    // declaring the same bindings
     VkDescriptorSetLayout                   descriptor_layout;
+    std::vector<VkDescriptorSetLayoutBinding>
+                                            bindings;
+    // Reflected resource name per binding, the pipeline's own copy of
+    // it is registered as "<pipeline>:<name>"
+    std::unordered_map<uint32_t, std::string>
+                                            resource_names;
+    // Layout has the bindless heap at set BINDLESS_SET
+    bool                                    bindless = false;
+    std::vector<VkPushConstantRange>        push_ranges;
+    // What the pipeline actually left dynamic, recording has to set these
+    std::vector<VkDynamicState>             dynamic_states;
+    // Shared with every pipeline of the same key, each holding a
+    // reference. pipeline stays VK_NULL_HANDLE while a requested build
+    // is still running
+    PipelineRegistry::Entry*                entry = nullptr;
+    // Drawn with instead until then, see get_pipeline
+    std::string                             fallback;
+
+    inline bool ready() const {
+        return pipeline != VK_NULL_HANDLE;
+    }
+
+    // Small per draw data straight into the command buffer, false when
+    // no push constant range of the layout covers it
+    inline bool push_raw(VkCommandBuffer cmd_buf, const void* data, const uint32_t size,
+        const uint32_t offset=0) const
+    {
+        auto stages = push_stages(push_ranges, offset, size);
+        if (stages == 0)
+            return false;
+        vkCmdPushConstants(cmd_buf, ppl_layout, stages, offset, size, data);
+        return true;
+    }
+
+    template <typename T>
+    inline bool push(VkCommandBuffer cmd_buf, const T& data, const uint32_t offset=0) const {
+        static_assert(std::is_trivially_copyable_v<T>, "Push constants are copied bytewise");
+        return push_raw(cmd_buf, &data, sizeof(T), offset);
+    }
+};
+
+// Shared vertex/index buffers for every mesh with the same vertex layout
+// and index type, meshes only own ranges in them so switching meshes
+// doesn't need a rebind
+struct GeometryPool {
+    VkBuffer                                vbuf;
+    VkDeviceMemory                          vbuf_memo;
+    VkBuffer                                ibuf;
+    VkDeviceMemory                          ibuf_memo;
+    uint32_t                                stride;
+    VkIndexType                             index_type;
+    // In vertices and indices, not bytes
+    RangeAllocator                          vranges;
+    RangeAllocator                          iranges;
 };
 
 struct MeshGPU {
@@ -106,11 +180,74 @@ struct MeshGPU {
     VkDeviceMemory                          vbuf_memo;
     VkBuffer                                ibuf;
     VkDeviceMemory                          ibuf_memo;
+    uint32_t                                vcnt = 0;
     uint32_t                                icnt = 0;
+    VkIndexType                             index_type = VK_INDEX_TYPE_UINT32;
+    // Mesh space bounding sphere, kept for culling
+    glm::vec4                               bounds{0.f};
+
+    // Set when the mesh lives in a geometry pool, vbuf and ibuf are then
+    // the pool's buffers and not owned by the mesh
+    std::string                             pool_key;
+    uint32_t                                first_index = 0;
+    int32_t                                 vertex_offset = 0;
+
+    inline bool pooled() const {
+        return !pool_key.empty();
+    }
+
+    // Meshlet path, only populated when the mesh has meshlets built.
+    // Bounds live in a storage buffer for shaders that want them, the
+    // indirect commands are per frame in flight since culling rewrites
+    // them every frame
+    std::vector<Meshlet>                    meshlets;
+    VkBuffer                                meshlet_buf = VK_NULL_HANDLE;
+    VkDeviceMemory                          meshlet_memo = VK_NULL_HANDLE;
+    std::vector<VkBuffer>                   indirect_bufs;
+    std::vector<VkDeviceMemory>             indirect_memos;
+    uint32_t                                max_draw_cnt = 1;
 
     void sync(const Mesh& mesh, VkWrappedInstance* ins);
+    void sync_meshlets(const Mesh& mesh, VkWrappedInstance* ins);
+    uint32_t cull_meshlets(const uint32_t idx, const glm::mat4& model, const Camera& cam,
+        VkWrappedInstance* ins) const;
+    void emit_bind_cmd(VkCommandBuffer cmd_buf) const;
+    void emit_draw_only_cmd(VkCommandBuffer cmd_buf, const uint32_t first_instance=0) const;
     void emit_draw_cmd(VkCommandBuffer cmd_buf, VkPipelineLayout ppl_layout,
         const VkDescriptorSet* desc_set=nullptr) const;
+    void emit_meshlet_draw_cmd(VkCommandBuffer cmd_buf, const uint32_t idx,
+        VkPipelineLayout ppl_layout, const VkDescriptorSet* desc_set=nullptr) const;
+};
+
+// Depth targets shadow passes render into. Cascades are layers of one
+// array image, spot and point lights share tiles of the atlas
+struct ShadowTargets {
+    VkFormat                                format = VK_FORMAT_UNDEFINED;
+    uint32_t                                cascade_res = 0;
+    uint32_t                                cascade_cnt = 0;
+    uint32_t                                atlas_size = 0;
+
+    VkImage                                 cascade_image = VK_NULL_HANDLE;
+    VkDeviceMemory                          cascade_memo = VK_NULL_HANDLE;
+    // Whole array for sampling, one view per layer to render into
+    VkImageView                             cascade_view = VK_NULL_HANDLE;
+    std::vector<VkImageView>                cascade_layer_views;
+    std::vector<VkFramebuffer>              cascade_fbs;
+
+    VkImage                                 atlas_image = VK_NULL_HANDLE;
+    VkDeviceMemory                          atlas_memo = VK_NULL_HANDLE;
+    VkImageView                             atlas_view = VK_NULL_HANDLE;
+    VkFramebuffer                           atlas_fb = VK_NULL_HANDLE;
+
+    VkRenderPass                            render_pass = VK_NULL_HANDLE;
+    // Comparison sampler, lookups return the lit fraction
+    VkSampler                               sampler = VK_NULL_HANDLE;
+    VkDescriptorImageInfo                   cascade_descriptor{};
+    VkDescriptorImageInfo                   atlas_descriptor{};
+
+    inline bool created() const {
+        return render_pass != VK_NULL_HANDLE;
+    }
 };
 
 struct CameraGPU {
@@ -126,6 +263,9 @@ struct CameraGPU {
 
 struct PipelineOption {
     PipelineOption();
+    // Internal pointers follow the copy
+    PipelineOption(const PipelineOption& other);
+    PipelineOption& operator=(const PipelineOption& other);
 
     VkPipelineVertexInputStateCreateInfo    input_info;
     VkPipelineInputAssemblyStateCreateInfo  input_assembly;
@@ -137,6 +277,32 @@ struct PipelineOption {
     VkPipelineDepthStencilStateCreateInfo   depth_stencil;
     VkPipelineColorBlendAttachmentState     blend_attachment;
     VkPipelineColorBlendStateCreateInfo     blend_state;
+    // Bake the samplers of textures created with the pipeline into its
+    // descriptor layout, descriptor writes then only carry the views
+    bool                                    immutable_samplers = false;
+    // Left out of the pipeline and set while recording instead, viewport
+    // and scissor by default so pipelines survive resizes. Extended
+    // dynamic states are dropped when the device lacks the extension and
+    // the values above get baked in
+    std::vector<VkDynamicState>             dynamic_states{
+                                                VK_DYNAMIC_STATE_VIEWPORT,
+                                                VK_DYNAMIC_STATE_SCISSOR};
+
+    inline void add_dynamic_state(const VkDynamicState state) {
+        if (std::find(dynamic_states.begin(), dynamic_states.end(), state) == dynamic_states.end())
+            dynamic_states.push_back(state);
+    }
+
+    // Cull mode, front face and the depth test state, so one pipeline
+    // covers what used to be a permutation per combination
+    inline void add_extended_dynamic_states() {
+        for (auto state : {VK_DYNAMIC_STATE_CULL_MODE_EXT, VK_DYNAMIC_STATE_FRONT_FACE_EXT,
+            VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT, VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT,
+            VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT})
+        {
+            add_dynamic_state(state);
+        }
+    }
 
     inline void setup_input_assembly(const VkPrimitiveTopology topo, bool restart) {
         input_assembly.topology = topo;
@@ -258,6 +424,20 @@ public:
         return mem_props;
     }
 
+    inline const VkPhysicalDeviceProperties& get_physical_device_props() const {
+        return physical_device_props;
+    }
+
+    inline const VkPhysicalDeviceFeatures& get_enabled_features() const {
+        return enabled_features;
+    }
+
+    // Whether VK_EXT_descriptor_indexing got enabled, shaders using the
+    // bindless heap need BINDLESS_FALLBACK defined otherwise
+    inline bool descriptor_indexing_enabled() const {
+        return descriptor_indexing;
+    }
+
     inline auto get_window() {
         return window;
     }
@@ -282,6 +462,64 @@ public:
         return swapchain_cnt;
     }
 
+    // Number of frames the CPU may run ahead of the GPU, also the number
+    // of copies every UBO, SSBO and command buffer set gets. Only
+    // changeable before any of those exist
+    bool set_frames_in_flight(const uint32_t cnt);
+
+    inline uint32_t get_frames_in_flight() const {
+        return frames_in_flight;
+    }
+
+    inline uint32_t get_current_frame() const {
+        return frame_scheduler.get_slot();
+    }
+
+    // How many frames the GPU may still be working on when the CPU starts
+    // the next one, see FrameScheduler. Defaults to frames in flight
+    inline void set_frame_latency(const uint32_t latency) {
+        frame_scheduler.set_latency(latency);
+    }
+
+    inline const FrameStats& get_frame_stats() const {
+        return frame_scheduler.get_stats();
+    }
+
+    inline bool timeline_semaphore_enabled() const {
+        return timeline_semaphore;
+    }
+
+    inline bool extended_dynamic_state_enabled() const {
+        return extended_dynamic_state;
+    }
+
+    // Setters for the extended dynamic states, no-ops without the extension
+    inline const ExtendedDynamicState& get_dynamic_state_cmds() const {
+        return dynamic_state_cmds;
+    }
+
+    // Present mode and image count the swapchain asks for, both applied
+    // by the next swapchain creation, which they trigger when one exists.
+    // Unsupported modes fall back to FIFO, counts are clamped to what the
+    // surface allows and 0 means minImageCount + 1
+    void set_present_mode(const VkPresentModeKHR mode);
+    void set_swapchain_image_cnt(const uint32_t cnt);
+
+    inline VkPresentModeKHR get_present_mode() const {
+        return present_mode;
+    }
+
+    // Destroys through deleter once every frame submitted so far is done
+    // on the GPU, for resources those frames may still use
+    inline void defer_delete(std::function<void()>&& deleter) {
+        deletion_queue.push(frame_scheduler.last_submitted(), std::move(deleter));
+    }
+
+    // Sleeps in draw_frame to stay at or below fps, 0 disables it
+    inline void set_frame_limit(const double fps) {
+        frame_limiter.set_fps(fps);
+    }
+
     inline auto get_swapchain_format() {
         return swapchain_surface_format;
     }
@@ -324,7 +562,10 @@ public:
         VkMemoryPropertyFlags props, VkBuffer &buf, VkDeviceMemory& buf_memo) const;
     void copy_buffer(VkBuffer src_buf, VkBuffer dst_buf, VkDeviceSize size);
     void create_vertex_buffer(const float *, VkBuffer&, VkDeviceMemory&, size_t, size_t);
-    void create_index_buffer(const uint32_t*, VkBuffer&, VkDeviceMemory&, size_t);
+    void create_index_buffer(const uint32_t*, VkBuffer&, VkDeviceMemory&, size_t,
+        VkIndexType=VK_INDEX_TYPE_UINT32);
+    void create_device_local_buffer(const void*, VkDeviceSize, VkBufferUsageFlags,
+        VkBuffer&, VkDeviceMemory&);
     void create_color_resource(const VkFormat format);
     void create_depth_resource();
 
@@ -351,6 +592,8 @@ public:
 
     void create_descriptors(const ShaderModulesDeprecated& modules);
     void alloc_commandbuffers(std::vector<VkCommandBuffer>& bufs);
+    // Keeps emit_func and fbs, draw_frame records cmd_bufs[frame] for the
+    // acquired image each frame and calls emit_func with the frame index
     void record_cmds(std::vector<VkCommandBuffer>& cmd_bufs, std::vector<VkFramebuffer>& fbs,
         const std::function<void(uint32_t)>& emit_func);
     void create_sync_objects();
@@ -368,7 +611,8 @@ public:
     std::unique_ptr<char[]> get_image_buffer(const RenderTarget& rt) const;
     std::pair<VkBuffer, VkDeviceMemory> load_into_staging_buffer(void* data, uint32_t size) const;
     void delete_buffer(VkBuffer buf, VkDeviceMemory memo) const;
-    void sync_uniform(VkDeviceMemory memo, const void* data, uint32_t size) const;
+    void sync_uniform(VkDeviceMemory memo, const void* data, uint32_t size,
+        uint32_t offset=0) const;
 
 private:
     // Private methods
@@ -394,6 +638,29 @@ private:
         app->framebuffer_resized = true;
     }
 
+    void record_frame_cmds(const uint32_t frame, const uint32_t image_idx);
+    void create_present_semaphores();
+    PipelineRegistry::Entry* register_pipeline(const std::string& name, std::vector<ShaderModule>& modules,
+        const std::vector<VERT_COMP>& comps, PipelineOption& option, const bool lazy,
+        const std::string& fallback, const Pipeline* replacing=nullptr);
+    // Lets go of a pipeline's registry entry, the last user destroys it
+    // once the frames submitted so far are done
+    void release_pipeline_entry(PipelineRegistry::Entry* entry);
+    // Sets referring to handle leave the cache now and go back to their
+    // page once the frames submitted so far are done
+    template <typename H>
+    inline void forget_descriptor_sets(H handle) {
+        auto dropped = set_cache.forget(handle);
+        if (dropped.empty())
+            return;
+        defer_delete([this, dropped = std::move(dropped)]() {
+            for (auto set : dropped)
+                descriptor_allocator.free(device, set);
+        });
+    }
+    // The module's file and every header it includes
+    void watch_shader(const ShaderModule& mod);
+
     bool check_device_extension_support(const std::span<const char*> extensions) const;
 
     VkSurfaceFormatKHR choose_swap_surface_format(const std::vector<VkSurfaceFormatKHR>& available_formats) const;
@@ -434,6 +701,34 @@ private:
     VkPhysicalDevice physical_device = VK_NULL_HANDLE;
     VkPhysicalDeviceProperties physical_device_props;
     VkPhysicalDeviceMemoryProperties mem_props;
+    VkPhysicalDeviceFeatures enabled_features{};
+    bool descriptor_indexing = false;
+    bool timeline_semaphore = false;
+    fs::path pipeline_cache_path;
+
+    // What a pipeline got created from, kept for hot reload only
+    struct PipelineSource {
+        std::vector<ShaderModule>           modules;
+        std::vector<VERT_COMP>              comps;
+        PipelineOption                      option;
+    };
+
+    struct ShaderReload {
+        std::string                         pipeline;
+        size_t                              module_idx;
+        std::future<std::optional<ShaderModule>>
+                                            result;
+    };
+
+    bool hot_reload = false;
+    FileWatcher shader_watcher;
+    std::unordered_map<std::string, PipelineSource> pipeline_sources;
+    std::vector<ShaderReload> shader_reloads;
+    // Rebuilt pipelines waiting for their build
+    std::unordered_map<std::string, Pipeline> pipeline_swaps;
+    bool extended_dynamic_state = false;
+    ExtendedDynamicState dynamic_state_cmds;
+    VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexing_props{};
     VkDevice device;
 
     // Surface
@@ -447,12 +742,16 @@ private:
     bool    queue_created = false;
 
     // SwapChain related
-    VkSwapchainKHR                  swapchain;
+    VkSwapchainKHR                  swapchain = VK_NULL_HANDLE;
     std::vector<VkImage>            swapchain_images;
     SwapChainSupportDetails         swapchain_details;
     VkSurfaceFormatKHR              swapchain_surface_format;
     VkExtent2D                      swapchain_extent;
     bool                            swapchain_created = false;
+    // Asked for by set_present_mode, mailbox over FIFO when unset
+    std::optional<VkPresentModeKHR> preferred_present_mode;
+    VkPresentModeKHR                present_mode = VK_PRESENT_MODE_FIFO_KHR;
+    uint32_t                        preferred_image_cnt = 0;
 
     std::vector<VkImageView>        swapchain_imageviews;
     bool                            imageviews_created = false;
@@ -474,12 +773,18 @@ private:
     // Semaphore and fences
     std::vector<VkSemaphore>        image_available_semaphores;
     std::vector<VkSemaphore>        render_finished_semaphores;
-    std::vector<VkFence>            in_flight_fences;
-    std::vector<VkFence>            images_in_flight;
     bool                            syncobj_created = false;
 
     // Frame related
-    size_t                          current_frame = 0;
+    uint32_t                        frames_in_flight = 2;
+    FrameScheduler                  frame_scheduler;
+    FrameLimiter                    frame_limiter;
+    DeletionQueue                   deletion_queue;
+
+    // Set by record_cmds, replayed for every frame
+    std::vector<VkCommandBuffer>*   record_bufs = nullptr;
+    std::vector<VkFramebuffer>*     record_fbs = nullptr;
+    std::function<void(uint32_t)>   record_func;
 
     // Cannot delete the two field here for now or it will cause a weird
     // render bug, I believe it's relavent to data padding since these two
@@ -517,12 +822,77 @@ public:
 public:
     bool add_ubo(const std::string& name, const uint32_t binding,
         uint32_t size, uint32_t vecsize=1);
+    // Host visible storage buffers, one per frame in flight like UBOs
+    bool add_ssbo(const std::string& name, const uint32_t binding,
+        uint32_t size, uint32_t vecsize=1);
+    void remove_ssbo(const std::string& name);
     bool add_texture(const std::string& name, const uint32_t binding,
         const fs::path& path);
     bool add_cubemap(const std::string& name, const uint32_t binding,
         const fs::path& path);
+    // Pipelines matching an existing one in shaders, state, vertex layout
+    // and render pass share its VkPipeline and layout. Each module's
+    // spec_values specialize its stage, modules copied from one load and
+    // specialized differently give variants without compiling GLSL again
     bool create_pipeline(const std::string&, std::vector<ShaderModule>&,
         const std::vector<VERT_COMP>&, PipelineOption& option);
+    // Same as create_pipeline but the driver compile runs on the thread
+    // pool, only reflection and layout creation happen here. The pipeline
+    // is usable once poll_pipelines picked it up and fallback is what
+    // get_pipeline hands out until then, it needs the same descriptor
+    // layout for sets to stay valid. Invalid handle when refused
+    PipelineHandle create_pipeline_async(const std::string&, std::vector<ShaderModule>&,
+        const std::vector<VERT_COMP>&, PipelineOption& option,
+        const std::string& fallback="");
+    // Picks up finished background builds and swaps reloaded pipelines
+    // in, draw_frame calls it every frame
+    void poll_pipelines();
+
+    // Watches the shader files of pipelines created from now on, headers
+    // they include as well. Changed modules are recompiled on the thread
+    // pool and their pipelines rebuilt and swapped in at a frame boundary,
+    // a shader that doesn't compile or changes the pipeline's resources
+    // leaves the old pipeline in place
+    inline void enable_shader_hot_reload(const bool enable=true) {
+        hot_reload = enable;
+    }
+
+    // Queues recompiles for changed shaders and rebuilds pipelines whose
+    // recompile finished, draw_frame calls it every frame
+    void poll_shader_reloads();
+
+    // Pipeline to draw name with, its fallback while it's still building
+    // and nullptr when neither is ready
+    inline const Pipeline* get_pipeline(const std::string& name) const {
+        auto found = pipelines.find(name);
+        if (found == pipelines.end())
+            return nullptr;
+        if (found->second.ready())
+            return &found->second;
+        if (found->second.fallback.empty() || found->second.fallback == name)
+            return nullptr;
+        auto fallback = pipelines.find(found->second.fallback);
+        if (fallback == pipelines.end() || !fallback->second.ready())
+            return nullptr;
+        return &fallback->second;
+    }
+
+    inline bool pipeline_ready(const std::string& name) const {
+        auto found = pipelines.find(name);
+        return found != pipelines.end() && found->second.ready();
+    }
+
+    inline const PipelineRegistry& get_pipeline_registry() const {
+        return pipeline_registry;
+    }
+
+    // Pipeline cache loaded at device creation and written back on
+    // destruction, set before init
+    inline void set_pipeline_cache_path(const fs::path& path) {
+        pipeline_cache_path = path;
+    }
+
+    bool save_pipeline_cache() const;
 
     bool create_render_target(const std::string&, const VkFormat,
         const VkSampleCountFlagBits=VK_SAMPLE_COUNT_1_BIT,
@@ -536,11 +906,74 @@ public:
 
     bool create_framebuffer_from_targets(const std::string&);
 
+    // Set for frame in flight idx with every binding of the pipeline filled
+    // from ubos, ssbos, textures and bound images, resources named
+    // "<pipeline>:<name>" win over others on the same binding. Sets are
+    // shared by pipelines with the same layout and resources, nothing is
+    // allocated when one already exists
+    VkDescriptorSet get_descriptor_set(const std::string& ppl_name, const uint32_t idx);
+    // What get_descriptor_set writes into that set, false when a binding
+    // has no resource or several candidates
+    bool get_descriptor_bindings(const std::string& ppl_name, const uint32_t idx,
+        std::vector<DescriptorBinding>& bindings);
+    // Images owned elsewhere, e.g. shadow maps, that descriptor sets pick
+    // up by binding number
+    void bind_image(const uint32_t binding, const VkDescriptorImageInfo& info);
+
+    // Descriptor arrays pipelines reach at set BINDLESS_SET when their
+    // shaders declare it, create it before such pipelines. Counts are
+    // clamped to the device limits, without descriptor indexing they are
+    // ignored and the arrays are always BINDLESS_FALLBACK_* long. False
+    // when the device can't index descriptor arrays dynamically
+    bool create_bindless_heap(const uint32_t image_cnt=4096, const uint32_t buffer_cnt=1024);
+    // Heap slot of a texture loaded with add_texture, BINDLESS_NONE when
+    // missing or the heap is full
+    uint32_t add_bindless_texture(const std::string& name);
+    uint32_t add_bindless_ssbo(const std::string& name, const uint32_t idx);
+    // The slot is handed out again once the frames submitted so far are
+    // done, they may still read it. False for slots not in use
+    bool remove_bindless_texture(const uint32_t slot);
+    bool remove_bindless_ssbo(const uint32_t slot);
+
+    // Depth only render targets and render pass for shadow maps, created
+    // again from scratch when called twice
+    bool create_shadow_targets(const uint32_t cascade_res, const uint32_t cascade_cnt,
+        const uint32_t atlas_size);
+    void destroy_shadow_targets();
+    // Depth only pipeline against the shadow render pass. Only the position
+    // attribute is fetched, the mvp comes in as a mat4 push constant and
+    // viewport, scissor and depth bias are dynamic. Single sampled whatever
+    // option asks for, built and shared through the pipeline registry
+    bool create_shadow_pipeline(const std::string&, std::vector<ShaderModule>&,
+        const std::vector<VERT_COMP>&, PipelineOption& option);
+
     bool load_mesh(const std::string&, const Mesh&);
+    bool unload_mesh(const std::string&);
+    // Binds buffers only when they change, meshes sharing a geometry pool
+    // end up with one bind for the whole batch
+    void emit_mesh_draw_cmds(VkCommandBuffer cmd_buf, const std::vector<std::string>& names,
+        VkPipelineLayout ppl_layout, const VkDescriptorSet* desc_set=nullptr) const;
+
+    inline void setup_geometry_pool_size(const uint32_t vcnt, const uint32_t icnt) {
+        pool_vertex_cnt = vcnt;
+        pool_index_cnt = icnt;
+    }
+
+    static std::string get_geometry_pool_key(const std::vector<VERT_COMP>&, const VkIndexType);
+
+private:
+    bool upload_to_geometry_pool(const Mesh&, MeshGPU&);
+    void destroy_mesh_gpu(MeshGPU&);
+
+    // Pools are created lazily and never grow, growing would invalidate
+    // the command buffers already recorded against them
+    uint32_t                                            pool_vertex_cnt = 1 << 20;
+    uint32_t                                            pool_index_cnt = 1 << 22;
 
 public:
     // Vulkan resources
     std::unordered_map<std::string, UBO>                ubos;
+    std::unordered_map<std::string, UBO>                ssbos;
     std::unordered_map<std::string, Texture>            textures;
     std::unordered_map<std::string, Pipeline>           pipelines;
     std::unordered_map<std::string, RenderTarget>       render_targets;
@@ -553,6 +986,17 @@ public:
                                                         attachment_descs;
 
     std::unordered_map<std::string, MeshGPU>            meshes;
+    std::unordered_map<std::string, GeometryPool>       geometry_pools;
+
+    ShadowTargets                                       shadow_targets;
+    BindlessHeap                                        bindless;
+
+    std::unordered_map<uint32_t, VkDescriptorImageInfo> bound_images;
+    SamplerCache                                        sampler_cache;
+    DescriptorLayoutCache                               layout_cache;
+    PipelineRegistry                                    pipeline_registry;
+    DescriptorAllocator                                 descriptor_allocator;
+    DescriptorSetCache                                  set_cache;
 };
 
 }
\ No newline at end of file
@@ -42,8 +42,7 @@ TextureDeprecated::TextureDeprecated(TextureDeprecated&& t)
 void TextureDeprecated::free_gpu_resources() {
     vkDestroyImageView(instance->get_device(), view, nullptr);
     vkDestroyImage(instance->get_device(), image, nullptr);
-    if (sampler)
-        vkDestroySampler(instance->get_device(), sampler, nullptr);
+    // The sampler belongs to the instance's cache
 
     vkFreeMemory(instance->get_device(), memory, nullptr);
     loaded = false;
@@ -134,26 +133,8 @@ bool TextureDeprecated::load_image(const fs::path& path) {
     if (vkCreateImageView(instance->get_device(), &view_info, nullptr, &view) != VK_SUCCESS)
         throw std::runtime_error(fmt::format("failed to create imageview for texture {}", name));
 
-    // Create sampler
-    VkSamplerCreateInfo sampler_info{};
-    sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-    sampler_info.magFilter = VK_FILTER_LINEAR;
-    sampler_info.minFilter = VK_FILTER_LINEAR;
-    sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-    sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    sampler_info.mipLodBias = 0.f;
-    sampler_info.compareEnable = VK_FALSE;
-    sampler_info.compareOp = VK_COMPARE_OP_ALWAYS;
-    sampler_info.minLod = 0.f;
-    sampler_info.maxLod = 0.f;
-    sampler_info.maxAnisotropy = 1.f;
-    sampler_info.anisotropyEnable = false;
-    sampler_info.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-    sampler_info.unnormalizedCoordinates = VK_FALSE;
-    if (vkCreateSampler(instance->get_device(), &sampler_info, nullptr, &sampler) != VK_SUCCESS)
-        throw std::runtime_error(fmt::format("failed to create sampler for texture {}", name));
+    // Create sampler, shared with every texture using the same parameters
+    sampler = instance->sampler_cache.get(instance->get_device(), default_sampler_info());
 
     update_descriptor();
 
@@ -261,25 +242,7 @@ bool TextureDeprecated::load_cubemap(const fs::path& path) {
         throw std::runtime_error(fmt::format("failed to create imageview for cubemap"));
 
     // sampler
-    VkSamplerCreateInfo sampler_info{};
-    sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-    sampler_info.magFilter = VK_FILTER_LINEAR;
-    sampler_info.minFilter = VK_FILTER_LINEAR;
-    sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-    sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    sampler_info.mipLodBias = 0.f;
-    sampler_info.compareEnable = VK_FALSE;
-    sampler_info.compareOp = VK_COMPARE_OP_ALWAYS;
-    sampler_info.minLod = 0.f;
-    sampler_info.maxLod = 0.f;
-    sampler_info.maxAnisotropy = 1.f;
-    sampler_info.anisotropyEnable = false;
-    sampler_info.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-    sampler_info.unnormalizedCoordinates = VK_FALSE;
-    if (vkCreateSampler(instance->get_device(), &sampler_info, nullptr, &sampler) != VK_SUCCESS)
-        throw std::runtime_error(fmt::format("failed to create sampler for texture {}", name));
+    sampler = instance->sampler_cache.get(instance->get_device(), default_sampler_info());
 
     update_descriptor();
 
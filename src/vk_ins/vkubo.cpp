@@ -13,7 +13,7 @@ UBODeprecated::UBODeprecated(VkWrappedInstance* ins, const VkShaderStageFlagBits
 {
     cpu_buf = std::make_unique<char[]>(size * vecsize);
 
-    auto cnt = ins->get_swapchain_cnt();
+    auto cnt = ins->get_frames_in_flight();
     gpu_bufs.resize(cnt);
     memos.resize(cnt);
     descriptors.resize(cnt);
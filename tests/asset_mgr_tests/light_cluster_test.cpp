@@ -0,0 +1,114 @@
+#include <cmath>
+#include <random>
+
+#include <catch2/catch_all.hpp>
+
+#include "asset_mgr/light_cluster.h"
+
+static vkkk::Camera make_camera() {
+    vkkk::Camera cam{};
+    cam.pos = glm::vec3(0.f, 0.f, 5.f);
+    cam.front = glm::vec3(0.f, 0.f, -1.f);
+    cam.up = glm::vec3(0.f, 1.f, 0.f);
+    cam.fov = 60.f;
+    cam.ratio = 16.f / 9.f;
+    cam.near = 0.1f;
+    cam.far = 100.f;
+    return cam;
+}
+
+static bool listed(const vkkk::LightCluster& lc, uint32_t cluster, uint32_t light) {
+    auto range = lc.get_ranges()[cluster];
+    for (uint32_t i = range.x; i < range.x + range.y; ++i)
+        if (lc.get_indices()[i] == light)
+            return true;
+    return false;
+}
+
+TEST_CASE("Light cluster binning test", "[single-file]") {
+    auto cam = make_camera();
+    vkkk::LightCluster lc;
+
+    std::vector<vkkk::PointLight> pts;
+    // Straight ahead, behind the camera and past the far plane
+    pts.push_back({glm::vec4(0.f, 0.f, 0.f, 1.f), glm::vec4(1.f), glm::vec4(1.f, 0.f, 0.f, 0.f)});
+    pts.push_back({glm::vec4(0.f, 0.f, 10.f, 1.f), glm::vec4(1.f), glm::vec4(1.f, 0.f, 0.f, 0.f)});
+    pts.push_back({glm::vec4(0.f, 0.f, -200.f, 1.f), glm::vec4(1.f), glm::vec4(1.f, 0.f, 0.f, 0.f)});
+
+    std::vector<vkkk::SpotLight> spots;
+    spots.push_back({glm::vec4(2.f, 1.f, 0.f, 1.f), glm::vec4(0.f, 0.f, -1.f, 0.f),
+        glm::vec3(1.f), 30.f, glm::vec4(2.f, 0.f, 0.f, 0.f)});
+
+    lc.build(cam, 1920, 1080, pts, spots, 2);
+
+    REQUIRE(lc.get_info().dims == glm::uvec4(CLUSTER_X, CLUSTER_Y, CLUSTER_Z, 2));
+    REQUIRE(lc.get_ranges().size() == lc.cluster_cnt());
+
+    // The cluster holding the center of light 0, screen center at depth 5
+    auto slice = lc.slice_of(5.f);
+    auto center = lc.cluster_index(CLUSTER_X / 2, CLUSTER_Y / 2, slice);
+    REQUIRE(listed(lc, center, 0));
+
+    bool behind = false, beyond = false, spot = false;
+    for (auto idx : lc.get_indices()) {
+        behind |= idx == 1;
+        beyond |= idx == 2;
+        spot |= idx == (0 | LIGHT_SPOT_FLAG);
+    }
+    REQUIRE_FALSE(behind);
+    REQUIRE_FALSE(beyond);
+    REQUIRE(spot);
+
+    // Slices have to grow with depth and cover [near, far]
+    REQUIRE(lc.slice_of(cam.near) == 0);
+    REQUIRE(lc.slice_of(cam.far) == CLUSTER_Z - 1);
+    for (float d = 0.2f; d < 90.f; d *= 1.3f)
+        REQUIRE(lc.slice_of(d) <= lc.slice_of(d * 1.3f));
+}
+
+TEST_CASE("Light cluster coverage test", "[single-file]") {
+    auto cam = make_camera();
+    vkkk::LightCluster lc;
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> xy(-20.f, 20.f);
+    std::uniform_real_distribution<float> z(-60.f, 8.f);
+    std::uniform_real_distribution<float> radius(0.2f, 6.f);
+    std::uniform_real_distribution<float> unit(-1.f, 1.f);
+
+    std::vector<vkkk::PointLight> pts;
+    for (int i = 0; i < 300; ++i)
+        pts.push_back({glm::vec4(xy(rng), xy(rng), z(rng), 1.f), glm::vec4(1.f),
+            glm::vec4(radius(rng), 0.f, 0.f, 0.f)});
+
+    // Tiles don't divide this extent evenly
+    const uint32_t width = 1000, height = 700;
+    lc.build(cam, width, height, pts, {});
+    auto& info = lc.get_info();
+
+    // Every visible point inside a light's range has to find the light in
+    // the cluster the shader would pick for it
+    uint32_t checked = 0;
+    for (uint32_t i = 0; i < pts.size(); ++i) {
+        glm::vec3 c(info.view * pts[i].pos);
+        for (int s = 0; s < 64; ++s) {
+            glm::vec3 p = c + glm::vec3(unit(rng), unit(rng), unit(rng)) * pts[i].params.x * 0.577f;
+            float depth = -p.z;
+            if (depth < cam.near || depth > cam.far)
+                continue;
+
+            float nx = p.x / (depth * std::tan(glm::radians(cam.fov) * 0.5f) * cam.ratio);
+            float ny = -p.y / (depth * std::tan(glm::radians(cam.fov) * 0.5f));
+            if (std::abs(nx) >= 1.f || std::abs(ny) >= 1.f)
+                continue;
+
+            uint32_t tx = static_cast<uint32_t>((nx + 1.f) * 0.5f * width / info.tile_size.x);
+            uint32_t ty = static_cast<uint32_t>((ny + 1.f) * 0.5f * height / info.tile_size.y);
+            REQUIRE(listed(lc, lc.cluster_index(tx, ty, lc.slice_of(depth)), i));
+            ++checked;
+        }
+    }
+    REQUIRE(checked > 1000);
+    // Culling has to actually cull, a cluster sees a small share of the lights
+    REQUIRE(lc.get_indices().size() < pts.size() * lc.cluster_cnt() / 20);
+}
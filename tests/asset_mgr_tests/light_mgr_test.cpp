@@ -0,0 +1,67 @@
+#include <catch2/catch_all.hpp>
+
+#include "asset_mgr/light_mgr.h"
+
+TEST_CASE("Light change log test", "[single-file]") {
+    vkkk::LightChangeLog log;
+    REQUIRE(log.get_version() == 0);
+
+    auto empty = log.changed_since(0);
+    REQUIRE(empty.x >= empty.y);
+
+    log.mark(0, 1);
+    log.mark(5, 6);
+    auto v = log.get_version();
+    REQUIRE(log.changed_since(0) == glm::uvec2(0, 6));
+    REQUIRE(log.changed_since(1) == glm::uvec2(5, 6));
+
+    // A copy synced at v only sees what came after
+    log.mark(3, 4);
+    REQUIRE(log.changed_since(v) == glm::uvec2(3, 4));
+    auto none = log.changed_since(log.get_version());
+    REQUIRE(none.x >= none.y);
+
+    // Folding keeps the log bounded but must not hide changes
+    vkkk::LightChangeLog big;
+    for (uint32_t i = 0; i < 1000; ++i)
+        big.mark(i, i + 1);
+    REQUIRE(big.entry_cnt() <= vkkk::LightChangeLog::capacity);
+    REQUIRE(big.changed_since(0) == glm::uvec2(0, 1000));
+    REQUIRE(big.changed_since(998) == glm::uvec2(998, 1000));
+    for (uint64_t since = 0; since < 1000; since += 37) {
+        auto range = big.changed_since(since);
+        REQUIRE(range.x <= since);
+        REQUIRE(range.y == 1000);
+    }
+}
+
+TEST_CASE("Light manager dirty range test", "[single-file]") {
+    auto& mgr = vkkk::LightMgr::instance();
+    mgr.clear();
+
+    for (int i = 0; i < 100; ++i)
+        mgr.add_pt_light(glm::vec4(i, 0, 0, 1), glm::vec4(1), 5.f);
+    mgr.add_spot_light(glm::vec4(0, 4, 0, 1), glm::vec4(0, -1, 0, 0), glm::vec3(1), 10.f);
+
+    REQUIRE(mgr.light_cnt(vkkk::PT_LIGHT) == 100);
+    REQUIRE(mgr.dirty_range(vkkk::PT_LIGHT, vkkk::NEVER_SYNCED) == glm::uvec2(0, 100));
+
+    // Pretend a copy synced everything, then touch two lights
+    auto synced = mgr.get_log(vkkk::PT_LIGHT).get_version();
+    auto spot_synced = mgr.get_log(vkkk::SPOT_LIGHT).get_version();
+    mgr.set_pt_light(40, glm::vec4(0, 1, 0, 1), glm::vec4(1), 5.f);
+    mgr.set_pt_light(42, glm::vec4(0, 2, 0, 1), glm::vec4(1), 5.f);
+    REQUIRE(mgr.dirty_range(vkkk::PT_LIGHT, synced) == glm::uvec2(40, 43));
+
+    // Other types are untouched
+    auto spot = mgr.dirty_range(vkkk::SPOT_LIGHT, spot_synced);
+    REQUIRE(spot.x >= spot.y);
+
+    REQUIRE_THROWS(mgr.set_dir_light(0, glm::vec4(1, 0, 0, 0), glm::vec4(1)));
+
+    // Clearing marks the old slots so fixed layouts can zero them
+    synced = mgr.get_log(vkkk::PT_LIGHT).get_version();
+    mgr.clear();
+    REQUIRE(mgr.light_cnt(vkkk::PT_LIGHT) == 0);
+    REQUIRE(mgr.dirty_range(vkkk::PT_LIGHT, synced) == glm::uvec2(0, 100));
+}
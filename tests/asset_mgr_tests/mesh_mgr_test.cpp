@@ -0,0 +1,121 @@
+#include <memory>
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+
+#include "asset_mgr/mesh_mgr.h"
+
+using namespace vkkk;
+
+// Positions only, vertex i sits at (first + i, 0, 0)
+static aiMesh* make_mesh(const uint32_t n, const float first=0.f) {
+    auto mesh = new aiMesh;
+    mesh->mNumVertices = n;
+    mesh->mVertices = new aiVector3D[n];
+    for (uint32_t i = 0; i < n; ++i)
+        mesh->mVertices[i] = aiVector3D(first + i, 0.f, 0.f);
+    return mesh;
+}
+
+static aiMatrix4x4 translation(const float x, const float y, const float z) {
+    aiMatrix4x4 m;
+    aiMatrix4x4::Translation(aiVector3D(x, y, z), m);
+    return m;
+}
+
+static aiNode* make_node(const char* name, const std::vector<uint32_t>& meshes,
+    const aiMatrix4x4& transform, const std::vector<aiNode*>& children={})
+{
+    auto node = new aiNode(name);
+    node->mTransformation = transform;
+    node->mNumMeshes = meshes.size();
+    node->mMeshes = new uint32_t[meshes.size()];
+    std::copy(meshes.begin(), meshes.end(), node->mMeshes);
+    node->mNumChildren = children.size();
+    node->mChildren = new aiNode*[children.size()];
+    for (size_t i = 0; i < children.size(); ++i) {
+        children[i]->mParent = node;
+        node->mChildren[i] = children[i];
+    }
+    return node;
+}
+
+// The scene owns everything handed to it
+static aiScene* make_scene(const std::vector<aiMesh*>& meshes, aiNode* root) {
+    auto scene = new aiScene;
+    scene->mNumMeshes = meshes.size();
+    scene->mMeshes = new aiMesh*[meshes.size()];
+    std::copy(meshes.begin(), meshes.end(), scene->mMeshes);
+    scene->mRootNode = root;
+    return scene;
+}
+
+TEST_CASE("Mesh manager scene test", "[single-file]") {
+    auto& mgr = MeshMgr::instance();
+    const std::vector<VERT_COMP> comps{VERTEX};
+
+    // root (mesh 0) -> arm, translated by x 1 (meshes 1, 2) -> hand,
+    // translated by y 2 (mesh 0 again), plus an unnamed sibling of arm
+    auto hand = make_node("hand", {0}, translation(0.f, 2.f, 0.f));
+    auto arm = make_node("arm", {1, 2}, translation(1.f, 0.f, 0.f), {hand});
+    auto unnamed = make_node("", {2}, aiMatrix4x4());
+    auto root = make_node("root", {0}, aiMatrix4x4(), {arm, unnamed});
+    std::unique_ptr<aiScene> scene(make_scene({make_mesh(3), make_mesh(4, 10.f),
+        make_mesh(5, 20.f)}, root));
+    mgr.load_scene(scene.get(), "robot", comps);
+
+    // Keys follow the node tree, depth first in node order
+    const std::vector<std::string> expected{
+        "robot:0",
+        "robot/arm.0:0",
+        "robot/arm.0:1",
+        "robot/arm.0/hand.0:0",
+        "robot/node.1:0"
+    };
+    REQUIRE(mgr.get_keys("robot") == expected);
+
+    // Meshes land under their own key whichever worker converted them
+    REQUIRE(mgr.get_mesh("robot:0")->vcnt == 3);
+    REQUIRE(mgr.get_mesh("robot/arm.0:0")->vcnt == 4);
+    REQUIRE(mgr.get_mesh("robot/arm.0:0")->vbuf[0] == 10.f);
+    REQUIRE(mgr.get_mesh("robot/arm.0:1")->vcnt == 5);
+    REQUIRE(mgr.get_mesh("robot/arm.0/hand.0:0")->vcnt == 3);
+    REQUIRE(mgr.get_mesh("robot/node.1:0")->vbuf[0] == 20.f);
+    REQUIRE(mgr.get_mesh("robot:1") == nullptr);
+
+    // Transforms accumulate down the tree
+    auto origin = [&](const std::string& key) {
+        return glm::vec3(mgr.get_transform(key) * glm::vec4(0.f, 0.f, 0.f, 1.f));
+    };
+    REQUIRE(origin("robot:0") == glm::vec3(0.f));
+    REQUIRE(origin("robot/arm.0:1") == glm::vec3(1.f, 0.f, 0.f));
+    REQUIRE(origin("robot/arm.0/hand.0:0") == glm::vec3(1.f, 2.f, 0.f));
+    REQUIRE(origin("robot/node.1:0") == glm::vec3(0.f));
+}
+
+TEST_CASE("Mesh manager retention test", "[single-file]") {
+    auto& mgr = MeshMgr::instance();
+    const std::vector<VERT_COMP> comps{VERTEX};
+
+    std::unique_ptr<aiScene> first(make_scene({make_mesh(3)},
+        make_node("root", {0}, aiMatrix4x4())));
+    mgr.load_scene(first.get(), "first", comps);
+    std::unique_ptr<aiScene> second(make_scene({make_mesh(6), make_mesh(7)},
+        make_node("root", {1, 0}, aiMatrix4x4())));
+    mgr.load_scene(second.get(), "second", comps);
+
+    // Another file leaves the earlier one alone
+    REQUIRE(mgr.get_keys("first") == std::vector<std::string>{"first:0"});
+    REQUIRE(mgr.get_mesh("first:0")->vcnt == 3);
+    // Node mesh order, not scene mesh order
+    REQUIRE(mgr.get_keys("second") == std::vector<std::string>{"second:0", "second:1"});
+    REQUIRE(mgr.get_mesh("second:0")->vcnt == 7);
+    REQUIRE(mgr.get_mesh("second:1")->vcnt == 6);
+
+    // Loading the same name again replaces meshes without repeating keys
+    std::unique_ptr<aiScene> again(make_scene({make_mesh(9)},
+        make_node("root", {0}, aiMatrix4x4())));
+    mgr.load_scene(again.get(), "first", comps);
+    REQUIRE(mgr.get_keys("first") == std::vector<std::string>{"first:0"});
+    REQUIRE(mgr.get_mesh("first:0")->vcnt == 9);
+}
@@ -0,0 +1,49 @@
+#include <catch2/catch_all.hpp>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "asset_mgr/scene.h"
+
+using Catch::Approx;
+
+static bool mat_eq(const glm::mat4& a, const glm::mat4& b) {
+    for (int i = 0; i < 4; ++i)
+        for (int j = 0; j < 4; ++j)
+            if (a[i][j] != Approx(b[i][j]).margin(1e-5))
+                return false;
+    return true;
+}
+
+TEST_CASE("Scene hierarchy test", "[single-file]") {
+    vkkk::Scene scene;
+
+    auto t1 = glm::translate(glm::mat4(1.f), glm::vec3(1.f, 0.f, 0.f));
+    auto r = glm::rotate(glm::mat4(1.f), glm::radians(90.f), glm::vec3(0.f, 1.f, 0.f));
+    auto s = glm::scale(glm::mat4(1.f), glm::vec3(2.f));
+
+    auto root = scene.add_node("root", vkkk::INVALID_NODE, t1);
+    auto child = scene.add_node("child", root, r);
+    auto grandchild = scene.add_node("grandchild", child, s);
+    auto other = scene.add_node("other", vkkk::INVALID_NODE, s);
+
+    REQUIRE(scene.update() == 4);
+    REQUIRE(mat_eq(scene.get_world(grandchild), t1 * r * s));
+    REQUIRE(mat_eq(scene.get_world(other), s));
+    REQUIRE(scene.find("child") == child);
+
+    // Nothing changed, nothing recomputed
+    auto version = scene.get_version();
+    REQUIRE(scene.update() == 0);
+    REQUIRE(scene.get_version() == version);
+
+    // Only the changed subtree is touched
+    auto t2 = glm::translate(glm::mat4(1.f), glm::vec3(0.f, 3.f, 0.f));
+    scene.set_local(child, t2);
+    REQUIRE(scene.update() == 2);
+    REQUIRE(scene.get_version() == version + 1);
+    REQUIRE(mat_eq(scene.get_world(child), t1 * t2));
+    REQUIRE(mat_eq(scene.get_world(grandchild), t1 * t2 * s));
+    REQUIRE(mat_eq(scene.get_world(other), s));
+
+    REQUIRE_THROWS(scene.add_node("bad", 42));
+}
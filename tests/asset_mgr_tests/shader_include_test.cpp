@@ -0,0 +1,55 @@
+#include <fstream>
+
+#include <catch2/catch_all.hpp>
+
+#include "vk_ins/shader_include.h"
+
+using namespace vkkk;
+
+static void write_file(const fs::path& path, const std::string& content) {
+    fs::create_directories(path.parent_path());
+    std::ofstream file(path, std::ios::trunc);
+    file << content;
+}
+
+TEST_CASE("Shader include test", "[single-file]") {
+    auto dir = fs::temp_directory_path() / "vkkk_shader_include_test";
+    fs::remove_all(dir);
+    auto shader = dir / "shaders" / "lit.frag";
+    auto local = dir / "shaders" / "common.h";
+    auto shared = dir / "include" / "common.h";
+    auto lights = dir / "include" / "concepts" / "lights.h";
+    write_file(shader, "#include \"common.h\"");
+    write_file(local, "");
+    write_file(shared, "");
+    write_file(lights, "");
+    std::vector<fs::path> dirs{dir / "include"};
+
+    // Quoted includes prefer the including file's directory
+    auto found = resolve_shader_include("common.h", shader, true, dirs);
+    REQUIRE(found.has_value());
+    REQUIRE(*found == fs::weakly_canonical(local));
+
+    // Angled ones only search dirs
+    found = resolve_shader_include("common.h", shader, false, dirs);
+    REQUIRE(found.has_value());
+    REQUIRE(*found == fs::weakly_canonical(shared));
+
+    found = resolve_shader_include("concepts/lights.h", shader, true, dirs);
+    REQUIRE(found.has_value());
+    REQUIRE(*found == fs::weakly_canonical(lights));
+
+    // Nested includes resolve against the header including them
+    found = resolve_shader_include("../common.h", lights, true, dirs);
+    REQUIRE(found.has_value());
+    REQUIRE(*found == fs::weakly_canonical(shared));
+
+    found = resolve_shader_include(lights.string(), shader, false, {});
+    REQUIRE(found.has_value());
+    REQUIRE(*found == fs::weakly_canonical(lights));
+
+    REQUIRE_FALSE(resolve_shader_include("missing.h", shader, true, dirs).has_value());
+    REQUIRE_FALSE(resolve_shader_include("concepts", shader, false, dirs).has_value());
+
+    fs::remove_all(dir);
+}
@@ -1,3 +1,5 @@
+#include <cstring>
+
 #include <catch2/catch_all.hpp>
 
 #include "vk_ins/shader_mgr.h"
@@ -5,4 +7,112 @@
 TEST_CASE("ShaderMgr test", "shader_mgr") {
     vkkk::ShaderModule m;
     REQUIRE(m.load("../resource/shaders/with_tex.vert", VK_SHADER_STAGE_VERTEX_BIT));
-}
\ No newline at end of file
+}
+TEST_CASE("Push constant reflection test", "shader_mgr") {
+    vkkk::ShaderModule m;
+    REQUIRE(m.load("../resource/shaders/shadow_depth.vert", VK_SHADER_STAGE_VERTEX_BIT));
+    REQUIRE(m.push_infos.size() == 1);
+    auto [offset, size] = m.push_infos.begin()->second;
+    REQUIRE(offset == 0);
+    REQUIRE(size == 64);
+}
+TEST_CASE("Shader include dependency test", "shader_mgr") {
+    vkkk::ShaderModule m;
+    REQUIRE(m.load("../resource/shaders/basic_lighting.frag", VK_SHADER_STAGE_FRAGMENT_BIT));
+    // lights.h pulls in utils/macros.h in turn
+    REQUIRE(m.dependencies.size() == 2);
+    REQUIRE(m.dependencies.contains(fs::weakly_canonical("../src/concepts/lights.h")));
+    REQUIRE(m.dependencies.contains(fs::weakly_canonical("../src/utils/macros.h")));
+}
+
+TEST_CASE("Specialization constant reflection test", "shader_mgr") {
+    vkkk::ShaderModule m;
+    REQUIRE(m.load("../resource/shaders/basic_lighting.frag", VK_SHADER_STAGE_FRAGMENT_BIT));
+    REQUIRE(m.spec_infos.size() == 3);
+    auto [id, size] = m.spec_infos.at("POINT_LIGHT_COUNT");
+    REQUIRE(id == 0);
+    REQUIRE(size == sizeof(int32_t));
+    REQUIRE(m.set_spec_constant("POINT_LIGHT_COUNT", 2));
+}
+
+TEST_CASE("Shader optimization test", "shader_mgr") {
+    vkkk::ShaderModule plain;
+    plain.optimization = vkkk::ShaderOptimization::none;
+    REQUIRE(plain.load("../resource/shaders/basic_lighting.frag", VK_SHADER_STAGE_FRAGMENT_BIT));
+    REQUIRE(plain.build_stats.spirv_size == plain.build_stats.reflect_size);
+
+    // Names get stripped, reflection still sees them
+    vkkk::ShaderModule small;
+    small.optimization = vkkk::ShaderOptimization::size;
+    REQUIRE(small.load("../resource/shaders/basic_lighting.frag", VK_SHADER_STAGE_FRAGMENT_BIT));
+    REQUIRE(small.build_stats.spirv_size < small.build_stats.reflect_size);
+    REQUIRE(small.spirv_code.size() * sizeof(uint32_t) == small.build_stats.spirv_size);
+    REQUIRE(small.buf_infos == plain.buf_infos);
+    REQUIRE(small.spec_infos == plain.spec_infos);
+
+    auto totals = vkkk::shader_build_stats(vkkk::ShaderOptimization::size);
+    REQUIRE(totals.module_cnt >= 1);
+    REQUIRE(totals.spirv_size >= small.build_stats.spirv_size);
+}
+
+TEST_CASE("Push constant range test", "[single-file]") {
+    std::vector<vkkk::ShaderModule> mods(3);
+    mods[0].type = VK_SHADER_STAGE_VERTEX_BIT;
+    mods[0].push_infos.emplace("Push", std::make_tuple(0u, 64u));
+    mods[1].type = VK_SHADER_STAGE_FRAGMENT_BIT;
+    mods[1].push_infos.emplace("Push", std::make_tuple(64u, 16u));
+    mods[2].type = VK_SHADER_STAGE_GEOMETRY_BIT;
+    mods[2].push_infos.emplace("Push", std::make_tuple(0u, 64u));
+
+    // Same block in two stages shares a range
+    auto ranges = vkkk::collect_push_ranges(mods);
+    REQUIRE(ranges.size() == 2);
+    REQUIRE(ranges[0].stageFlags == (VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT));
+    REQUIRE(ranges[1].offset == 64);
+
+    REQUIRE(vkkk::push_stages(ranges, 0, 64) ==
+        (VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT));
+    REQUIRE(vkkk::push_stages(ranges, 64, 4) == VK_SHADER_STAGE_FRAGMENT_BIT);
+    // Straddling both ranges, neither stage set sees all of it
+    REQUIRE(vkkk::push_stages(ranges, 60, 8) == 0);
+    REQUIRE(vkkk::push_stages(ranges, 80, 4) == 0);
+}
+
+TEST_CASE("Specialization test", "[single-file]") {
+    vkkk::ShaderModule m;
+    m.spec_infos.emplace("COUNT", std::make_tuple(3u, 4u));
+    m.spec_infos.emplace("TEXTURED", std::make_tuple(1u, 4u));
+    m.spec_infos.emplace("SCALE", std::make_tuple(2u, 4u));
+
+    REQUIRE_FALSE(m.set_spec_constant("MISSING", 1));
+    // Sizes have to match the declaration
+    REQUIRE_FALSE(m.set_spec_constant("COUNT", 1.0));
+    REQUIRE(m.set_spec_constant("COUNT", 4));
+    REQUIRE(m.set_spec_constant("TEXTURED", true));
+    REQUIRE(m.set_spec_constant("SCALE", 0.5f));
+
+    // Sorted by constant_id, values packed back to back
+    auto [entries, data] = m.get_specialization();
+    REQUIRE(entries.size() == 3);
+    REQUIRE(data.size() == 12);
+    REQUIRE(entries[0].constantID == 1);
+    REQUIRE(entries[2].constantID == 3);
+    REQUIRE(entries[2].offset == 8);
+    VkBool32 textured;
+    std::memcpy(&textured, data.data() + entries[0].offset, sizeof(textured));
+    REQUIRE(textured == VK_TRUE);
+    float scale;
+    std::memcpy(&scale, data.data() + entries[1].offset, sizeof(scale));
+    REQUIRE(scale == 0.5f);
+
+    // Raw Vulkan info, values for undeclared constants are dropped
+    int32_t values[2]{7, 9};
+    VkSpecializationMapEntry raw[2]{{3, 0, 4}, {5, 4, 4}};
+    VkSpecializationInfo info{2, raw, sizeof(values), values};
+    m.set_specialization(info);
+    auto [raw_entries, raw_data] = m.get_specialization();
+    REQUIRE(raw_entries.size() == 3);
+    int32_t count;
+    std::memcpy(&count, raw_data.data() + raw_entries[2].offset, sizeof(count));
+    REQUIRE(count == 7);
+}
@@ -0,0 +1,74 @@
+#include <catch2/catch_all.hpp>
+
+#include "asset_mgr/material_mgr.h"
+#include "vk_ins/vkabstraction.h"
+#include "utils/slot_allocator.h"
+
+TEST_CASE("Slot allocator test", "[single-file]") {
+    vkkk::SlotAllocator slots(4);
+    for (uint32_t i = 0; i < 4; ++i)
+        REQUIRE(slots.alloc() == i);
+    REQUIRE(!slots.alloc());
+    REQUIRE(slots.get_used() == 4);
+
+    // Released slots come back before anything else, last in first out
+    REQUIRE(slots.release(1));
+    REQUIRE(slots.release(3));
+    REQUIRE_FALSE(slots.release(3));
+    REQUIRE_FALSE(slots.release(7));
+    REQUIRE(slots.get_used() == 2);
+    REQUIRE_FALSE(slots.is_taken(3));
+    REQUIRE(slots.alloc() == 3);
+    REQUIRE(slots.alloc() == 1);
+    REQUIRE(!slots.alloc());
+
+    slots.reset(2);
+    REQUIRE(slots.get_used() == 0);
+    REQUIRE(slots.alloc() == 0);
+}
+
+TEST_CASE("Material table test", "[single-file]") {
+    vkkk::MaterialMgr mgr;
+    // Material 0 is the default every node starts with
+    REQUIRE(mgr.get_materials().size() == 1);
+    REQUIRE(mgr.get_materials()[0].textures.x == BINDLESS_NONE);
+    REQUIRE(mgr.get_assigned(5) == 0);
+
+    auto v = mgr.get_version();
+    auto mat = vkkk::default_material();
+    mat.base_color = glm::vec4(1.f, 0.f, 0.f, 1.f);
+    auto red = mgr.add_material(mat);
+    REQUIRE(red == 1);
+    REQUIRE(mgr.assign(5, red));
+    REQUIRE_FALSE(mgr.assign(6, 7));
+    REQUIRE(mgr.get_assigned(5) == red);
+    REQUIRE(mgr.get_assigned(4) == 0);
+    REQUIRE(mgr.get_version() > v);
+
+    REQUIRE_FALSE(mgr.set_material(9, mat));
+    REQUIRE(sizeof(vkkk::Material) % 16 == 0);
+}
+
+TEST_CASE("Bindless texture test", "[single-file]") {
+    vkkk::VkWrappedInstance ins;
+    ins.init(true);
+    ins.create_logical_device();
+    ins.create_command_pool();
+    REQUIRE(ins.create_bindless_heap(64, 16));
+    REQUIRE(ins.add_texture("albedo", 0, "../resource/textures/texture.jpeg"));
+
+    // The heap slot gets the texture's sampler and view
+    auto& tex = ins.textures.at("albedo");
+    REQUIRE(tex.descriptor.imageView != VK_NULL_HANDLE);
+    REQUIRE(tex.descriptor.sampler != VK_NULL_HANDLE);
+    auto slot = ins.add_bindless_texture("albedo");
+    REQUIRE(slot != BINDLESS_NONE);
+    REQUIRE(ins.bindless.get_image_slots().is_taken(slot));
+
+    // Frames submitted before the removal may still read the slot, it
+    // isn't handed out again until they retire
+    REQUIRE(ins.remove_bindless_texture(slot));
+    REQUIRE(ins.bindless.get_image_slots().is_taken(slot));
+    REQUIRE(ins.add_bindless_texture("albedo") != slot);
+    REQUIRE_FALSE(ins.remove_bindless_texture(BINDLESS_NONE));
+}
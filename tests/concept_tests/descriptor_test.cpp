@@ -0,0 +1,135 @@
+#include <type_traits>
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+
+#include "vk_ins/descriptor.h"
+
+using namespace vkkk;
+
+template <typename H>
+static H fake_handle(const uint64_t v) {
+    if constexpr (std::is_pointer_v<H>)
+        return reinterpret_cast<H>(static_cast<uintptr_t>(v));
+    else
+        return static_cast<H>(v);
+}
+
+static VkDescriptorSetLayoutBinding layout_binding(const uint32_t binding,
+    const VkDescriptorType type, const VkShaderStageFlags stages)
+{
+    return VkDescriptorSetLayoutBinding{
+        .binding = binding,
+        .descriptorType = type,
+        .descriptorCount = 1,
+        .stageFlags = stages,
+        .pImmutableSamplers = nullptr
+    };
+}
+
+static DescriptorBinding buffer_binding(const uint32_t binding, const uint64_t buf,
+    const VkDescriptorType type=VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+{
+    DescriptorBinding b{.binding = binding, .type = type};
+    b.buffer = {fake_handle<VkBuffer>(buf), 0, 256};
+    return b;
+}
+
+TEST_CASE("Descriptor layout key test", "[single-file]") {
+    auto ubo = layout_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT);
+    auto ssbo = layout_binding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT);
+    auto tex = layout_binding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        VK_SHADER_STAGE_FRAGMENT_BIT);
+
+    // Declaration order doesn't matter
+    DescriptorLayoutKey a({ubo, ssbo, tex});
+    DescriptorLayoutKey b({tex, ubo, ssbo});
+    REQUIRE(a.hash == b.hash);
+    REQUIRE(a == b);
+    REQUIRE(a.bindings[0].binding == 0);
+    REQUIRE(a.bindings[1].binding == 1);
+    REQUIRE(a.bindings[2].binding == 2);
+
+    // The same binding declared by two stages is merged
+    auto frag_ubo = layout_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+        VK_SHADER_STAGE_FRAGMENT_BIT);
+    DescriptorLayoutKey merged({ubo, frag_ubo});
+    REQUIRE(merged.bindings.size() == 1);
+    REQUIRE(merged.bindings[0].stageFlags ==
+        (VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT));
+    DescriptorLayoutKey both({layout_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+        VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)});
+    REQUIRE(merged == both);
+
+    // Anything else differing gives a different layout
+    REQUIRE_FALSE(a == DescriptorLayoutKey({ubo, tex}));
+    REQUIRE_FALSE(DescriptorLayoutKey({ubo}) == DescriptorLayoutKey({frag_ubo}));
+    auto ubo_array = ubo;
+    ubo_array.descriptorCount = 4;
+    REQUIRE_FALSE(DescriptorLayoutKey({ubo}) == DescriptorLayoutKey({ubo_array}));
+    REQUIRE(DescriptorLayoutKey({}) == DescriptorLayoutKey({}));
+}
+
+TEST_CASE("Descriptor set key test", "[single-file]") {
+    auto layout = fake_handle<VkDescriptorSetLayout>(7);
+    auto other_layout = fake_handle<VkDescriptorSetLayout>(8);
+
+    DescriptorSetKey a(layout, {buffer_binding(0, 100), buffer_binding(1, 200)});
+    DescriptorSetKey b(layout, {buffer_binding(1, 200), buffer_binding(0, 100)});
+    REQUIRE(a.hash == b.hash);
+    REQUIRE(a == b);
+
+    REQUIRE_FALSE(a == DescriptorSetKey(other_layout,
+        {buffer_binding(0, 100), buffer_binding(1, 200)}));
+    REQUIRE_FALSE(a == DescriptorSetKey(layout,
+        {buffer_binding(0, 100), buffer_binding(1, 201)}));
+    auto shifted = buffer_binding(1, 200);
+    shifted.buffer.offset = 64;
+    REQUIRE_FALSE(a == DescriptorSetKey(layout, {buffer_binding(0, 100), shifted}));
+
+    // Images compare by view, sampler and layout, the buffer part is ignored
+    DescriptorBinding img{.binding = 3, .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER};
+    img.image = {fake_handle<VkSampler>(5), fake_handle<VkImageView>(300),
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    auto img_noise = img;
+    img_noise.buffer.range = 123;
+    REQUIRE(DescriptorSetKey(layout, {img}) == DescriptorSetKey(layout, {img_noise}));
+    auto other_view = img;
+    other_view.image.imageView = fake_handle<VkImageView>(301);
+    REQUIRE_FALSE(DescriptorSetKey(layout, {img}) == DescriptorSetKey(layout, {other_view}));
+
+    // References find buffers, views and samplers but not layouts
+    DescriptorSetKey c(layout, {buffer_binding(0, 100), img});
+    REQUIRE(c.references(100));
+    REQUIRE(c.references(300));
+    REQUIRE(c.references(5));
+    REQUIRE_FALSE(c.references(200));
+    REQUIRE_FALSE(c.references(7));
+}
+
+TEST_CASE("Immutable sampler layout key test", "[single-file]") {
+    auto tex = layout_binding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        VK_SHADER_STAGE_FRAGMENT_BIT);
+
+    // Compared by handle, not by where the caller kept the array
+    std::vector<VkSampler> first{fake_handle<VkSampler>(7)};
+    std::vector<VkSampler> second{fake_handle<VkSampler>(7)};
+    std::vector<VkSampler> other{fake_handle<VkSampler>(8)};
+    auto with = [&](std::vector<VkSampler>& samplers) {
+        auto b = tex;
+        b.pImmutableSamplers = samplers.data();
+        return DescriptorLayoutKey({b});
+    };
+
+    auto a = with(first);
+    REQUIRE(a == with(second));
+    REQUIRE_FALSE(a == with(other));
+    REQUIRE_FALSE(a == DescriptorLayoutKey({tex}));
+
+    // The key owns its copy
+    REQUIRE(a.bindings[0].pImmutableSamplers != first.data());
+    first[0] = fake_handle<VkSampler>(9);
+    REQUIRE(a.bindings[0].pImmutableSamplers[0] == fake_handle<VkSampler>(7));
+    auto moved = std::move(a);
+    REQUIRE(moved == with(second));
+}
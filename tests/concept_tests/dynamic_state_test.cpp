@@ -0,0 +1,42 @@
+#include <catch2/catch_all.hpp>
+
+#include "vk_ins/dynamic_state.h"
+
+using namespace vkkk;
+
+TEST_CASE("Dynamic state filter test", "[single-file]") {
+    REQUIRE_FALSE(is_extended_dynamic_state(VK_DYNAMIC_STATE_VIEWPORT));
+    REQUIRE_FALSE(is_extended_dynamic_state(VK_DYNAMIC_STATE_DEPTH_BIAS));
+    REQUIRE(is_extended_dynamic_state(VK_DYNAMIC_STATE_CULL_MODE_EXT));
+    REQUIRE(is_extended_dynamic_state(VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT));
+
+    std::vector<VkDynamicState> states{
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_CULL_MODE_EXT,
+        VK_DYNAMIC_STATE_SCISSOR,
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT
+    };
+
+    // Order kept, duplicates dropped
+    auto extended = supported_dynamic_states(states, true);
+    REQUIRE(extended.size() == 4);
+    REQUIRE(extended[0] == VK_DYNAMIC_STATE_VIEWPORT);
+    REQUIRE(extended[1] == VK_DYNAMIC_STATE_CULL_MODE_EXT);
+    REQUIRE(extended[3] == VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT);
+
+    // Without the extension only core states are left
+    auto core = supported_dynamic_states(states, false);
+    REQUIRE(core.size() == 2);
+    REQUIRE(core[0] == VK_DYNAMIC_STATE_VIEWPORT);
+    REQUIRE(core[1] == VK_DYNAMIC_STATE_SCISSOR);
+
+    REQUIRE(supported_dynamic_states({}, true).empty());
+}
+
+TEST_CASE("Extended dynamic state loader test", "[single-file]") {
+    ExtendedDynamicState cmds;
+    REQUIRE_FALSE(cmds.loaded());
+    REQUIRE_FALSE(cmds.set_cull_mode(VK_NULL_HANDLE, VK_CULL_MODE_NONE));
+    REQUIRE_FALSE(cmds.set_depth_test(VK_NULL_HANDLE, false));
+}
@@ -0,0 +1,64 @@
+#include <chrono>
+#include <fstream>
+#include <thread>
+
+#include <catch2/catch_all.hpp>
+
+#include "utils/file_watcher.h"
+
+using namespace vkkk;
+
+static void write_file(const fs::path& path, const std::string& content) {
+    std::ofstream file(path, std::ios::trunc);
+    file << content;
+}
+
+TEST_CASE("File watcher test", "[single-file]") {
+    auto dir = fs::temp_directory_path() / "vkkk_file_watcher_test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    auto shader = dir / "shader.frag";
+    auto other = dir / "other.frag";
+    write_file(shader, "void main() {}");
+    write_file(other, "void main() {}");
+
+    FileWatcher watcher;
+    REQUIRE_FALSE(watcher.watch(dir / "missing.frag"));
+    REQUIRE(watcher.watch(shader));
+    REQUIRE(watcher.watch(shader));
+    REQUIRE(watcher.size() == 1);
+    REQUIRE(watcher.watching(shader));
+    REQUIRE_FALSE(watcher.watching(other));
+    REQUIRE(watcher.poll().empty());
+
+    // Modification times can be coarse
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    write_file(other, "void main() { }");
+    REQUIRE(watcher.poll().empty());
+
+    write_file(shader, "void main() { }");
+    auto changed = watcher.poll();
+    REQUIRE(changed.size() == 1);
+    REQUIRE(changed[0] == fs::weakly_canonical(shader));
+    REQUIRE(watcher.poll().empty());
+
+    // Saved through a rename like most editors do
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    auto tmp = dir / "shader.frag.tmp";
+    write_file(tmp, "void main() {  }");
+    fs::rename(tmp, shader);
+    REQUIRE(watcher.poll().size() == 1);
+
+    // Recreated, reported once it's written rather than on creation
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    fs::remove(shader);
+    {
+        std::ofstream file(shader);
+        REQUIRE(watcher.poll().empty());
+        file << "void main() {}";
+    }
+    REQUIRE(watcher.poll().size() == 1);
+    REQUIRE(watcher.poll().empty());
+
+    fs::remove_all(dir);
+}
@@ -0,0 +1,83 @@
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+
+#include "utils/deletion_queue.h"
+#include "vk_ins/frame_scheduler.h"
+
+using namespace vkkk;
+
+TEST_CASE("Frame pacing test", "[single-file]") {
+    // Nothing to wait for until enough frames went out
+    REQUIRE(FrameScheduler::wait_value(1, 1) == 0);
+    REQUIRE(FrameScheduler::wait_value(2, 2) == 0);
+    REQUIRE(FrameScheduler::wait_value(2, 1) == 1);
+    REQUIRE(FrameScheduler::wait_value(10, 3) == 7);
+
+    // Lower latency never waits on an older frame
+    for (uint64_t frame = 1; frame < 16; ++frame)
+        REQUIRE(FrameScheduler::wait_value(frame, 1) >= FrameScheduler::wait_value(frame, 3));
+
+    FrameScheduler scheduler;
+    REQUIRE(scheduler.get_frame() == 1);
+    REQUIRE_FALSE(scheduler.uses_timeline());
+    REQUIRE(scheduler.get_slot() == 0);
+}
+
+TEST_CASE("Frame stats test", "[single-file]") {
+    FrameStats stats;
+    REQUIRE(stats.avg_wait() == 0.);
+
+    stats.record(2.);
+    stats.record(6.);
+    stats.record(1.);
+    REQUIRE(stats.frame_cnt == 3);
+    REQUIRE(stats.last_wait == 1.);
+    REQUIRE(stats.max_wait == 6.);
+    REQUIRE(stats.avg_wait() == Catch::Approx(3.));
+}
+
+TEST_CASE("Frame limiter test", "[single-file]") {
+    using namespace std::chrono_literals;
+    using Clock = FrameLimiter::Clock;
+
+    FrameLimiter limiter;
+    auto t = Clock::now();
+    REQUIRE_FALSE(limiter.enabled());
+    REQUIRE(limiter.next_delay(t) == Clock::duration{0});
+
+    limiter.set_fps(100.);
+    REQUIRE(limiter.enabled());
+    // First frame starts the schedule right away
+    REQUIRE(limiter.next_delay(t) == Clock::duration{0});
+    // A frame done early sleeps until its slot
+    REQUIRE(limiter.next_delay(t + 4ms) == 6ms);
+    // A late one doesn't, the next frame makes up for it
+    REQUIRE(limiter.next_delay(t + 25ms) == Clock::duration{0});
+    REQUIRE(limiter.next_delay(t + 26ms) == 4ms);
+    // Way behind restarts the schedule
+    REQUIRE(limiter.next_delay(t + 100ms) == Clock::duration{0});
+    REQUIRE(limiter.next_delay(t + 101ms) == 9ms);
+
+    limiter.set_fps(0.);
+    REQUIRE(limiter.next_delay(t + 102ms) == Clock::duration{0});
+}
+
+TEST_CASE("Deferred deletion test", "[single-file]") {
+    DeletionQueue queue;
+    std::vector<int> deleted;
+    queue.push(0, [&] { deleted.push_back(0); });
+    queue.push(2, [&] { deleted.push_back(2); });
+    queue.push(2, [&] { deleted.push_back(3); });
+    queue.push(5, [&] { deleted.push_back(5); });
+
+    REQUIRE(queue.flush(1) == 1);
+    REQUIRE(queue.flush(1) == 0);
+    REQUIRE(queue.flush(4) == 2);
+    REQUIRE(deleted == std::vector<int>({0, 2, 3}));
+    REQUIRE(queue.size() == 1);
+
+    REQUIRE(queue.flush_all() == 1);
+    REQUIRE(deleted.back() == 5);
+    REQUIRE(queue.size() == 0);
+}
@@ -0,0 +1,40 @@
+#include <numeric>
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+
+#include "concepts/mesh.h"
+#include "utils/simd.h"
+
+TEST_CASE("Index narrowing test", "[single-file]") {
+    // Odd size to cover the scalar tail
+    std::vector<uint32_t> src(1027);
+    std::iota(src.begin(), src.end(), 0);
+    src[3] = 0xFFFF;
+    src[9] = 0x8000;
+    src[10] = 0x7FFF;
+
+    std::vector<uint16_t> dst(src.size());
+    vkkk::simd::narrow_u32_to_u16(src.data(), dst.data(), src.size());
+    for (size_t i = 0; i < src.size(); ++i)
+        REQUIRE(dst[i] == static_cast<uint16_t>(src[i]));
+}
+
+TEST_CASE("Mesh index type test", "[single-file]") {
+    vkkk::Mesh mesh({vkkk::VERTEX});
+
+    std::vector<float> verts(3 * 3, 0.f);
+    std::vector<uint32_t> idxs{0, 1, 2};
+    mesh.load(3, reinterpret_cast<const char*>(verts.data()), verts.size() * sizeof(float),
+        1, reinterpret_cast<const char*>(idxs.data()), idxs.size() * sizeof(uint32_t));
+    REQUIRE(mesh.index_type == VK_INDEX_TYPE_UINT16);
+    REQUIRE(mesh.index_size() == 2);
+    mesh.unload();
+
+    verts.resize(70000 * 3, 0.f);
+    idxs = {0, 1, 69999};
+    mesh.load(70000, reinterpret_cast<const char*>(verts.data()), verts.size() * sizeof(float),
+        1, reinterpret_cast<const char*>(idxs.data()), idxs.size() * sizeof(uint32_t));
+    REQUIRE(mesh.index_type == VK_INDEX_TYPE_UINT32);
+    REQUIRE(mesh.index_size() == 4);
+}
@@ -0,0 +1,92 @@
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+
+#include "concepts/interleave.h"
+
+using namespace vkkk;
+
+static void fill_mesh(aiMesh& mesh, const uint32_t n) {
+    mesh.mNumVertices = n;
+    mesh.mVertices = new aiVector3D[n];
+    mesh.mNormals = new aiVector3D[n];
+    mesh.mTextureCoords[0] = new aiVector3D[n];
+    mesh.mColors[0] = new aiColor4D[n];
+    for (uint32_t i = 0; i < n; ++i) {
+        float f = static_cast<float>(i);
+        mesh.mVertices[i] = aiVector3D(f, f + 0.1f, f + 0.2f);
+        mesh.mNormals[i] = aiVector3D(-f, 1.f, 2.f);
+        mesh.mTextureCoords[0][i] = aiVector3D(f * 0.5f, 0.25f, 9.f);
+        mesh.mColors[0][i] = aiColor4D(0.1f, 0.2f, 0.3f, 0.4f);
+    }
+}
+
+// The per component strided loops Mesh::load used before
+static void interleave_strided(const aiMesh* mesh, float* dst) {
+    const uint32_t n = mesh->mNumVertices;
+    const uint32_t stride = 11;
+    for (uint32_t i = 0; i < n; ++i) {
+        dst[i * stride    ] = mesh->mVertices[i].x;
+        dst[i * stride + 1] = mesh->mVertices[i].y;
+        dst[i * stride + 2] = mesh->mVertices[i].z;
+    }
+    for (uint32_t i = 0; i < n; ++i) {
+        dst[i * stride + 3] = mesh->mNormals[i].x;
+        dst[i * stride + 4] = mesh->mNormals[i].y;
+        dst[i * stride + 5] = mesh->mNormals[i].z;
+    }
+    for (uint32_t i = 0; i < n; ++i) {
+        dst[i * stride + 6] = mesh->mTextureCoords[0][i].x;
+        dst[i * stride + 7] = mesh->mTextureCoords[0][i].y;
+    }
+    for (uint32_t i = 0; i < n; ++i) {
+        dst[i * stride + 8] = mesh->mColors[0][i].r;
+        dst[i * stride + 9] = mesh->mColors[0][i].g;
+        dst[i * stride + 10] = mesh->mColors[0][i].b;
+    }
+}
+
+TEST_CASE("Interleave test", "[single-file]") {
+    const std::vector<VERT_COMP> comps{VERTEX, NORMAL, UV, COLOR};
+    // Sizes around the parallel threshold to cover the chunk boundaries
+    for (uint32_t n : {1u, 7u, 1000u, INTERLEAVE_PARALLEL_THRESHOLD + 3}) {
+        aiMesh mesh;
+        fill_mesh(mesh, n);
+
+        std::vector<float> expected(n * 11), kernel(n * 11), generic(n * 11);
+        interleave_strided(&mesh, expected.data());
+        interleave_attributes(&mesh, comps, kernel.data());
+        interleave_generic(&mesh, comps, generic.data());
+        REQUIRE(kernel == expected);
+        REQUIRE(generic == expected);
+    }
+
+    aiMesh no_normals;
+    fill_mesh(no_normals, 4);
+    delete[] no_normals.mNormals;
+    no_normals.mNormals = nullptr;
+    std::vector<float> buf(4 * 11);
+    REQUIRE_THROWS(interleave_attributes(&no_normals, comps, buf.data()));
+}
+
+TEST_CASE("Interleave benchmark", "[!benchmark]") {
+    const std::vector<VERT_COMP> comps{VERTEX, NORMAL, UV, COLOR};
+    aiMesh mesh;
+    fill_mesh(mesh, 1 << 20);
+    std::vector<float> buf((1 << 20) * 11);
+
+    BENCHMARK("strided per component") {
+        interleave_strided(&mesh, buf.data());
+        return buf[0];
+    };
+
+    BENCHMARK("compile time interleaver") {
+        interleave_attributes(&mesh, comps, buf.data());
+        return buf[0];
+    };
+
+    BENCHMARK("generic single pass") {
+        interleave_generic(&mesh, comps, buf.data());
+        return buf[0];
+    };
+}
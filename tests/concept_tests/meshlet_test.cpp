@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <set>
+#include <sstream>
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+
+#include "concepts/mesh.h"
+
+using Catch::Approx;
+
+static vkkk::Mesh make_grid(const uint32_t n) {
+    std::vector<float> verts;
+    for (uint32_t y = 0; y <= n; ++y) {
+        for (uint32_t x = 0; x <= n; ++x) {
+            verts.insert(verts.end(), {
+                static_cast<float>(x), static_cast<float>(y), 0.f,
+                0.f, 0.f, 1.f});
+        }
+    }
+
+    std::vector<uint32_t> idxs;
+    for (uint32_t y = 0; y < n; ++y) {
+        for (uint32_t x = 0; x < n; ++x) {
+            uint32_t i = y * (n + 1) + x;
+            idxs.insert(idxs.end(), {i, i + 1, i + n + 2, i, i + n + 2, i + n + 1});
+        }
+    }
+
+    vkkk::Mesh mesh({vkkk::VERTEX, vkkk::NORMAL});
+    mesh.load(verts.size() / 6, reinterpret_cast<const char*>(verts.data()),
+        verts.size() * sizeof(float), idxs.size() / 3,
+        reinterpret_cast<const char*>(idxs.data()), idxs.size() * sizeof(uint32_t));
+    return mesh;
+}
+
+static std::multiset<std::array<uint32_t, 3>> triangles(const vkkk::Mesh& mesh) {
+    std::multiset<std::array<uint32_t, 3>> tris;
+    for (uint32_t i = 0; i < mesh.icnt; ++i)
+        tris.insert({mesh.ibuf[i * 3], mesh.ibuf[i * 3 + 1], mesh.ibuf[i * 3 + 2]});
+    return tris;
+}
+
+TEST_CASE("Meshlet build test", "[single-file]") {
+    auto mesh = make_grid(32);
+    auto before = triangles(mesh);
+    mesh.build_meshlets();
+
+    REQUIRE(triangles(mesh) == before);
+    REQUIRE(mesh.meshlets.size() > 1);
+
+    uint32_t next_tri = 0;
+    for (const auto& m : mesh.meshlets) {
+        REQUIRE(m.triangle_offset == next_tri);
+        REQUIRE(m.triangle_count <= vkkk::MESHLET_MAX_TRIANGLES);
+        next_tri += m.triangle_count;
+
+        std::set<uint32_t> verts(mesh.ibuf + m.triangle_offset * 3,
+            mesh.ibuf + (m.triangle_offset + m.triangle_count) * 3);
+        REQUIRE(verts.size() == m.vertex_count);
+        REQUIRE(m.vertex_count <= vkkk::MESHLET_MAX_VERTICES);
+
+        glm::vec3 center = m.sphere;
+        for (auto v : verts) {
+            glm::vec3 p(mesh.vbuf[v * 6], mesh.vbuf[v * 6 + 1], mesh.vbuf[v * 6 + 2]);
+            REQUIRE(glm::length(p - center) <= m.sphere.w + 1e-4f);
+        }
+
+        // Flat grid, every triangle faces +z
+        REQUIRE(m.cone.z == Approx(1.f));
+        REQUIRE(m.cone.w == Approx(0.f).margin(1e-4f));
+    }
+    REQUIRE(next_tri == mesh.icnt);
+}
+
+TEST_CASE("Mesh serialize test", "[single-file]") {
+    auto mesh = make_grid(8);
+    mesh.build_meshlets(16, 16);
+
+    std::stringstream ss;
+    mesh.serialize(ss);
+
+    vkkk::Mesh loaded({vkkk::VERTEX});
+    loaded.deserialize(ss);
+    REQUIRE(loaded.comps == mesh.comps);
+    REQUIRE(loaded.comp_size == mesh.comp_size);
+    REQUIRE(loaded.vcnt == mesh.vcnt);
+    REQUIRE(loaded.icnt == mesh.icnt);
+    REQUIRE(std::equal(mesh.vbuf, mesh.vbuf + mesh.vcnt * mesh.comp_size, loaded.vbuf));
+    REQUIRE(std::equal(mesh.ibuf, mesh.ibuf + mesh.icnt * 3, loaded.ibuf));
+    REQUIRE(loaded.meshlets.size() == mesh.meshlets.size());
+
+    std::stringstream bad("garbage");
+    REQUIRE_THROWS(loaded.deserialize(bad));
+}
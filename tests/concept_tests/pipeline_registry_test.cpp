@@ -0,0 +1,244 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <future>
+
+#include <catch2/catch_all.hpp>
+
+#include "vk_ins/pipeline_registry.h"
+
+using namespace vkkk;
+
+static PipelineBuildInfo make_info() {
+    PipelineBuildInfo info;
+    info.stages.emplace_back(VK_SHADER_STAGE_VERTEX_BIT, std::vector<uint32_t>{0x07230203, 1, 2, 3});
+    info.stages.emplace_back(VK_SHADER_STAGE_FRAGMENT_BIT, std::vector<uint32_t>{0x07230203, 4, 5});
+    info.input_bindings.push_back({0, 12, 0});
+    info.input_attrs.push_back({0, 0, 106, 0});
+    info.input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    info.viewport = {0.f, 0.f, 800.f, 600.f, 0.f, 1.f};
+    info.scissor = {{0, 0}, {800, 600}};
+    info.rasterizer.lineWidth = 1.f;
+    info.depth_stencil.depthTestEnable = 1;
+    info.blend_attachments.push_back({});
+    info.dynamic_states = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    return info;
+}
+
+// Stands in for the driver, hands out made up handles and records what got
+// destroyed. Culling front and back fails the build
+struct FakeDriver {
+    std::atomic<uint32_t>                   built{0};
+    std::vector<std::pair<VkPipeline, VkPipelineLayout>>
+                                            destroyed;
+
+    PipelineRegistry make_registry() {
+        return PipelineRegistry(
+            [this](VkDevice, const PipelineBuildInfo& info, VkPipelineCache) {
+                if (info.rasterizer.cullMode == VK_CULL_MODE_FRONT_AND_BACK)
+                    return VkPipeline(VK_NULL_HANDLE);
+                return reinterpret_cast<VkPipeline>(uintptr_t(0x100) + ++built);
+            },
+            [this](VkDevice, VkPipeline pipeline, VkPipelineLayout layout) {
+                destroyed.emplace_back(pipeline, layout);
+            });
+    }
+};
+
+TEST_CASE("Pipeline key test", "[single-file]") {
+    std::vector<VkDescriptorSetLayout> sets{reinterpret_cast<VkDescriptorSetLayout>(0x1)};
+    std::vector<VkPushConstantRange> push;
+
+    auto info = make_info();
+    PipelineKey a(info, sets, push);
+    REQUIRE(a == PipelineKey(make_info(), sets, push));
+
+    // Dynamic viewport and scissor don't make a new pipeline
+    auto resized = make_info();
+    resized.viewport.width = 1920.f;
+    resized.scissor.extent = {1920, 1080};
+    REQUIRE(a == PipelineKey(resized, sets, push));
+    resized.dynamic_states.clear();
+    REQUIRE_FALSE(a == PipelineKey(resized, sets, push));
+
+    auto shader = make_info();
+    shader.stages[1].second.back() = 6;
+    REQUIRE_FALSE(a == PipelineKey(shader, sets, push));
+
+    // Specializing the same SPIR-V gives another pipeline
+    auto spec = make_info();
+    spec.specializations.resize(2);
+    REQUIRE(a == PipelineKey(spec, sets, push));
+    int32_t count = 4;
+    spec.specializations[1].first.push_back({0, 0, sizeof(count)});
+    spec.specializations[1].second.resize(sizeof(count));
+    std::memcpy(spec.specializations[1].second.data(), &count, sizeof(count));
+    PipelineKey specialized(spec, sets, push);
+    REQUIRE_FALSE(a == specialized);
+    count = 8;
+    std::memcpy(spec.specializations[1].second.data(), &count, sizeof(count));
+    REQUIRE_FALSE(specialized == PipelineKey(spec, sets, push));
+
+    auto vertex = make_info();
+    vertex.input_bindings[0].stride = 24;
+    REQUIRE_FALSE(a == PipelineKey(vertex, sets, push));
+
+    auto depth = make_info();
+    depth.depth_stencil.depthWriteEnable = 1;
+    REQUIRE_FALSE(a == PipelineKey(depth, sets, push));
+
+    auto pass = make_info();
+    pass.render_pass = reinterpret_cast<VkRenderPass>(0x2);
+    REQUIRE_FALSE(a == PipelineKey(pass, sets, push));
+
+    // Layout shape is part of the key, the layout handle itself isn't
+    auto layout = make_info();
+    layout.layout = reinterpret_cast<VkPipelineLayout>(0x3);
+    REQUIRE(a == PipelineKey(layout, sets, push));
+    std::vector<VkPushConstantRange> mvp{{VK_SHADER_STAGE_VERTEX_BIT, 0, 64}};
+    REQUIRE_FALSE(a == PipelineKey(info, sets, mvp));
+}
+
+TEST_CASE("Pipeline registry test", "[single-file]") {
+    std::vector<VkDescriptorSetLayout> sets{reinterpret_cast<VkDescriptorSetLayout>(0x1)};
+    FakeDriver driver;
+    auto registry = driver.make_registry();
+    VkDevice device = VK_NULL_HANDLE;
+
+    PipelineKey key(make_info(), sets, {});
+    REQUIRE(registry.find(key) == nullptr);
+    auto info = make_info();
+    info.layout = reinterpret_cast<VkPipelineLayout>(0x3);
+    auto entry = registry.add(device, PipelineKey(make_info(), sets, {}), std::move(info), false);
+    REQUIRE(entry->state == PipelineRegistry::State::ready);
+    REQUIRE(entry->pipeline != VK_NULL_HANDLE);
+    REQUIRE(entry->layout == reinterpret_cast<VkPipelineLayout>(0x3));
+    REQUIRE(driver.built == 1);
+
+    // Same key, same entry, built once
+    REQUIRE(registry.find(key) == entry);
+    REQUIRE(registry.get_hits() == 1);
+    REQUIRE(registry.add(device, PipelineKey(make_info(), sets, {}), make_info(), false) == entry);
+    REQUIRE(driver.built == 1);
+    REQUIRE(registry.size() == 1);
+
+    // Lazy builds stay pending until polled
+    auto other = make_info();
+    other.rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+    PipelineKey other_key(other, sets, {});
+    auto lazy = registry.add(device, std::move(other_key), std::move(other), true);
+    REQUIRE(lazy != entry);
+    REQUIRE(lazy->state == PipelineRegistry::State::pending);
+    REQUIRE(registry.poll(*lazy, true));
+    REQUIRE(lazy->state == PipelineRegistry::State::ready);
+    REQUIRE(lazy->pipeline != entry->pipeline);
+    REQUIRE_FALSE(registry.poll(*lazy));
+    REQUIRE(driver.built == 2);
+
+    // Waiting on everything leaves nothing pending
+    auto queued = make_info();
+    queued.rasterizer.cullMode = VK_CULL_MODE_FRONT_BIT;
+    PipelineKey queued_key(queued, sets, {});
+    auto late = registry.add(device, std::move(queued_key), std::move(queued), true);
+    registry.wait_all();
+    REQUIRE(late->state == PipelineRegistry::State::ready);
+    REQUIRE(driver.built == 3);
+
+    // Failed builds stay failed
+    auto broken = make_info();
+    broken.rasterizer.cullMode = VK_CULL_MODE_FRONT_AND_BACK;
+    PipelineKey broken_key(broken, sets, {});
+    auto failed = registry.add(device, std::move(broken_key), std::move(broken), false);
+    REQUIRE(failed->state == PipelineRegistry::State::failed);
+    REQUIRE(failed->pipeline == VK_NULL_HANDLE);
+    REQUIRE_FALSE(registry.poll(*failed, true));
+
+    // The last user takes the entry out, destruction waits for the caller
+    auto built = entry->pipeline;
+    registry.retain(*entry);
+    registry.retain(*entry);
+    REQUIRE_FALSE(registry.release(device, *entry));
+    REQUIRE(registry.find(key) == entry);
+    auto deleter = registry.release(device, *entry);
+    REQUIRE(deleter);
+    REQUIRE(registry.find(key) == nullptr);
+    REQUIRE(registry.size() == 3);
+    REQUIRE(driver.destroyed.empty());
+    deleter();
+    REQUIRE(driver.destroyed.size() == 1);
+    REQUIRE(driver.destroyed[0] == std::make_pair(built, reinterpret_cast<VkPipelineLayout>(0x3)));
+
+    // Everything else goes through the destroyer as well
+    registry.destroy(device);
+    REQUIRE(registry.size() == 0);
+    REQUIRE(driver.destroyed.size() == 4);
+    REQUIRE(std::count(driver.destroyed.begin(), driver.destroyed.end(),
+        std::make_pair(built, reinterpret_cast<VkPipelineLayout>(0x3))) == 1);
+}
+
+TEST_CASE("Pipeline cache header test", "[single-file]") {
+    VkPhysicalDeviceProperties props{};
+    props.vendorID = 0x10de;
+    props.deviceID = 0x2684;
+    for (uint32_t i = 0; i < VK_UUID_SIZE; ++i)
+        props.pipelineCacheUUID[i] = static_cast<uint8_t>(i);
+
+    std::vector<char> data(32 + 64);
+    uint32_t header[4]{32, VK_PIPELINE_CACHE_HEADER_VERSION_ONE, props.vendorID, props.deviceID};
+    std::memcpy(data.data(), header, sizeof(header));
+    std::memcpy(data.data() + sizeof(header), props.pipelineCacheUUID, VK_UUID_SIZE);
+    REQUIRE(PipelineRegistry::cache_data_compatible(data, props));
+
+    // Driver update changes the UUID
+    auto updated = props;
+    updated.pipelineCacheUUID[0] = 0xff;
+    REQUIRE_FALSE(PipelineRegistry::cache_data_compatible(data, updated));
+
+    auto other = props;
+    other.deviceID = 0x1234;
+    REQUIRE_FALSE(PipelineRegistry::cache_data_compatible(data, other));
+
+    REQUIRE_FALSE(PipelineRegistry::cache_data_compatible({}, props));
+    data.resize(16);
+    REQUIRE_FALSE(PipelineRegistry::cache_data_compatible(data, props));
+}
+
+TEST_CASE("Pipeline handle test", "[single-file]") {
+    auto built = reinterpret_cast<VkPipeline>(0x100);
+
+    REQUIRE_FALSE(PipelineHandle{}.valid());
+    REQUIRE_FALSE(PipelineHandle{}.wait());
+
+    // Not ready until the build hands its pipeline over
+    std::promise<VkPipeline> build;
+    PipelineHandle pending("lazy", build.get_future().share());
+    REQUIRE(pending.valid());
+    REQUIRE_FALSE(pending.ready());
+    REQUIRE(pending.get_name() == "lazy");
+    build.set_value(built);
+    REQUIRE(pending.ready());
+    REQUIRE(pending.wait());
+
+    std::promise<VkPipeline> broken;
+    PipelineHandle failed("failed", broken.get_future().share());
+    broken.set_value(VK_NULL_HANDLE);
+    REQUIRE(failed.ready());
+    REQUIRE_FALSE(failed.wait());
+
+    // Pending entries hand out the build itself
+    std::promise<VkPipeline> queued;
+    PipelineRegistry::Entry entry;
+    entry.build = queued.get_future().share();
+    auto shared = PipelineRegistry::get_build(entry);
+    REQUIRE(shared.wait_for(std::chrono::seconds(0)) == std::future_status::timeout);
+    queued.set_value(built);
+    REQUIRE(shared.get() == built);
+
+    // Built ones a fulfilled future
+    PipelineRegistry::Entry ready;
+    ready.pipeline = built;
+    ready.state = PipelineRegistry::State::ready;
+    PipelineHandle done("built", PipelineRegistry::get_build(ready));
+    REQUIRE(done.ready());
+    REQUIRE(done.wait());
+}
@@ -0,0 +1,28 @@
+#include <catch2/catch_all.hpp>
+
+#include "utils/range_allocator.h"
+
+TEST_CASE("Range allocator test", "[single-file]") {
+    vkkk::RangeAllocator ranges(100);
+
+    auto a = ranges.alloc(30);
+    auto b = ranges.alloc(30);
+    auto c = ranges.alloc(30);
+    REQUIRE(a == 0);
+    REQUIRE(b == 30);
+    REQUIRE(c == 60);
+    REQUIRE(!ranges.alloc(20));
+    REQUIRE(ranges.get_used() == 90);
+
+    // Hole in the middle gets reused first fit
+    ranges.free(*b, 30);
+    REQUIRE(ranges.alloc(10) == 30);
+    ranges.free(30, 10);
+
+    // Freeing the neighbours coalesces everything back
+    ranges.free(*a, 30);
+    ranges.free(*c, 30);
+    REQUIRE(ranges.get_used() == 0);
+    REQUIRE(ranges.get_fragment_cnt() == 1);
+    REQUIRE(ranges.alloc(100) == 0);
+}
@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+#include <catch2/catch_all.hpp>
+
+#include "utils/radix_sort.h"
+#include "vk_ins/render_queue.h"
+#include "vk_ins/vkabstraction.h"
+
+using namespace vkkk;
+
+template <typename H>
+static H fake_handle(const uint64_t v) {
+    if constexpr (std::is_pointer_v<H>)
+        return reinterpret_cast<H>(static_cast<uintptr_t>(v));
+    else
+        return static_cast<H>(v);
+}
+
+// A frame with 8 pipelines, 32 materials and 64 meshes submitted in
+// random order like a user lambda iterating over entities would
+struct FakeFrame {
+    std::vector<MeshGPU> meshes;
+
+    FakeFrame() : meshes(64) {
+        for (int i = 0; i < meshes.size(); ++i) {
+            // Half the meshes share a pooled buffer
+            meshes[i].vbuf = fake_handle<VkBuffer>(i < 32 ? 1 : 100 + i);
+            meshes[i].ibuf = fake_handle<VkBuffer>(i < 32 ? 2 : 200 + i);
+        }
+    }
+
+    void fill(RenderQueue& queue, const uint32_t cnt) {
+        std::mt19937 rng(42);
+        for (uint32_t i = 0; i < cnt; ++i) {
+            auto ppl = rng() % 8;
+            auto mat = ppl * 4 + rng() % 4;
+            auto mesh = rng() % meshes.size();
+            queue.push(0, fake_handle<VkPipeline>(ppl + 1), VK_NULL_HANDLE,
+                fake_handle<VkDescriptorSet>(mat + 1), &meshes[mesh],
+                (rng() % 1000) / 1000.f, i);
+        }
+    }
+};
+
+TEST_CASE("Radix sort test", "[single-file]") {
+    std::mt19937_64 rng(7);
+    std::vector<uint64_t> keys(5000);
+    for (auto& k : keys)
+        k = rng() >> (rng() % 40);
+    std::vector<uint32_t> vals(keys.size());
+    std::iota(vals.begin(), vals.end(), 0);
+
+    auto expected = keys;
+    std::stable_sort(expected.begin(), expected.end());
+    auto original = keys;
+
+    radix_sort(keys, vals);
+    REQUIRE(keys == expected);
+    for (size_t i = 0; i < keys.size(); ++i)
+        REQUIRE(original[vals[i]] == keys[i]);
+}
+
+TEST_CASE("Render queue test", "[single-file]") {
+    FakeFrame frame;
+    RenderQueue queue;
+    frame.fill(queue, 2000);
+    queue.sort();
+
+    auto unsorted = queue.count_unsorted();
+    auto sorted = queue.count_sorted();
+    // Ids are interned in order of first use so only the grouping can be
+    // checked, one bind per pipeline and per material
+    REQUIRE(sorted.draws == unsorted.draws);
+    REQUIRE(sorted.pipeline_binds == 8);
+    REQUIRE(sorted.descriptor_binds == 32);
+    REQUIRE(sorted.pipeline_binds < unsorted.pipeline_binds);
+    REQUIRE(sorted.vertex_binds < unsorted.vertex_binds);
+
+    // Pass is the most significant field
+    RenderQueue passes;
+    MeshGPU mesh{};
+    passes.push(1, fake_handle<VkPipeline>(1), VK_NULL_HANDLE, VK_NULL_HANDLE, &mesh, 0.f);
+    passes.push(0, fake_handle<VkPipeline>(2), VK_NULL_HANDLE, VK_NULL_HANDLE, &mesh, 1.f);
+    passes.sort();
+    REQUIRE(passes.get_sorted(0).pipeline == fake_handle<VkPipeline>(2));
+
+    // Draws whose pipeline isn't built yet are left out
+    RenderQueue pending;
+    pending.push(0, fake_handle<VkPipeline>(1), VK_NULL_HANDLE, VK_NULL_HANDLE, &mesh, 0.f);
+    pending.push(0, VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE, &mesh, 0.5f);
+    pending.sort();
+    auto stats = pending.count_sorted();
+    REQUIRE(stats.draws == 1);
+    REQUIRE(stats.skipped == 1);
+    REQUIRE(stats.pipeline_binds == 1);
+}
+
+TEST_CASE("Render queue benchmark", "[!benchmark]") {
+    FakeFrame frame;
+    RenderQueue queue;
+    frame.fill(queue, 10000);
+    queue.sort();
+
+    auto before = queue.count_unsorted();
+    auto after = queue.count_sorted();
+    std::cout << "State changes per frame for " << before.draws << " draws" << std::endl
+        << "  submission order : " << before.pipeline_binds << " pipeline, "
+        << before.descriptor_binds << " descriptor, " << before.vertex_binds << " vertex binds"
+        << std::endl
+        << "  sorted           : " << after.pipeline_binds << " pipeline, "
+        << after.descriptor_binds << " descriptor, " << after.vertex_binds << " vertex binds"
+        << std::endl;
+
+    BENCHMARK("fill and sort 10k draws") {
+        RenderQueue q;
+        frame.fill(q, 10000);
+        q.sort();
+        return q.size();
+    };
+}
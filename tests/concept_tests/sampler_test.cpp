@@ -0,0 +1,29 @@
+#include <catch2/catch_all.hpp>
+
+#include "vk_ins/sampler.h"
+
+using namespace vkkk;
+
+TEST_CASE("Sampler key test", "[single-file]") {
+    auto info = default_sampler_info();
+    SamplerKey a(info);
+    REQUIRE(a == SamplerKey(default_sampler_info()));
+
+    // pNext isn't part of the key
+    int chained = 0;
+    info.pNext = &chained;
+    REQUIRE(a == SamplerKey(info));
+
+    auto clamp = default_sampler_info();
+    clamp.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    REQUIRE_FALSE(a == SamplerKey(clamp));
+
+    auto aniso = default_sampler_info();
+    aniso.anisotropyEnable = VK_TRUE;
+    aniso.maxAnisotropy = 16.f;
+    REQUIRE_FALSE(a == SamplerKey(aniso));
+
+    auto lod = default_sampler_info();
+    lod.maxLod = 12.f;
+    REQUIRE_FALSE(a == SamplerKey(lod));
+}
@@ -0,0 +1,152 @@
+#include <cmath>
+#include <set>
+
+#include <catch2/catch_all.hpp>
+
+#include "concepts/shadow.h"
+
+static vkkk::Camera make_camera() {
+    vkkk::Camera cam{};
+    cam.pos = glm::vec3(0.f, 2.f, 5.f);
+    cam.front = glm::vec3(0.f, 0.f, -1.f);
+    cam.up = glm::vec3(0.f, 1.f, 0.f);
+    cam.fov = 60.f;
+    cam.ratio = 16.f / 9.f;
+    cam.near = 0.1f;
+    cam.far = 100.f;
+    return cam;
+}
+
+TEST_CASE("Cascade split test", "[single-file]") {
+    auto splits = vkkk::cascade_splits(0.1f, 100.f, 4, 0.75f);
+    REQUIRE(splits.size() == 5);
+    REQUIRE(splits.front() == 0.1f);
+    REQUIRE(splits.back() == 100.f);
+    for (uint32_t i = 1; i < splits.size(); ++i)
+        REQUIRE(splits[i] > splits[i - 1]);
+
+    // Logarithmic splits give the near cascades more resolution
+    auto log_splits = vkkk::cascade_splits(0.1f, 100.f, 4, 1.f);
+    auto uni_splits = vkkk::cascade_splits(0.1f, 100.f, 4, 0.f);
+    REQUIRE(log_splits[1] < splits[1]);
+    REQUIRE(splits[1] < uni_splits[1]);
+}
+
+TEST_CASE("Cascade fit test", "[single-file]") {
+    auto cam = make_camera();
+    glm::vec3 light_dir = glm::normalize(glm::vec3(-1.f, -2.f, -0.5f));
+    auto cascades = vkkk::fit_cascades(cam, light_dir, 4, 0.75f, 2048, 20.f);
+    REQUIRE(cascades.size() == 4);
+    REQUIRE(cascades.back().split == cam.far);
+
+    // Every corner of a frustum slice lands inside its cascade
+    auto splits = vkkk::cascade_splits(cam.near, cam.far, 4, 0.75f);
+    for (uint32_t c = 0; c < cascades.size(); ++c) {
+        auto inv = glm::inverse(glm::perspective(glm::radians(cam.fov), cam.ratio,
+            splits[c], splits[c + 1]) * cam.get_view_mat());
+        for (uint32_t i = 0; i < 8; ++i) {
+            glm::vec4 p = inv * glm::vec4(i & 1 ? 1.f : -1.f, i & 2 ? 1.f : -1.f,
+                i & 4 ? 1.f : 0.f, 1.f);
+            glm::vec4 s = cascades[c].view_proj * glm::vec4(glm::vec3(p) / p.w, 1.f);
+            REQUIRE(std::abs(s.x) <= 1.f);
+            REQUIRE(std::abs(s.y) <= 1.f);
+            REQUIRE(s.z >= 0.f);
+            REQUIRE(s.z <= 1.f);
+        }
+    }
+}
+
+TEST_CASE("Cascade stability test", "[single-file]") {
+    auto cam = make_camera();
+    glm::vec3 light_dir = glm::normalize(glm::vec3(-1.f, -2.f, -0.5f));
+    const uint32_t res = 1024;
+
+    // Moving the camera shifts a static point by whole texels only
+    glm::vec4 point(3.f, 0.5f, -7.f, 1.f);
+    auto texel_of = [&](const vkkk::Camera& c) {
+        auto cascade = vkkk::fit_cascade(c, c.near, 20.f, light_dir, res, 20.f);
+        glm::vec4 p = cascade.view_proj * point;
+        return glm::vec2(p.x, p.y) * (res * 0.5f);
+    };
+    auto base = texel_of(cam);
+    for (int i = 1; i < 8; ++i) {
+        auto moved = cam;
+        moved.pos += glm::vec3(0.013f * i, 0.f, -0.007f * i);
+        auto diff = texel_of(moved) - base;
+        REQUIRE(std::abs(diff.x - std::round(diff.x)) < 1e-2f);
+        REQUIRE(std::abs(diff.y - std::round(diff.y)) < 1e-2f);
+    }
+}
+
+TEST_CASE("Shadow atlas test", "[single-file]") {
+    vkkk::ShadowAtlas atlas(1024, 64);
+    REQUIRE(atlas.occupancy() == 0.f);
+
+    // Largest first fills the atlas completely without overlaps
+    std::set<std::pair<uint32_t, uint32_t>> texels;
+    auto mark = [&](glm::uvec2 offset, uint32_t size) {
+        REQUIRE(offset.x + size <= 1024);
+        REQUIRE(offset.y + size <= 1024);
+        REQUIRE(offset.x % size == 0);
+        REQUIRE(offset.y % size == 0);
+        for (uint32_t y = offset.y; y < offset.y + size; y += 64)
+            for (uint32_t x = offset.x; x < offset.x + size; x += 64)
+                REQUIRE(texels.insert({x, y}).second);
+    };
+
+    auto big = atlas.alloc(512);
+    REQUIRE(big);
+    mark(*big, 512);
+    for (int i = 0; i < 2; ++i) {
+        auto t = atlas.alloc(512);
+        REQUIRE(t);
+        mark(*t, 512);
+    }
+    for (int i = 0; i < 16; ++i) {
+        auto t = atlas.alloc(128);
+        REQUIRE(t);
+        mark(*t, 128);
+    }
+    REQUIRE(atlas.occupancy() == 1.f);
+    REQUIRE_FALSE(atlas.alloc(64));
+
+    // Odd sizes take the block above them
+    atlas.reset();
+    REQUIRE(atlas.occupancy() == 0.f);
+    REQUIRE(atlas.alloc(300));
+    REQUIRE(atlas.occupancy() == 0.25f);
+    REQUIRE(atlas.alloc(10));
+    REQUIRE(atlas.occupancy() == Catch::Approx(0.25f + 1.f / 256.f));
+}
+
+TEST_CASE("Shadow resolution test", "[single-file]") {
+    auto cam = make_camera();
+    uint32_t prev = 0;
+    for (float dist : {80.f, 40.f, 20.f, 10.f, 5.f}) {
+        auto res = vkkk::shadow_resolution(cam, cam.pos + cam.front * dist, 2.f, 1080, 64, 1024);
+        REQUIRE(res >= prev);
+        REQUIRE((res & (res - 1)) == 0);
+        REQUIRE(res >= 64);
+        REQUIRE(res <= 1024);
+        prev = res;
+    }
+    REQUIRE(prev == 1024);
+    // Inside the sphere always gets the most
+    REQUIRE(vkkk::shadow_resolution(cam, cam.pos, 2.f, 1080, 64, 1024) == 1024);
+}
+
+TEST_CASE("Point light face test", "[single-file]") {
+    glm::vec3 pos(1.f, 2.f, 3.f);
+    auto mats = vkkk::point_shadow_matrices(pos, 10.f);
+    const glm::vec3 dirs[] = {
+        {1.f, 0.f, 0.f}, {-1.f, 0.f, 0.f}, {0.f, 1.f, 0.f},
+        {0.f, -1.f, 0.f}, {0.f, 0.f, 1.f}, {0.f, 0.f, -1.f}};
+    for (int i = 0; i < 6; ++i) {
+        glm::vec4 p = mats[i] * glm::vec4(pos + dirs[i] * 5.f, 1.f);
+        REQUIRE(p.w > 0.f);
+        REQUIRE(std::abs(p.x / p.w) < 1e-4f);
+        REQUIRE(std::abs(p.y / p.w) < 1e-4f);
+        REQUIRE(p.z / p.w > 0.f);
+        REQUIRE(p.z / p.w < 1.f);
+    }
+}
@@ -0,0 +1,90 @@
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include <catch2/catch_all.hpp>
+
+#include "asset_mgr/mesh_mgr.h"
+#include "utils/thread_pool.h"
+
+using namespace vkkk;
+
+static aiMesh* make_mesh(const uint32_t n) {
+    auto mesh = new aiMesh;
+    mesh->mNumVertices = n;
+    mesh->mVertices = new aiVector3D[n];
+    for (uint32_t i = 0; i < n; ++i)
+        mesh->mVertices[i] = aiVector3D(static_cast<float>(i), 0.f, 0.f);
+    return mesh;
+}
+
+// Both test cases run on a single worker, the first call sizes the shared
+// pool. A parallel_for nested in a job would wait forever on chunks queued
+// behind the job itself
+TEST_CASE("Nested parallel for test", "[single-file]") {
+    auto& pool = ThreadPool::instance(1u);
+    REQUIRE(pool.get_worker_cnt() == 1);
+    REQUIRE_FALSE(pool.on_worker());
+
+    std::atomic<size_t> sum = 0;
+    std::atomic<bool> all_on_worker = true;
+    pool.parallel_for(4, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            all_on_worker = all_on_worker && pool.on_worker();
+            pool.parallel_for(100, [&](size_t b, size_t e) {
+                sum += e - b;
+            });
+        }
+    });
+    REQUIRE(sum == 400);
+    REQUIRE(all_on_worker);
+}
+
+TEST_CASE("Large mesh load on one worker test", "[single-file]") {
+    REQUIRE(ThreadPool::instance(1u).get_worker_cnt() == 1);
+
+    // Both past the threshold, so each interleave asks for a parallel_for
+    // from inside the load job
+    const uint32_t n = INTERLEAVE_PARALLEL_THRESHOLD + 5;
+    auto scene = std::make_unique<aiScene>();
+    scene->mNumMeshes = 2;
+    scene->mMeshes = new aiMesh*[2]{make_mesh(n), make_mesh(n)};
+    scene->mRootNode = new aiNode("root");
+    scene->mRootNode->mNumMeshes = 2;
+    scene->mRootNode->mMeshes = new uint32_t[2]{0, 1};
+
+    auto& mgr = MeshMgr::instance();
+    mgr.load_scene(scene.get(), "large", {VERTEX});
+    REQUIRE(mgr.get_keys("large").size() == 2);
+    for (auto& key : mgr.get_keys("large")) {
+        auto mesh = mgr.get_mesh(key);
+        REQUIRE(mesh->vcnt == n);
+        REQUIRE(mesh->vbuf[(n - 1) * 3] == static_cast<float>(n - 1));
+    }
+}
+
+// A pool of its own, the shared one is sized to a single worker above
+TEST_CASE("Nested parallel for spread test", "[single-file]") {
+    ThreadPool pool(4);
+    std::mutex mtx;
+    std::set<std::thread::id> ids;
+    std::atomic<uint32_t> entered = 0;
+
+    // One outer job, like a single mesh loading, whose inner chunks each
+    // hold on until another one started or a second passed
+    pool.parallel_for(1, [&](size_t, size_t) {
+        pool.parallel_for(4, [&](size_t, size_t) {
+            ++entered;
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+            while (entered < 2 && std::chrono::steady_clock::now() < deadline)
+                std::this_thread::yield();
+            std::lock_guard<std::mutex> lock(mtx);
+            ids.insert(std::this_thread::get_id());
+        });
+    });
+    REQUIRE(entered == 4);
+    REQUIRE(ids.size() > 1);
+}
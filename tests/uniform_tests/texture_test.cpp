@@ -12,4 +12,67 @@ TEST_CASE("Texture test", "[single-file]") {
     tex.load_image("D:/repo/floss/vkkk/resource/textures/texture.jpeg");
 
     REQUIRE(true);
-}
\ No newline at end of file
+}
+
+TEST_CASE("Texture descriptor test", "[single-file]") {
+    vkkk::VkWrappedInstance ins;
+    ins.init(true);
+    ins.create_logical_device();
+    ins.create_command_pool();
+
+    REQUIRE(ins.add_texture("tex:tex_sampler", 1, "../resource/textures/texture.jpeg"));
+    auto& tex = ins.textures.at("tex:tex_sampler");
+    REQUIRE(tex.descriptor.imageView == tex.view);
+    REQUIRE(tex.descriptor.sampler == tex.sampler);
+
+    // A pipeline sampling it at binding 1, as with_tex.frag does
+    vkkk::Pipeline ppl{};
+    ppl.bindings.push_back({1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1,
+        VK_SHADER_STAGE_FRAGMENT_BIT, nullptr});
+    ppl.resource_names[1] = "tex_sampler";
+    ppl.descriptor_layout = ins.layout_cache.get(ins.get_device(), ppl.bindings);
+    ins.pipelines.emplace("tex", std::move(ppl));
+
+    std::vector<vkkk::DescriptorBinding> bindings;
+    REQUIRE(ins.get_descriptor_bindings("tex", 0, bindings));
+    REQUIRE(bindings.size() == 1);
+    REQUIRE(bindings[0].image.imageView != VK_NULL_HANDLE);
+    REQUIRE(bindings[0].image.sampler != VK_NULL_HANDLE);
+    REQUIRE(bindings[0].image.imageLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    REQUIRE(ins.get_descriptor_set("tex", 0) != VK_NULL_HANDLE);
+}
+
+TEST_CASE("Descriptor set free test", "[single-file]") {
+    vkkk::VkWrappedInstance ins;
+    ins.init(true);
+    ins.create_logical_device();
+    ins.create_command_pool();
+
+    REQUIRE(ins.add_texture("tex:tex_sampler", 1, "../resource/textures/texture.jpeg"));
+    auto& tex = ins.textures.at("tex:tex_sampler");
+    std::vector<VkDescriptorSetLayoutBinding> layout_bindings{{1,
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr}};
+    auto layout = ins.layout_cache.get(ins.get_device(), layout_bindings);
+
+    // Two sets a page, churn a set per view through cache and allocator
+    vkkk::DescriptorAllocator alloc(2, 2);
+    vkkk::DescriptorSetCache cache;
+    for (uint32_t i = 0; i < 16; ++i) {
+        vkkk::DescriptorBinding binding{};
+        binding.binding = 1;
+        binding.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        binding.image = tex.descriptor;
+        REQUIRE(cache.get(ins.get_device(), alloc, layout, {binding}) != VK_NULL_HANDLE);
+
+        auto dropped = cache.forget(tex.view);
+        REQUIRE(dropped.size() == 1);
+        for (auto set : dropped)
+            alloc.free(ins.get_device(), set);
+    }
+
+    // Emptied pages come back instead of piling up
+    REQUIRE(alloc.get_allocated_cnt() == 0);
+    REQUIRE(alloc.page_cnt() <= 2);
+    REQUIRE(cache.forget(tex.view).empty());
+    alloc.destroy(ins.get_device());
+}